@@ -0,0 +1,203 @@
+#include "barchbmp.hpp"
+
+#include <limits>    // for std::numeric_limits
+#include <stdexcept> // for std::runtime_error
+#include <string>    // for std::string
+
+namespace BarchCLI {
+namespace {
+
+constexpr std::size_t FileHeaderSize = 14;
+constexpr std::size_t InfoHeaderSize = 40;
+constexpr std::size_t PaletteEntrySize = 4;
+constexpr std::size_t PaletteSize = 256 * PaletteEntrySize;
+
+/// BI_RGB, that is, the pixels are not compressed.
+constexpr std::uint32_t UncompressedPixels = 0;
+
+// BMP files are little-endian no matter what.
+
+std::uint32_t loadUInt16(const std::uint8_t *const bytes) {
+  return std::uint32_t{bytes[0]} | (std::uint32_t{bytes[1]} << 8);
+}
+
+std::uint32_t loadUInt32(const std::uint8_t *const bytes) {
+  return loadUInt16(bytes) | (loadUInt16(bytes + 2) << 16);
+}
+
+void storeUInt16(std::uint8_t *const bytes, const std::uint32_t value) {
+  bytes[0] = static_cast<std::uint8_t>(value);
+  bytes[1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+void storeUInt32(std::uint8_t *const bytes, const std::uint32_t value) {
+  storeUInt16(bytes, value);
+  storeUInt16(bytes + 2, value >> 16);
+}
+
+/// Returns the number of bytes a row takes in the file. Rows are padded to a
+/// multiple of 4 bytes.
+std::size_t strideFor(const std::size_t width,
+                      const std::size_t bitsPerPixel) {
+  return (width * bitsPerPixel + 31) / 32 * 4;
+}
+
+} // namespace
+
+BmpReader::BmpReader(const std::filesystem::path &path)
+    : m_path{path}, m_file{path, std::ios::binary} {
+  if (!m_file) { throwError("Cannot open the file"); }
+
+  std::array<std::uint8_t, FileHeaderSize + InfoHeaderSize> header;
+  if (!m_file.read(reinterpret_cast<char *>(header.data()),
+                   static_cast<std::streamsize>(header.size())) ||
+      header[0] != 'B' || header[1] != 'M') {
+    throwError("Unknown image format");
+  }
+  const std::uint8_t *const info = header.data() + FileHeaderSize;
+  const std::uint32_t infoSize = loadUInt32(info);
+  // The height is negative for images that are stored top-down.
+  const auto width = static_cast<std::int32_t>(loadUInt32(info + 4));
+  const auto height = static_cast<std::int32_t>(loadUInt32(info + 8));
+  m_bitsPerPixel = loadUInt16(info + 14);
+  const std::uint32_t compression = loadUInt32(info + 16);
+  std::size_t paletteEntryCount = loadUInt32(info + 32);
+  if (infoSize < InfoHeaderSize || compression != UncompressedPixels ||
+      (m_bitsPerPixel != 8 && m_bitsPerPixel != 24 && m_bitsPerPixel != 32)) {
+    throwError("Unsupported image format");
+  }
+  if (width <= 0 || height == 0 ||
+      height == std::numeric_limits<std::int32_t>::min()) {
+    throwError("Corrupt data");
+  }
+  m_width = static_cast<std::size_t>(width);
+  m_height = static_cast<std::size_t>(height < 0 ? -height : height);
+  m_isBottomUp = height > 0;
+  m_pixelOffset = loadUInt32(header.data() + 10);
+  m_stride = strideFor(m_width, m_bitsPerPixel);
+  m_row.resize(m_stride);
+
+  if (m_bitsPerPixel == 8) {
+    if (paletteEntryCount == 0 || paletteEntryCount > 256) {
+      paletteEntryCount = 256;
+    }
+    std::array<std::uint8_t, PaletteSize> palette;
+    m_file.seekg(static_cast<std::streamoff>(FileHeaderSize + infoSize));
+    if (!m_file.read(reinterpret_cast<char *>(palette.data()),
+                     static_cast<std::streamsize>(paletteEntryCount *
+                                                  PaletteEntrySize))) {
+      throwError("Corrupt data");
+    }
+    for (std::size_t index = 0; index < paletteEntryCount; ++index) {
+      // The entries are stored as blue, green, red and a reserved byte.
+      const std::uint8_t *const entry = &palette[index * PaletteEntrySize];
+      m_palette[index] = entry[0];
+      m_isGray[index] = entry[0] == entry[1] && entry[1] == entry[2];
+    }
+  }
+}
+
+void BmpReader::read(const BarchLib::MutablePixels pixels) {
+  const std::size_t y = m_rowCount++;
+  const std::size_t fileRow = m_isBottomUp ? m_height - 1 - y : y;
+  // Reading the rows of bottom-up images in reverse takes a seek per row.
+  // Top-down images are read straight through.
+  if (m_isBottomUp || y == 0) {
+    m_file.seekg(m_pixelOffset +
+                 static_cast<std::streamoff>(fileRow * m_stride));
+  }
+  if (!m_file.read(reinterpret_cast<char *>(m_row.data()),
+                   static_cast<std::streamsize>(m_stride))) {
+    throwError("Corrupt data");
+  }
+  if (m_bitsPerPixel == 8) {
+    for (std::size_t x = 0; x < m_width; ++x) {
+      const std::uint8_t index = m_row[x];
+      if (!m_isGray[index]) { throwError("This image is not grayscale"); }
+      pixels[x] = m_palette[index];
+    }
+    return;
+  }
+  const std::size_t bytesPerPixel = m_bitsPerPixel / 8;
+  for (std::size_t x = 0; x < m_width; ++x) {
+    const std::uint8_t *const pixel = &m_row[x * bytesPerPixel];
+    if (pixel[0] != pixel[1] || pixel[1] != pixel[2]) {
+      throwError("This image is not grayscale");
+    }
+    pixels[x] = pixel[0];
+  }
+}
+
+void BmpReader::throwError(const char *const reason) const {
+  throw std::runtime_error{"An error occurred while loading '" +
+                           m_path.filename().string() + "'. " + reason + "."};
+}
+
+BmpWriter::BmpWriter(const std::filesystem::path &path,
+                     const std::size_t width, const std::size_t height)
+    : m_path{path}, m_file{path, std::ios::binary | std::ios::trunc},
+      m_width{width}, m_height{height}, m_stride{strideFor(width, 8)} {
+  if (!m_file) { throwError(); }
+  constexpr std::size_t pixelOffset =
+      FileHeaderSize + InfoHeaderSize + PaletteSize;
+  const std::size_t fileSize = pixelOffset + m_stride * m_height;
+  if (m_width > std::numeric_limits<std::int32_t>::max() ||
+      m_height > std::numeric_limits<std::int32_t>::max() ||
+      fileSize > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::runtime_error{"An error occurred while saving '" +
+                             m_path.filename().string() +
+                             "'. The image is too large."};
+  }
+
+  std::array<std::uint8_t, pixelOffset> header{};
+  header[0] = 'B';
+  header[1] = 'M';
+  storeUInt32(&header[2], static_cast<std::uint32_t>(fileSize));
+  storeUInt32(&header[10], static_cast<std::uint32_t>(pixelOffset));
+  std::uint8_t *const info = &header[FileHeaderSize];
+  storeUInt32(info, static_cast<std::uint32_t>(InfoHeaderSize));
+  storeUInt32(info + 4, static_cast<std::uint32_t>(m_width));
+  storeUInt32(info + 8, static_cast<std::uint32_t>(m_height));
+  storeUInt16(info + 12, 1); // The number of planes.
+  storeUInt16(info + 14, 8); // The number of bits per pixel.
+  storeUInt32(info + 16, UncompressedPixels);
+  storeUInt32(info + 20, static_cast<std::uint32_t>(m_stride * m_height));
+  storeUInt32(info + 32, 256); // The number of palette entries.
+  std::uint8_t *const palette = info + InfoHeaderSize;
+  for (std::size_t index = 0; index < 256; ++index) {
+    std::uint8_t *const entry = &palette[index * PaletteEntrySize];
+    entry[0] = entry[1] = entry[2] = static_cast<std::uint8_t>(index);
+  }
+  if (!m_file.write(reinterpret_cast<const char *>(header.data()),
+                    static_cast<std::streamsize>(header.size()))) {
+    throwError();
+  }
+}
+
+void BmpWriter::write(const BarchLib::ImmutablePixels pixels) {
+  // The image is stored bottom-up, like most BMP files are, so the rows are
+  // written in reverse. The padding is written along with every row.
+  const std::size_t fileRow = m_height - 1 - m_rowCount++;
+  const auto rowOffset = static_cast<std::streamoff>(
+      FileHeaderSize + InfoHeaderSize + PaletteSize + fileRow * m_stride);
+  constexpr std::array<char, 3> padding{};
+  if (!m_file.seekp(rowOffset) ||
+      !m_file.write(reinterpret_cast<const char *>(pixels.data()),
+                    static_cast<std::streamsize>(pixels.size())) ||
+      !m_file.write(padding.data(),
+                    static_cast<std::streamsize>(m_stride - m_width))) {
+    throwError();
+  }
+}
+
+void BmpWriter::close() {
+  m_file.close();
+  if (!m_file) { throwError(); }
+}
+
+void BmpWriter::throwError() const {
+  throw std::runtime_error{"An error occurred while saving '" +
+                           m_path.filename().string() + "'. I/O error."};
+}
+
+} // namespace BarchCLI
@@ -0,0 +1,112 @@
+#ifndef BARCHBMP_HPP
+#define BARCHBMP_HPP
+
+#include <array>      // for std::array
+#include <cstddef>    // for std::size_t
+#include <cstdint>    // for std::uint8_t
+#include <filesystem> // for std::filesystem::path
+#include <fstream>    // for std::ifstream, std::ofstream
+#include <vector>     // for std::vector
+
+#include <barchlib.hpp>
+
+namespace BarchCLI {
+
+/// BmpReader reads the rows of a grayscale BMP file one at a time, so that the
+/// whole image never has to be held in memory. Uncompressed images with 8 bits
+/// per pixel and a palette, or with 24 or 32 bits per pixel, are supported.
+/// Throws std::runtime_error if the file cannot be read or is not grayscale.
+struct BmpReader final {
+
+  explicit BmpReader(const std::filesystem::path &path);
+
+  BmpReader(const BmpReader &) = delete;
+  BmpReader &operator=(const BmpReader &) = delete;
+
+  std::size_t width() const noexcept { return m_width; }
+  std::size_t height() const noexcept { return m_height; }
+
+  /// Reads the next row, from top to bottom, into `pixels`.
+  /// Preconditions:
+  /// 	- pixels.size() is equal to width();
+  /// 	- there are rows left to read.
+  void read(BarchLib::MutablePixels pixels);
+
+private:
+  std::filesystem::path m_path;
+
+  std::ifstream m_file;
+
+  std::size_t m_width = 0;
+  std::size_t m_height = 0;
+
+  /// Most BMP files are stored bottom-up, that is, the last row comes first.
+  bool m_isBottomUp = true;
+
+  std::size_t m_bitsPerPixel = 0;
+
+  /// Holds the offset of the first row in the file.
+  std::streamoff m_pixelOffset = 0;
+
+  /// Holds the number of bytes every row takes in the file, padding included.
+  std::size_t m_stride = 0;
+
+  /// Maps palette indices to shades of gray.
+  std::array<BarchLib::Pixel, 256> m_palette{};
+
+  /// Tells which palette entries are shades of gray. The entries that are
+  /// missing from the file are not.
+  std::array<bool, 256> m_isGray{};
+
+  /// Holds the row that is currently being read, as it's stored in the file.
+  std::vector<std::uint8_t> m_row;
+
+  /// Holds the number of rows that were read so far.
+  std::size_t m_rowCount = 0;
+
+  [[noreturn]] void throwError(const char *reason) const;
+};
+
+/// BmpWriter writes a grayscale BMP file one row at a time. The image is saved
+/// with 8 bits per pixel and a grayscale palette.
+/// Throws std::runtime_error if the file cannot be written.
+struct BmpWriter final {
+
+  /// Creates the file, or truncates it if it exists already.
+  /// Preconditions: width and height are not 0.
+  BmpWriter(const std::filesystem::path &path, std::size_t width,
+            std::size_t height);
+
+  BmpWriter(const BmpWriter &) = delete;
+  BmpWriter &operator=(const BmpWriter &) = delete;
+
+  /// Writes the next row, from top to bottom.
+  /// Preconditions:
+  /// 	- pixels.size() is equal to the width of the image;
+  /// 	- there are rows left to write.
+  void write(BarchLib::ImmutablePixels pixels);
+
+  /// Flushes the file and makes sure that everything was written.
+  /// Precondition: all the rows were written.
+  void close();
+
+private:
+  std::filesystem::path m_path;
+
+  std::ofstream m_file;
+
+  std::size_t m_width;
+  std::size_t m_height;
+
+  /// Holds the number of bytes every row takes in the file, padding included.
+  std::size_t m_stride;
+
+  /// Holds the number of rows that were written so far.
+  std::size_t m_rowCount = 0;
+
+  [[noreturn]] void throwError() const;
+};
+
+} // namespace BarchCLI
+
+#endif // BARCHBMP_HPP
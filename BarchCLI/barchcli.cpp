@@ -0,0 +1,401 @@
+#include "barchbmp.hpp"
+#include "barchfile.hpp"
+
+#include <algorithm>   // for std::max, std::min
+#include <atomic>      // for std::atomic
+#include <cctype>      // for std::isdigit, std::tolower
+#include <chrono>      // for std::chrono::steady_clock
+#include <cstdint>     // for std::int32_t, std::uintmax_t
+#include <cstdio>      // for std::fprintf, std::printf
+#include <cstdlib>     // for EXIT_FAILURE, EXIT_SUCCESS
+#include <exception>   // for std::exception
+#include <filesystem>  // for std::filesystem
+#include <limits>      // for std::numeric_limits
+#include <mutex>       // for std::mutex, std::lock_guard
+#include <stdexcept>   // for std::runtime_error
+#include <string>      // for std::string, std::stoull
+#include <string_view> // for std::string_view
+#include <thread>      // for std::thread
+#include <vector>      // for std::vector
+
+#include <barchlib.hpp>
+
+namespace fs = std::filesystem;
+
+namespace BarchCLI {
+namespace {
+
+constexpr const char *Usage =
+    R"(Usage: barch <compress|decompress> [options] <path>...
+
+Compresses the BMP files, or decompresses the BARCH files, that are found in the
+given files and directory trees. Every result is saved next to its source, the
+same way the viewer does it: `image.bmp` becomes `image-packed.barch`, and
+`image.barch` becomes `image-unpacked.bmp`. Files that were converted already
+are skipped.
+
+Options:
+  -j, --jobs <count>            Converts up to <count> files at the same time.
+                                One per hardware thread by default.
+  -f, --force                   Converts the files that were converted already
+                                again, overwriting the results.
+  -r, --row-group-size <rows>   Builds a row index with an entry per <rows> rows
+                                while compressing. None by default.
+  -b, --block-width <pixels>    Codes the pixels in blocks of 4, 8, or 16
+                                pixels while compressing. Wider blocks suit
+                                images with long white or black runs. 4 by
+                                default, which older versions can load.
+  -l, --run-length              Codes long white or black runs with a code of
+                                their own while compressing. Suits pages
+                                with wide margins. Older versions cannot
+                                load the results.
+  -s, --statistics              Prints how the rows were coded, and how long
+                                every phase took. BarchLib must be built
+                                with BARCHLIB_STATISTICS for that.
+  -h, --help                    Prints this message.
+)";
+
+enum class Mode { Compress, Decompress };
+
+/// Settings hold what was asked for on the command line.
+struct Settings final {
+  Mode mode = Mode::Compress;
+  std::size_t jobCount = 0;
+  bool force = false;
+  std::size_t rowGroupSize = 0;
+  BarchLib::BlockWidth blockWidth = BarchLib::BlockWidth::Four;
+  bool runLengthCodes = false;
+  bool printsStatistics = false;
+  std::vector<fs::path> paths;
+};
+
+/// Statistics are gathered by all the workers at the same time.
+struct Statistics final {
+  std::atomic<std::size_t> convertedFileCount = 0;
+  std::atomic<std::size_t> skippedFileCount = 0;
+  std::atomic<std::size_t> failedFileCount = 0;
+  std::atomic<std::uintmax_t> readByteCount = 0;
+  std::atomic<std::uintmax_t> writtenByteCount = 0;
+  std::atomic<std::uintmax_t> pixelCount = 0;
+
+  /// Guards `codec`.
+  std::mutex codecMutex;
+  BarchLib::CodecStatistics codec;
+};
+
+/// Serializes the messages of the workers.
+std::mutex outputMutex;
+
+bool hasExtension(const fs::path &path, const std::string_view extension) {
+  std::string actual = path.extension().string();
+  std::transform(actual.begin(), actual.end(), actual.begin(),
+                 [](const unsigned char c) { return std::tolower(c); });
+  return actual == extension;
+}
+
+bool isSource(const Mode mode, const fs::path &path) {
+  if (mode == Mode::Decompress) { return hasExtension(path, ".barch"); }
+  // The images that barch unpacked itself are not packed again.
+  return hasExtension(path, ".bmp") &&
+         !path.stem().string().ends_with("-unpacked");
+}
+
+fs::path targetFor(const Mode mode, const fs::path &source) {
+  const std::string suffix =
+      mode == Mode::Compress ? "-packed.barch" : "-unpacked.bmp";
+  return source.parent_path() / (source.stem().string() + suffix);
+}
+
+/// Returns the source files that are found in the given paths. Directories are
+/// searched recursively.
+std::vector<fs::path> collectSources(const Settings &settings) {
+  std::vector<fs::path> sources;
+  for (const fs::path &path : settings.paths) {
+    if (fs::is_directory(path)) {
+      for (const fs::directory_entry &entry :
+           fs::recursive_directory_iterator{path}) {
+        if (entry.is_regular_file() && isSource(settings.mode, entry.path())) {
+          sources.push_back(entry.path());
+        }
+      }
+    } else if (fs::is_regular_file(path)) {
+      sources.push_back(path);
+    } else {
+      throw std::runtime_error{"'" + path.string() + "' does not exist."};
+    }
+  }
+  return sources;
+}
+
+/// Compresses a BMP file a row at a time. Neither the image nor the compressed
+/// bitmap is ever held in memory as a whole.
+std::size_t compressFile(const fs::path &source, const fs::path &target,
+                         const Settings &settings,
+                         BarchLib::CodecStatistics &codecStatistics) {
+  BmpReader image{source};
+  BarchLib::CompressionOptions options;
+  options.rowGroupSize = settings.rowGroupSize;
+  options.blockWidth = settings.blockWidth;
+  options.runLengthCodes = settings.runLengthCodes;
+  if (settings.printsStatistics) { options.statistics = &codecStatistics; }
+  BarchLib::StreamingEncoder encoder{image.width(), image.height(), options};
+  BarchFile file{target, BarchFile::Write};
+  encoder.start(file);
+  std::vector<BarchLib::Pixel> row(image.width());
+  for (std::size_t y = 0; y < image.height(); ++y) {
+    image.read(row);
+    encoder.push(row, file);
+  }
+  encoder.finish(file);
+  file.close();
+  return image.width() * image.height();
+}
+
+/// Writes the rows that `decoder` pulls into a BMP file.
+void writeImage(BarchLib::StreamingDecoder &decoder, const fs::path &target) {
+  BmpWriter image{target, decoder.width(), decoder.height()};
+  std::vector<BarchLib::Pixel> row(decoder.width());
+  while (decoder.pull(row)) { image.write(row); }
+  image.close();
+}
+
+/// Decompresses a BARCH file a row at a time. Tiled bitmaps cannot be streamed,
+/// so those are loaded first.
+std::size_t decompressFile(const fs::path &source, const fs::path &target,
+                           const Settings &settings,
+                           BarchLib::CodecStatistics &codecStatistics) {
+  BarchLib::CodecStatistics *const statistics =
+      settings.printsStatistics ? &codecStatistics : nullptr;
+  try {
+    BarchFile file{source, BarchFile::Read};
+    BarchLib::StreamingDecoder decoder{file};
+    decoder.collectStatistics(statistics);
+    writeImage(decoder, target);
+    return decoder.width() * decoder.height();
+  } catch (const BarchLib::InvalidFormat &exc) {
+    if (exc.reason() != BarchLib::InvalidFormat::UnsupportedFeatures) {
+      throw;
+    }
+  }
+  BarchFile file{source, BarchFile::Read};
+  const BarchLib::CompressedBitmap compressedBitmap = BarchLib::load(file);
+  BarchLib::StreamingDecoder decoder{compressedBitmap};
+  decoder.collectStatistics(statistics);
+  writeImage(decoder, target);
+  return decoder.width() * decoder.height();
+}
+
+/// Converts a single file. The result is written to a temporary file first,
+/// so that an interrupted run never leaves a truncated result behind that
+/// would be skipped the next time.
+void convert(const fs::path &source, const Settings &settings,
+             Statistics &statistics) {
+  const fs::path target = targetFor(settings.mode, source);
+  if (!settings.force && fs::exists(target)) {
+    ++statistics.skippedFileCount;
+    return;
+  }
+  fs::path temporaryTarget = target;
+  temporaryTarget += ".part";
+  try {
+    BarchLib::CodecStatistics codecStatistics;
+    const std::size_t pixelCount =
+        settings.mode == Mode::Compress
+            ? compressFile(source, temporaryTarget, settings, codecStatistics)
+            : decompressFile(source, temporaryTarget, settings,
+                             codecStatistics);
+    fs::rename(temporaryTarget, target);
+    {
+      const std::lock_guard lock{statistics.codecMutex};
+      statistics.codec += codecStatistics;
+    }
+    statistics.readByteCount += fs::file_size(source);
+    statistics.writtenByteCount += fs::file_size(target);
+    statistics.pixelCount += pixelCount;
+    ++statistics.convertedFileCount;
+  } catch (const std::exception &exc) {
+    std::error_code ignored;
+    fs::remove(temporaryTarget, ignored);
+    ++statistics.failedFileCount;
+    const std::lock_guard lock{outputMutex};
+    std::fprintf(stderr, "barch: %s: %s\n", source.string().c_str(),
+                 exc.what());
+  }
+}
+
+void printSummary(const Statistics &statistics, const double seconds) {
+  constexpr double MiB = 1024.0 * 1024.0;
+  const double readMiB = static_cast<double>(statistics.readByteCount) / MiB;
+  const double writtenMiB =
+      static_cast<double>(statistics.writtenByteCount) / MiB;
+  const double megapixels = static_cast<double>(statistics.pixelCount) / 1e6;
+  const double elapsed = std::max(seconds, 1e-9);
+  std::printf("%zu converted, %zu skipped, %zu failed in %.3f s\n",
+              statistics.convertedFileCount.load(),
+              statistics.skippedFileCount.load(),
+              statistics.failedFileCount.load(), seconds);
+  std::printf("read %.2f MiB, wrote %.2f MiB: %.2f MiB/s, %.2f Mpixel/s\n",
+              readMiB, writtenMiB, readMiB / elapsed, megapixels / elapsed);
+}
+
+void printCodecStatistics(const BarchLib::CodecStatistics &statistics) {
+  const std::size_t blockCount =
+      statistics.whiteBlockCount + statistics.blackBlockCount +
+      statistics.literalBlockCount + statistics.paddingBlockCount;
+  const auto percentOf = [blockCount](const std::size_t count) {
+    return blockCount ? 100.0 * static_cast<double>(count) /
+                            static_cast<double>(blockCount)
+                      : 0.0;
+  };
+  std::printf("%zu empty rows skipped\n", statistics.emptyRowCount);
+  std::printf("%zu blocks: %.1f%% white, %.1f%% black, %.1f%% literal, "
+              "%.1f%% padded\n",
+              blockCount, percentOf(statistics.whiteBlockCount),
+              percentOf(statistics.blackBlockCount),
+              percentOf(statistics.literalBlockCount),
+              percentOf(statistics.paddingBlockCount));
+  if (statistics.runCount) {
+    std::printf("%zu runs of white or black blocks\n", statistics.runCount);
+  }
+  std::printf("%.2f MiB of pixel data\n",
+              static_cast<double>(statistics.bitCount) / 8 / 1024 / 1024);
+  // The phases of all the files are added up, so they may take longer than
+  // the whole run when several files are converted at the same time.
+  const auto secondsOf = [](const std::chrono::nanoseconds time) {
+    return std::chrono::duration<double>{time}.count();
+  };
+  std::printf("%.3f s scanning, %.3f s coding, %.3f s splicing\n",
+              secondsOf(statistics.scanningTime),
+              secondsOf(statistics.codingTime),
+              secondsOf(statistics.splicingTime));
+}
+
+/// Returns the value of an option that takes one, and moves past it.
+std::size_t parseCount(const int argc, char *argv[], int &index) {
+  const std::string_view option = argv[index];
+  if (++index == argc) {
+    throw std::runtime_error{"'" + std::string{option} + "' needs a value."};
+  }
+  const std::string value = argv[index];
+  const auto throwInvalidValue = [&value, option] {
+    throw std::runtime_error{"'" + value + "' is not a valid value for '" +
+                             std::string{option} + "'."};
+  };
+  // std::stoull skips leading spaces, and happily negates what follows a '-'.
+  // Only plain digits make a count.
+  if (value.empty() ||
+      !std::isdigit(static_cast<unsigned char>(value.front()))) {
+    throwInvalidValue();
+  }
+  std::size_t length = 0;
+  std::size_t count = 0;
+  try {
+    count = std::stoull(value, &length);
+  } catch (const std::exception &) { throwInvalidValue(); }
+  if (length != value.size()) { throwInvalidValue(); }
+  return count;
+}
+
+/// Returns `false` if the usage was printed instead.
+bool parseSettings(const int argc, char *argv[], Settings &settings) {
+  if (argc < 2) { return false; }
+  const std::string_view command = argv[1];
+  if (command == "compress") {
+    settings.mode = Mode::Compress;
+  } else if (command == "decompress") {
+    settings.mode = Mode::Decompress;
+  } else {
+    return false;
+  }
+  for (int index = 2; index < argc; ++index) {
+    const std::string_view argument = argv[index];
+    if (argument == "-h" || argument == "--help") {
+      return false;
+    } else if (argument == "-j" || argument == "--jobs") {
+      settings.jobCount = parseCount(argc, argv, index);
+    } else if (argument == "-f" || argument == "--force") {
+      settings.force = true;
+    } else if (argument == "-r" || argument == "--row-group-size") {
+      settings.rowGroupSize = parseCount(argc, argv, index);
+      // BMP files are at most that many rows high.
+      if (settings.rowGroupSize >
+          static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+        throw std::runtime_error{"'" + std::string{argv[index]} +
+                                 "' is not a valid value for '" +
+                                 std::string{argument} + "'."};
+      }
+    } else if (argument == "-b" || argument == "--block-width") {
+      const std::size_t blockWidth = parseCount(argc, argv, index);
+      // Auto is not offered: the rows are streamed, so there are no rows to
+      // pick a width by up front.
+      if (!BarchLib::Internal::isValidBlockWidth(blockWidth)) {
+        throw std::runtime_error{"'" + std::string{argv[index]} +
+                                 "' is not a valid value for '" +
+                                 std::string{argument} + "'."};
+      }
+      settings.blockWidth = static_cast<BarchLib::BlockWidth>(blockWidth);
+    } else if (argument == "-l" || argument == "--run-length") {
+      settings.runLengthCodes = true;
+    } else if (argument == "-s" || argument == "--statistics") {
+      if (!BarchLib::StatisticsAreEnabled) {
+        throw std::runtime_error{"BarchLib was built without statistics."};
+      }
+      settings.printsStatistics = true;
+    } else if (argument.starts_with("-")) {
+      throw std::runtime_error{"Unknown option '" + std::string{argument} +
+                               "'."};
+    } else {
+      settings.paths.emplace_back(argument);
+    }
+  }
+  return !settings.paths.empty();
+}
+
+int run(const int argc, char *argv[]) {
+  Settings settings;
+  if (!parseSettings(argc, argv, settings)) {
+    std::fputs(Usage, stderr);
+    return EXIT_FAILURE;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<fs::path> sources = collectSources(settings);
+
+  // Every worker takes the next file that nobody has taken yet, so that the
+  // small files don't wait for the large ones.
+  Statistics statistics;
+  std::atomic<std::size_t> nextSource = 0;
+  const auto work = [&] {
+    for (std::size_t index = nextSource++; index < sources.size();
+         index = nextSource++) {
+      convert(sources[index], settings, statistics);
+    }
+  };
+  const std::size_t hardwareThreadCount = std::thread::hardware_concurrency();
+  const std::size_t jobCount = std::min(
+      settings.jobCount ? settings.jobCount : hardwareThreadCount,
+      sources.size());
+  std::vector<std::thread> workers;
+  for (std::size_t job = 1; job < jobCount; ++job) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread &worker : workers) { worker.join(); }
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  printSummary(statistics, elapsed.count());
+  if (settings.printsStatistics) { printCodecStatistics(statistics.codec); }
+  return statistics.failedFileCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} // namespace
+} // namespace BarchCLI
+
+int main(int argc, char *argv[]) {
+  try {
+    return BarchCLI::run(argc, argv);
+  } catch (const std::exception &exc) {
+    std::fprintf(stderr, "barch: %s\n", exc.what());
+    return EXIT_FAILURE;
+  }
+}
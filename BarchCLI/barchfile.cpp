@@ -0,0 +1,109 @@
+#include "barchfile.hpp"
+
+#include <algorithm> // for std::min
+#include <array>     // for std::array
+#include <bit>       // for std::endian
+#include <cstdint>   // for std::uint64_t
+#include <stdexcept> // for std::runtime_error
+#include <string>    // for std::string
+
+namespace BarchCLI {
+namespace {
+
+constexpr bool ValuesAreStoredAsIs =
+    sizeof(std::size_t) == sizeof(std::uint64_t) &&
+    std::endian::native == std::endian::little;
+
+std::uint64_t toLittleEndian(const std::uint64_t value) {
+  if constexpr (std::endian::native == std::endian::little) {
+    return value;
+  } else {
+    std::uint64_t result = 0;
+    for (std::size_t byte = 0; byte < sizeof(value); ++byte) {
+      result = (result << 8) | ((value >> (byte * 8)) & 0xFFU);
+    }
+    return result;
+  }
+}
+
+} // namespace
+
+BarchFile::BarchFile(const std::filesystem::path &path, const Mode mode)
+    : m_path{path},
+      m_file{path, mode == Read
+                       ? std::ios::in | std::ios::binary
+                       : std::ios::out | std::ios::binary | std::ios::trunc} {
+  if (!m_file) { throwError("Cannot open the file"); }
+}
+
+void BarchFile::close() {
+  m_file.close();
+  if (!m_file) { throwError("I/O error"); }
+}
+
+void BarchFile::readBytes(void *const data, const std::size_t size) {
+  if (!m_file.read(static_cast<char *>(data),
+                   static_cast<std::streamsize>(size))) {
+    throwError("Corrupt data");
+  }
+}
+
+void BarchFile::writeBytes(const void *const data, const std::size_t size) {
+  if (!m_file.write(static_cast<const char *>(data),
+                    static_cast<std::streamsize>(size))) {
+    throwError("I/O error");
+  }
+}
+
+void BarchFile::throwError(const char *const reason) const {
+  throw std::runtime_error{"An error occurred while accessing '" +
+                           m_path.filename().string() + "'. " + reason + "."};
+}
+
+void read(BarchFile &file, std::size_t &value) {
+  std::uint64_t value64 = 0;
+  file.readBytes(&value64, sizeof(value64));
+  value = static_cast<std::size_t>(toLittleEndian(value64));
+}
+
+void read(BarchFile &file, const std::span<std::size_t> values) {
+  if constexpr (ValuesAreStoredAsIs) {
+    file.readBytes(values.data(), values.size_bytes());
+  } else {
+    for (auto &value : values) { read(file, value); }
+  }
+}
+
+void write(BarchFile &file, const std::size_t value) {
+  const std::uint64_t value64 = toLittleEndian(value);
+  file.writeBytes(&value64, sizeof(value64));
+}
+
+void write(BarchFile &file, const std::span<std::size_t const> values) {
+  if constexpr (ValuesAreStoredAsIs) {
+    file.writeBytes(values.data(), values.size_bytes());
+  } else {
+    // The values cannot be converted in place, so they are converted a chunk
+    // at a time instead.
+    std::array<std::uint64_t, 512> chunk;
+    for (std::size_t index = 0; index < values.size(); index += chunk.size()) {
+      const std::size_t count = std::min(chunk.size(), values.size() - index);
+      for (std::size_t offset = 0; offset < count; ++offset) {
+        chunk[offset] = toLittleEndian(values[index + offset]);
+      }
+      file.writeBytes(chunk.data(), count * sizeof(std::uint64_t));
+    }
+  }
+}
+
+std::size_t tell(BarchFile &file) {
+  return static_cast<std::size_t>(file.m_file.tellp());
+}
+
+void seek(BarchFile &file, const std::size_t position) {
+  if (!file.m_file.seekp(static_cast<std::streamoff>(position))) {
+    file.throwError("I/O error");
+  }
+}
+
+} // namespace BarchCLI
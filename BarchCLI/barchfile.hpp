@@ -0,0 +1,52 @@
+#ifndef BARCHFILE_HPP
+#define BARCHFILE_HPP
+
+#include <cstddef>    // for std::size_t
+#include <filesystem> // for std::filesystem::path
+#include <fstream>    // for std::fstream
+#include <span>       // for std::span
+
+namespace BarchCLI {
+
+/// BarchFile implements BarchLib::Reader, BarchLib::Writer and their span and
+/// seekable counterparts on top of a file, so that compressed bitmaps can be
+/// streamed to and from it. Like the viewer does, every value is stored as a
+/// 64-bit little-endian integer.
+/// Throws std::runtime_error if the file cannot be read or written.
+struct BarchFile final {
+
+  enum Mode { Read, Write };
+
+  /// Opens the file. It's created, or truncated if it exists already, when it
+  /// is opened for writing.
+  BarchFile(const std::filesystem::path &path, Mode mode);
+
+  BarchFile(const BarchFile &) = delete;
+  BarchFile &operator=(const BarchFile &) = delete;
+
+  /// Flushes the file and makes sure that everything was written.
+  void close();
+
+  friend void read(BarchFile &file, std::size_t &value);
+  friend void read(BarchFile &file, std::span<std::size_t> values);
+
+  friend void write(BarchFile &file, std::size_t value);
+  friend void write(BarchFile &file, std::span<std::size_t const> values);
+
+  friend std::size_t tell(BarchFile &file);
+  friend void seek(BarchFile &file, std::size_t position);
+
+private:
+  std::filesystem::path m_path;
+
+  std::fstream m_file;
+
+  void readBytes(void *data, std::size_t size);
+  void writeBytes(const void *data, std::size_t size);
+
+  [[noreturn]] void throwError(const char *reason) const;
+};
+
+} // namespace BarchCLI
+
+#endif // BARCHFILE_HPP
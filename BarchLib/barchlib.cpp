@@ -1,10 +1,18 @@
 #include "barchlib.hpp"
 
-#include <algorithm> // for std::find_if
-#include <cstring>   // for std::memset, std::memcpy
-#include <limits>    // for std::numeric_limits
-#include <new>       // for std::bad_alloc
-#include <utility>   // for std::move
+#include <algorithm>   // for std::all_of, std::max, std::min, std::min_element
+#include <atomic>      // for std::atomic
+#include <bit>         // for std::countl_zero, std::countr_zero, std::popcount
+#include <chrono>      // for std::chrono::steady_clock
+#include <cstring>     // for std::memset, std::memcpy
+#include <exception>   // for std::exception_ptr, std::rethrow_exception
+#include <functional>  // for std::function
+#include <limits>      // for std::numeric_limits
+#include <mutex>       // for std::mutex, std::lock_guard
+#include <new>         // for std::bad_alloc
+#include <thread>      // for std::thread
+#include <type_traits> // for std::integral_constant
+#include <utility>     // for std::exchange, std::move
 
 //******************************************************************************
 
@@ -18,117 +26,593 @@ namespace BarchLib::inline v1::Internal {
   throw InvalidCoordinate{InvalidCoordinate::Y, value};
 }
 
-[[nodiscard]] inline bool isEmpty(const ImmutablePixels pixels) {
-  auto const end = pixels.end();
-  return end == std::find_if(pixels.begin(), end,
-                             [](const Pixel pixel) { return pixel != White; });
-}
-
 constexpr PixelBlock WhiteBlock = combine(White, White, White, White);
 constexpr PixelBlock BlackBlock = combine(Black, Black, Black, Black);
 
-void Encoder::encode(const ImmutablePixels pixels) {
-  std::size_t pixelCount = pixels.size();
-  std::size_t pixelIndex = 0;
-  while (pixelCount >= 4) {
-    write(combine(pixels[pixelIndex + 0], pixels[pixelIndex + 1],
-                  pixels[pixelIndex + 2], pixels[pixelIndex + 3]));
-    pixelCount -= 4;
-    pixelIndex += 4;
-  }
-  // Handle remaining pixels. This happens when pixels are not multiple of four.
-  switch (pixelCount) {
+namespace {
+
+/// EncoderTableEntry holds the codes of eight consecutive blocks that are
+/// either white or black.
+struct EncoderTableEntry final {
+  std::uint16_t bits;
+  std::uint8_t bitCount;
+};
+
+/// Maps a black mask (bit N is on if block N is black) of eight consecutive
+/// blocks to their codes.
+constexpr std::array<EncoderTableEntry, 256> makeEncoderTable() {
+  std::array<EncoderTableEntry, 256> table{};
+  for (std::size_t blackMask = 0; blackMask < table.size(); ++blackMask) {
+    EncoderTableEntry &entry = table[blackMask];
+    for (std::size_t blockIndex = 0; blockIndex < 8; ++blockIndex) {
+      if ((blackMask >> blockIndex) & 1U) {
+        // Bit pattern: 10
+        entry.bits = static_cast<std::uint16_t>((entry.bits << 2) | 0b10U);
+        entry.bitCount += 2;
+      } else {
+        // Bit pattern: 0
+        entry.bits = static_cast<std::uint16_t>(entry.bits << 1);
+        entry.bitCount += 1;
+      }
+    }
+  }
+  return table;
+}
+
+constexpr auto EncoderTable = makeEncoderTable();
+
+/// Calls `function` with the block width as a std::integral_constant, so that
+/// the loops it runs are compiled for that width.
+template <typename Function>
+decltype(auto) withBlockWidth(const std::size_t blockWidth,
+                              Function &&function) {
+  switch (blockWidth) {
+  case 8:
+    return function(std::integral_constant<std::size_t, 8>{});
+  case 16:
+    return function(std::integral_constant<std::size_t, 16>{});
   default:
-    // Nothing to do.
-    break;
-  case 1:
-    write(combine(pixels[pixelIndex + 0], Black, Black, Black));
-    break;
-  case 2:
-    write(
-        combine(pixels[pixelIndex + 0], pixels[pixelIndex + 1], Black, Black));
-    break;
-  case 3:
-    write(combine(pixels[pixelIndex + 0], pixels[pixelIndex + 1],
-                  pixels[pixelIndex + 2], Black));
-    break;
-  }
-}
-
-// clang-format off
-inline void Encoder::write0() { m_output->clear(m_index++); }
-inline void Encoder::write1() { m_output->set  (m_index++); }
-// clang-format on
-
-void Encoder::write(const PixelBlock block) {
-  if (block == WhiteBlock) {
-    write0();
+    return function(std::integral_constant<std::size_t, 4>{});
+  }
+}
+
+/// Turns the classes of 64 blocks into the classes of 32 blocks that are twice
+/// as wide: bit N of the result is on if bits 2N and 2N+1 are on.
+constexpr std::uint64_t foldPairs(std::uint64_t mask) noexcept {
+  mask &= mask >> 1;
+  // Gather the even bits into the low half.
+  mask &= 0x5555'5555'5555'5555U;
+  mask = (mask | (mask >> 1)) & 0x3333'3333'3333'3333U;
+  mask = (mask | (mask >> 2)) & 0x0F0F'0F0F'0F0F'0F0FU;
+  mask = (mask | (mask >> 4)) & 0x00FF'00FF'00FF'00FFU;
+  mask = (mask | (mask >> 8)) & 0x0000'FFFF'0000'FFFFU;
+  mask = (mask | (mask >> 16)) & 0x0000'0000'FFFF'FFFFU;
+  return mask;
+}
+
+/// Same as classifyBlocks(), but for blocks of `Width` pixels. The blocks of 4
+/// pixels are classified by the SIMD kernels, and then folded into wider ones.
+/// Precondition: pixels.size() is a multiple of `Width`, and at most
+/// `Width * BlockClassesCapacity`.
+template <std::size_t Width>
+BlockClasses classifyWideBlocks(const ImmutablePixels pixels) {
+  if constexpr (Width == 4) {
+    return classifyBlocks(pixels);
+  } else {
+    constexpr std::size_t ChunkSize = 4 * BlockClassesCapacity;
+    BlockClasses classes{0, 0};
+    for (std::size_t offset = 0; offset < pixels.size(); offset += ChunkSize) {
+      BlockClasses chunk = classifyBlocks(
+          pixels.subspan(offset, std::min(ChunkSize, pixels.size() - offset)));
+      for (std::size_t width = 4; width < Width; width *= 2) {
+        chunk.white = foldPairs(chunk.white);
+        chunk.black = foldPairs(chunk.black);
+      }
+      classes.white |= chunk.white << (offset / Width);
+      classes.black |= chunk.black << (offset / Width);
+    }
+    return classes;
+  }
+}
+
+/// Splits the blocks of `pixels` into runs of white or black blocks and into
+/// literal blocks. Calls `onRun(color, blockCount)` for every run, and
+/// `onLiteral(block)` for every literal block, in order. The runs are as long
+/// as they can be, even if they span several chunks of blocks.
+/// Precondition: pixels.size() is a multiple of `Width`.
+template <std::size_t Width, typename OnRun, typename OnLiteral>
+void forEachRun(const ImmutablePixels pixels, OnRun &&onRun,
+                OnLiteral &&onLiteral) {
+  const std::size_t blockCount = pixels.size() / Width;
+  Pixel runColor = White;
+  std::size_t runLength = 0;
+  const auto endRun = [&] {
+    if (runLength) { onRun(runColor, runLength); }
+    runLength = 0;
+  };
+  for (std::size_t blockIndex = 0; blockIndex < blockCount;
+       blockIndex += BlockClassesCapacity) {
+    const std::size_t count =
+        std::min(BlockClassesCapacity, blockCount - blockIndex);
+    const ImmutablePixels blockPixels =
+        pixels.subspan(blockIndex * Width, count * Width);
+    const BlockClasses classes = classifyWideBlocks<Width>(blockPixels);
+    std::size_t index = 0;
+    while (index < count) {
+      for (const auto &[color, mask] :
+           {std::pair{White, classes.white}, std::pair{Black, classes.black}}) {
+        if (!((mask >> index) & 1U)) { continue; }
+        if (color != runColor) { endRun(); }
+        const std::size_t length = std::min<std::size_t>(
+            count - index, std::countr_one(mask >> index));
+        runColor = color;
+        runLength += length;
+        index += length;
+        break;
+      }
+      if (index < count && !(((classes.white | classes.black) >> index) & 1U)) {
+        endRun();
+        onLiteral(blockPixels.data() + index * Width);
+        ++index;
+      }
+    }
+  }
+  endRun();
+}
+
+/// Returns the number of bits the code of a run of `blockCount` blocks takes.
+/// Precondition: blockCount is at least MinRunLength.
+constexpr std::size_t runBitCountOf(const std::size_t blockCount) {
+  const std::size_t length = blockCount - (MinRunLength - std::size_t{1});
+  // Bit pattern: 111, the color, and the Elias gamma code of the length.
+  return 4 + std::size_t{2} * static_cast<std::size_t>(std::bit_width(length)) -
+         std::size_t{1};
+}
+
+template <std::size_t Width>
+std::size_t bitCountOfBlocks(const ImmutablePixels pixels,
+                             const CodeFormat &format) {
+  const std::size_t literalBitCount = format.literalBitCount();
+  const std::size_t blockCount = pixels.size() / Width;
+  std::size_t bitCount = 0;
+  if (format.hasRunCodes) {
+    forEachRun<Width>(
+        pixels.first(blockCount * Width),
+        [&bitCount](const Pixel color, const std::size_t count) {
+          bitCount += count >= MinRunLength ? runBitCountOf(count)
+                      : color == White      ? count * 1
+                                            : count * 2;
+        },
+        [&bitCount, literalBitCount](const Pixel *) {
+          bitCount += literalBitCount;
+        });
+  } else {
+    for (std::size_t blockIndex = 0; blockIndex < blockCount;
+         blockIndex += BlockClassesCapacity) {
+      const std::size_t count =
+          std::min(BlockClassesCapacity, blockCount - blockIndex);
+      const BlockClasses classes = classifyWideBlocks<Width>(
+          pixels.subspan(blockIndex * Width, count * Width));
+      const auto whiteCount =
+          static_cast<std::size_t>(std::popcount(classes.white));
+      const auto blackCount =
+          static_cast<std::size_t>(std::popcount(classes.black));
+      const std::size_t literalCount = count - whiteCount - blackCount;
+      bitCount +=
+          whiteCount * 1 + blackCount * 2 + literalCount * literalBitCount;
+    }
+  }
+  // The remaining pixels are padded with black ones. Hence, the last block can
+  // be black, but it cannot be white.
+  const ImmutablePixels tail = pixels.subspan(blockCount * Width);
+  if (!tail.empty()) {
+    const bool isBlack =
+        std::all_of(tail.begin(), tail.end(),
+                    [](const Pixel pixel) { return pixel == Black; });
+    bitCount += isBlack ? 2 : literalBitCount;
+  }
+  return bitCount;
+}
+
+} // namespace
+
+void Encoder::encode(const ImmutablePixels pixels) {
+  withBlockWidth(m_format.blockWidth, [this, pixels](const auto width) {
+    encodeBlocks<decltype(width)::value>(pixels);
+  });
+}
+
+template <std::size_t Width>
+void Encoder::encodeBlocks(const ImmutablePixels pixels) {
+  const std::size_t firstBitIndex = bitIndex();
+  const std::size_t blockCount = pixels.size() / Width;
+  if (m_format.hasRunCodes) {
+    forEachRun<Width>(
+        pixels.first(blockCount * Width),
+        [this](const Pixel color, const std::size_t count) {
+          writeRun(color, count);
+          if constexpr (StatisticsAreEnabled) {
+            if (m_statistics) {
+              (color == White ? m_statistics->whiteBlockCount
+                              : m_statistics->blackBlockCount) += count;
+              m_statistics->runCount += count >= MinRunLength;
+            }
+          }
+        },
+        [this](const Pixel *const block) {
+          writeLiteral<Width>(block);
+          if constexpr (StatisticsAreEnabled) {
+            if (m_statistics) { ++m_statistics->literalBlockCount; }
+          }
+        });
+  } else {
+    for (std::size_t blockIndex = 0; blockIndex < blockCount;
+         blockIndex += BlockClassesCapacity) {
+      const std::size_t count =
+          std::min(BlockClassesCapacity, blockCount - blockIndex);
+      const ImmutablePixels blockPixels =
+          pixels.subspan(blockIndex * Width, count * Width);
+      const BlockClasses classes = classifyWideBlocks<Width>(blockPixels);
+      write<Width>(blockPixels.data(), count, classes);
+      if constexpr (StatisticsAreEnabled) {
+        if (m_statistics) {
+          const auto whiteCount =
+              static_cast<std::size_t>(std::popcount(classes.white));
+          const auto blackCount =
+              static_cast<std::size_t>(std::popcount(classes.black));
+          m_statistics->whiteBlockCount += whiteCount;
+          m_statistics->blackBlockCount += blackCount;
+          m_statistics->literalBlockCount += count - whiteCount - blackCount;
+        }
+      }
+    }
+  }
+  // Handle remaining pixels. This happens when pixels are not multiple of the
+  // block width. They are padded with black ones.
+  const std::size_t pixelCount = pixels.size() % Width;
+  if (pixelCount) {
+    std::array<Pixel, Width> block;
+    block.fill(Black);
+    std::memcpy(block.data(), pixels.data() + blockCount * Width, pixelCount);
+    write<Width>(block.data());
+  }
+  m_writer.flush();
+  if constexpr (StatisticsAreEnabled) {
+    if (m_statistics) {
+      m_statistics->paddingBlockCount += pixelCount != 0;
+      m_statistics->bitCount += bitIndex() - firstBitIndex;
+    }
+  }
+}
+
+std::size_t Encoder::bitCountOf(const ImmutablePixels pixels,
+                                const CodeFormat &format) {
+  return withBlockWidth(format.blockWidth, [pixels, &format](const auto width) {
+    return bitCountOfBlocks<decltype(width)::value>(pixels, format);
+  });
+}
+
+template <std::size_t Width>
+void Encoder::write(const Pixel *const pixels, const std::size_t blockCount,
+                    const BlockClasses classes) {
+  const std::uint64_t literalMask = ~(classes.white | classes.black);
+  std::size_t blockIndex = 0;
+  while (blockIndex < blockCount) {
+    // The blocks before the next literal one are either white or black.
+    const std::size_t literalIndex = std::min<std::size_t>(
+        blockCount, blockIndex + std::countr_zero(literalMask >> blockIndex));
+    while (blockIndex < literalIndex) {
+      const std::size_t whiteCount =
+          std::min<std::size_t>(literalIndex - blockIndex,
+                                std::countr_one(classes.white >> blockIndex));
+      if (whiteCount >= 8) {
+        // Bit pattern: 00000000...
+        for (std::size_t count = whiteCount; count;) {
+          const std::size_t bitCount = std::min(count, bitsPer<Word>);
+          m_writer.write(0U, bitCount);
+          count -= bitCount;
+        }
+        blockIndex += whiteCount;
+        continue;
+      }
+      const std::size_t count =
+          std::min<std::size_t>(8, literalIndex - blockIndex);
+      const std::size_t blackMask =
+          (classes.black >> blockIndex) & ((std::size_t{1} << count) - 1U);
+      // The blocks past `count` are white. Their codes are trailing zeros.
+      const EncoderTableEntry entry = EncoderTable[blackMask];
+      m_writer.write(entry.bits >> (8 - count), entry.bitCount - (8 - count));
+      blockIndex += count;
+    }
+    if (blockIndex < blockCount) {
+      writeLiteral<Width>(pixels + blockIndex * Width);
+      ++blockIndex;
+    }
+  }
+}
+
+template <std::size_t Width>
+inline void Encoder::write(const Pixel *const block) {
+  const auto isFilledWith = [block](const Pixel color) {
+    return std::all_of(block, block + Width,
+                       [color](const Pixel pixel) { return pixel == color; });
+  };
+  if (isFilledWith(White)) {
+    // Bit pattern: 0
+    m_writer.write(0b0U, 1);
     return;
   }
-  if (block == BlackBlock) {
-    write1();
-    write0();
+  if (isFilledWith(Black)) {
+    // Bit pattern: 10
+    m_writer.write(0b10U, 2);
     return;
   }
+  writeLiteral<Width>(block);
+}
 
-  write1();
-  write1();
-  for (PixelBlock bitMask = 0x80'00'00'00U; bitMask; bitMask >>= 1) {
-    (this->*Write[!!(block & bitMask)])();
+template <std::size_t Width>
+inline void Encoder::writeLiteral(const Pixel *const block) {
+  // The pixels are moved 4 at a time, whatever the width of the block is.
+  std::array<PixelBlock, Width / 4> parts;
+  for (std::size_t index = 0; index < parts.size(); ++index) {
+    const Pixel *const part = block + index * 4;
+    parts[index] = combine(part[0], part[1], part[2], part[3]);
+  }
+  // Bit pattern: 11 (or 110 if there are run codes) followed by the 32 bits
+  // of every 4 pixels of the block.
+  const Word prefix = m_format.hasRunCodes ? 0b110U : 0b11U;
+  const std::size_t prefixBitCount = m_format.hasRunCodes ? 3 : 2;
+  if constexpr (bitsPer<Word> >= 3 + bitsPer<PixelBlock>) {
+    m_writer.write((prefix << bitsPer<PixelBlock>) | parts[0],
+                   prefixBitCount + bitsPer<PixelBlock>);
+  } else {
+    m_writer.write(prefix, prefixBitCount);
+    m_writer.write(parts[0], bitsPer<PixelBlock>);
   }
+  for (std::size_t index = 1; index < parts.size(); ++index) {
+    m_writer.write(parts[index], bitsPer<PixelBlock>);
+  }
+}
+
+void Encoder::writeRun(const Pixel color, const std::size_t blockCount) {
+  if (blockCount < MinRunLength) {
+    // Bit pattern: 0 or 10 for every block.
+    const EncoderTableEntry entry =
+        EncoderTable[color == White ? 0U : (1U << blockCount) - 1U];
+    m_writer.write(entry.bits >> (8 - blockCount),
+                   entry.bitCount - (8 - blockCount));
+    return;
+  }
+  // Bit pattern: 111 followed by the color: 0 for white, 1 for black.
+  m_writer.write(color == White ? 0b1110U : 0b1111U, 4);
+  // The Elias gamma code of the length: as many zeros as the length has bits
+  // after the first one, followed by the length.
+  const std::size_t length = blockCount - (MinRunLength - std::size_t{1});
+  const auto zeroCount =
+      static_cast<std::size_t>(std::bit_width(length)) - std::size_t{1};
+  if (zeroCount) { m_writer.write(0U, zeroCount); }
+  m_writer.write(length, zeroCount + 1);
 }
 
+namespace {
+
+/// DecoderTableEntry describes the white and black blocks that are encoded by
+/// a byte of the stream of bits.
+struct DecoderTableEntry final {
+  /// Specifies how many complete white/black codes the byte starts with.
+  std::uint8_t blockCount;
+  /// Holds one bit per code. Bit N is on if code N is a black block.
+  std::uint8_t blackMask;
+};
+
+constexpr std::size_t DecoderTableBits = 8;
+
+constexpr std::array<DecoderTableEntry, std::size_t{1} << DecoderTableBits>
+makeDecoderTable() {
+  std::array<DecoderTableEntry, std::size_t{1} << DecoderTableBits> table{};
+  for (std::size_t byte = 0; byte < table.size(); ++byte) {
+    DecoderTableEntry &entry = table[byte];
+    std::size_t bitIndex = 0;
+    while (bitIndex < DecoderTableBits) {
+      const std::size_t shift = DecoderTableBits - std::size_t{1} - bitIndex;
+      if (!((byte >> shift) & 1U)) {
+        // Bit pattern: 0
+        bitIndex += 1;
+      } else if (bitIndex + 1 < DecoderTableBits &&
+                 !((byte >> (shift - 1)) & 1U)) {
+        // Bit pattern: 10
+        entry.blackMask |= static_cast<std::uint8_t>(1U << entry.blockCount);
+        bitIndex += 2;
+      } else {
+        // Either a literal block or a code that doesn't fit into this byte.
+        break;
+      }
+      ++entry.blockCount;
+    }
+  }
+  return table;
+}
+
+constexpr auto DecoderTable = makeDecoderTable();
+
+/// Holds the bit pattern of consecutive black blocks: 1010...10.
+constexpr Word BlackRun = ~Word{0} / Word{3} * Word{2};
+
+inline void storeBlock(Pixel *const pixels, const PixelBlock block) {
+  const std::array<Pixel, 4> blockPixels = split(block);
+  std::memcpy(pixels, blockPixels.data(), blockPixels.size());
+}
+
+} // namespace
+
 void Decoder::decode(const MutablePixels pixels) {
-  std::size_t pixelCount = pixels.size();
-  std::size_t pixelIndex = 0;
-  while (pixelCount >= 4) {
-    std::array<Pixel, 4> block = split(read());
-    pixels[pixelIndex + 0] = block[0];
-    pixels[pixelIndex + 1] = block[1];
-    pixels[pixelIndex + 2] = block[2];
-    pixels[pixelIndex + 3] = block[3];
-    pixelCount -= 4;
-    pixelIndex += 4;
-  }
-  switch (pixelCount) {
-  default:
-    // Nothing to do.
-    break;
-  case 1: {
-    std::array<Pixel, 4> block = split(read());
-    pixels[pixelIndex + 0] = block[0];
-  } break;
-  case 2: {
-    std::array<Pixel, 4> block = split(read());
-    pixels[pixelIndex + 0] = block[0];
-    pixels[pixelIndex + 1] = block[1];
-  } break;
-  case 3: {
-    std::array<Pixel, 4> block = split(read());
-    pixels[pixelIndex + 0] = block[0];
-    pixels[pixelIndex + 1] = block[1];
-    pixels[pixelIndex + 2] = block[2];
-  } break;
-  } // switch (pixelCount)
-}
-
-bool Decoder::readBit() { return m_input->test(m_index++); }
-
-PixelBlock Decoder::read() {
-  if (!readBit()) {
+  const std::size_t firstBitIndex = bitIndex();
+  const std::size_t pixelCount =
+      withBlockWidth(m_format.blockWidth, [this, pixels](const auto width) {
+        constexpr std::size_t Width = decltype(width)::value;
+        const std::size_t blockCount = pixels.size() / Width;
+        decodeBlocks<true, Width>(pixels.data(), blockCount);
+        // Handle remaining pixels. This happens when pixels are not multiple
+        // of the block width.
+        const std::size_t pixelCount = pixels.size() % Width;
+        if (pixelCount) {
+          std::array<Pixel, Width> block;
+          read<Width>(block.data());
+          std::memcpy(pixels.data() + blockCount * Width, block.data(),
+                      pixelCount);
+        }
+        return pixelCount;
+      });
+  if constexpr (StatisticsAreEnabled) {
+    if (m_statistics) {
+      m_statistics->paddingBlockCount += pixelCount != 0;
+      m_statistics->bitCount += bitIndex() - firstBitIndex;
+    }
+  }
+}
+
+void Decoder::skip(const std::size_t blockCount) {
+  withBlockWidth(m_format.blockWidth, [this, blockCount](const auto width) {
+    decodeBlocks<false, decltype(width)::value>(nullptr, blockCount);
+  });
+}
+
+template <bool Store, std::size_t Width>
+void Decoder::decodeBlocks(Pixel *output, std::size_t blockCount) {
+  // Only the blocks that are stored are counted.
+  CodecStatistics *const statistics =
+      StatisticsAreEnabled && Store ? m_statistics : nullptr;
+  const auto fill = [&output, statistics](const Pixel color,
+                                          const std::size_t count) {
+    if constexpr (Store) {
+      std::memset(output, color, count * Width);
+      output += count * Width;
+    }
+    if constexpr (StatisticsAreEnabled) {
+      if (statistics) {
+        (color == White ? statistics->whiteBlockCount
+                        : statistics->blackBlockCount) += count;
+      }
+    }
+  };
+  while (blockCount) {
+    const Word window = m_reader.peek();
+    // Runs of white blocks are runs of clear bits.
+    if (const std::size_t whiteCount = std::countl_zero(window);
+        whiteCount >= DecoderTableBits) {
+      const std::size_t count = std::min(whiteCount, blockCount);
+      fill(White, count);
+      m_reader.consume(count);
+      blockCount -= count;
+      continue;
+    }
+    // So are runs of black blocks, except that their bits alternate.
+    if (window == BlackRun) {
+      const std::size_t count = std::min(bitsPer<Word> / 2, blockCount);
+      fill(Black, count);
+      m_reader.consume(count * 2);
+      blockCount -= count;
+      continue;
+    }
+    // Several white and black blocks can be decoded at once.
+    const DecoderTableEntry entry =
+        DecoderTable[window >> (bitsPer<Word> - DecoderTableBits)];
+    if (entry.blockCount) {
+      const std::size_t count =
+          std::min<std::size_t>(entry.blockCount, blockCount);
+      const unsigned blackMask = entry.blackMask & ((1U << count) - 1U);
+      for (std::size_t blockIndex = 0; blockIndex < count; ++blockIndex) {
+        fill((blackMask >> blockIndex) & 1U ? Black : White, 1);
+      }
+      m_reader.consume(count +
+                       static_cast<std::size_t>(std::popcount(blackMask)));
+      blockCount -= count;
+      continue;
+    }
+    // Bit pattern: 111 followed by the color.
+    if (m_format.hasRunCodes && ((window >> (bitsPer<Word> - 3)) & 1U)) {
+      const Pixel color =
+          (window >> (bitsPer<Word> - 4)) & 1U ? Black : White;
+      m_reader.consume(4);
+      // A run never spans several rows. Hence, it's only cut short if the
+      // stream is broken.
+      const std::size_t count = std::min(readRunLength(), blockCount);
+      fill(color, count);
+      if constexpr (StatisticsAreEnabled) {
+        if (statistics) { ++statistics->runCount; }
+      }
+      blockCount -= count;
+      continue;
+    }
+    // Bit pattern: 11 (or 110 if there are run codes)
+    if constexpr (Store) {
+      readLiteral<Width>(output);
+      output += Width;
+    } else {
+      // The pixels are skipped 4 at a time, just like they were written.
+      m_reader.consume(m_format.hasRunCodes ? 3 : 2);
+      for (std::size_t offset = 0; offset < Width; offset += 4) {
+        m_reader.consume(bitsPer<PixelBlock>);
+      }
+    }
+    if constexpr (StatisticsAreEnabled) {
+      if (statistics) { ++statistics->literalBlockCount; }
+    }
+    --blockCount;
+  }
+}
+
+template <std::size_t Width> void Decoder::read(Pixel *const block) {
+  const Word window = m_reader.peek();
+  if (!(window >> (bitsPer<Word> - 1))) {
     // Bit pattern: 0
-    return WhiteBlock;
+    m_reader.consume(1);
+    std::memset(block, White, Width);
+    return;
   }
-  if (!readBit()) {
+  if (!((window >> (bitsPer<Word> - 2)) & 1U)) {
     // Bit pattern: 10
-    return BlackBlock;
+    m_reader.consume(2);
+    std::memset(block, Black, Width);
+    return;
+  }
+  // Bit pattern: 11 (or 110 if there are run codes). A single block is only
+  // read for the last pixels of a row, and these never make up a run.
+  readLiteral<Width>(block);
+}
+
+template <std::size_t Width> void Decoder::readLiteral(Pixel *const block) {
+  // Bit pattern: 11 (or 110 if there are run codes) followed by the 32 bits
+  // of every 4 pixels of the block.
+  const std::size_t prefixBitCount = m_format.hasRunCodes ? 3 : 2;
+  std::size_t offset = 0;
+  if constexpr (bitsPer<Word> >= 3 + bitsPer<PixelBlock>) {
+    const Word window = m_reader.peek();
+    m_reader.consume(prefixBitCount + bitsPer<PixelBlock>);
+    storeBlock(block, static_cast<PixelBlock>(
+                          window >> (bitsPer<Word> - prefixBitCount -
+                                     bitsPer<PixelBlock>)));
+    offset = 4;
+  } else {
+    m_reader.consume(prefixBitCount);
   }
-  // Bit pattern: 11
-  PixelBlock result = 0;
-  for (PixelBlock bitMask = 0x80'00'00'00U; bitMask; bitMask >>= 1) {
-    if (readBit()) { result |= bitMask; }
+  for (; offset < Width; offset += 4) {
+    storeBlock(block + offset,
+               static_cast<PixelBlock>(m_reader.peek() >>
+                                       (bitsPer<Word> - bitsPer<PixelBlock>)));
+    m_reader.consume(bitsPer<PixelBlock>);
   }
-  return result;
+}
+
+std::size_t Decoder::readRunLength() {
+  // The Elias gamma code of the length: N zeros, then the N + 1 bits of it. A
+  // broken stream may have more zeros than that, but the window doesn't.
+  const auto zeroCount = std::min<std::size_t>(
+      std::countl_zero(m_reader.peek()), bitsPer<Word> - std::size_t{1});
+  m_reader.consume(zeroCount);
+  const Word length = m_reader.peek() >> (bitsPer<Word> - zeroCount - 1);
+  m_reader.consume(zeroCount + 1);
+  return length + (MinRunLength - std::size_t{1});
 }
 
 } // namespace BarchLib::inline v1::Internal
@@ -152,6 +636,22 @@ const char *InvalidSize::what() const noexcept {
   }
 }
 
+const char *InvalidFormat::what() const noexcept {
+  switch (m_reason) {
+  case UnsupportedVersion:
+    return "An error occurred while loading the bitmap. "
+           "It was saved by a newer version of BarchLib.";
+  case UnsupportedFeatures:
+    return "An error occurred while loading the bitmap. "
+           "It uses features that this version of BarchLib doesn't support.";
+  case CorruptData:
+    return "An error occurred while loading the bitmap. Corrupt data.";
+  default:
+    return "An error occurred while loading the bitmap. "
+           "The format is invalid.";
+  }
+}
+
 const char *InvalidCoordinate::what() const noexcept {
   switch (m_kind) {
   case X:
@@ -166,6 +666,25 @@ const char *InvalidCoordinate::what() const noexcept {
   }
 }
 
+const char *Cancelled::what() const noexcept {
+  return "The operation was cancelled.";
+}
+
+CodecStatistics &
+CodecStatistics::operator+=(const CodecStatistics &other) noexcept {
+  emptyRowCount += other.emptyRowCount;
+  whiteBlockCount += other.whiteBlockCount;
+  blackBlockCount += other.blackBlockCount;
+  literalBlockCount += other.literalBlockCount;
+  runCount += other.runCount;
+  paddingBlockCount += other.paddingBlockCount;
+  bitCount += other.bitCount;
+  scanningTime += other.scanningTime;
+  codingTime += other.codingTime;
+  splicingTime += other.splicingTime;
+  return *this;
+}
+
 namespace Internal {
 
 BitmapSize::BitmapSize(const std::size_t width, const std::size_t height)
@@ -184,27 +703,35 @@ BitmapSize::BitmapSize(const std::size_t width, const std::size_t height)
 } // namespace Internal
 
 Bitmap::Bitmap(const std::size_t width, const std::size_t height,
-               const Pixel background)
+               const Pixel background,
+               std::pmr::memory_resource *const resource)
+    : Bitmap{width, height, uninitialized, resource} {
+  // Could've used fill_n here, but it's slower (especially in debug).
+  std::memset(data(), background, pixelCount());
+}
+
+Bitmap::Bitmap(const std::size_t width, const std::size_t height,
+               Uninitialized, std::pmr::memory_resource *const resource)
     : m_size{width, height} {
+  const std::size_t dataSize = width * height;
+  // Some allocators round the size up to the alignment without checking for
+  // overflow, and happily hand out a tiny block instead of throwing.
+  if (dataSize > std::numeric_limits<std::size_t>::max() - PixelAlignment) {
+    throw InvalidSize{width, height, InvalidSize::TooLarge};
+  }
   try {
-    std::size_t dataSize = width * height;
-    m_data = std::make_unique<Pixel[]>(dataSize);
-    // Could've used fill_n here, but it's slower (especially in debug).
-    std::memset(m_data.get(), background, dataSize);
+    void *const pixels = resource->allocate(dataSize, PixelAlignment);
+    m_data = {static_cast<Pixel *>(pixels), PixelDeleter{resource, dataSize}};
   } catch (std::bad_alloc &) {
     throw InvalidSize{width, height, InvalidSize::TooLarge};
   }
 }
 
-Bitmap::Bitmap(const Bitmap &other) : m_size{other.m_size} {
-  std::size_t const pixelCount = other.pixelCount();
-  m_data = std::make_unique<Pixel[]>(pixelCount);
-  std::memcpy(m_data.get(), other.data(), pixelCount);
+Bitmap::Bitmap(const Bitmap &other, std::pmr::memory_resource *const resource)
+    : Bitmap{other.width(), other.height(), uninitialized, resource} {
+  std::memcpy(data(), other.data(), pixelCount());
 }
 
-Bitmap::Bitmap(Bitmap &&other) noexcept
-    : m_size{other.m_size}, m_data{std::move(other.m_data)} {}
-
 MutablePixels Bitmap::rowAt(const std::size_t y) {
   if (y >= height()) { Internal::throwInvalidY(y); };
   return {data() + y * width(), width()};
@@ -215,6 +742,31 @@ ImmutablePixels Bitmap::rowAt(const std::size_t y) const {
   return {data() + y * width(), width()};
 }
 
+BitmapView::BitmapView(const Pixel *const data, const std::size_t width,
+                       const std::size_t height, const std::size_t stride)
+    : m_data{data}, m_size{width, height}, m_stride{stride} {
+  if (stride < width) {
+    throw InvalidSize{stride, height, InvalidSize::TooSmall};
+  }
+}
+
+ImmutablePixels BitmapView::rowAt(const std::size_t y) const {
+  if (y >= height()) { Internal::throwInvalidY(y); }
+  return {m_data + y * m_stride, width()};
+}
+
+bool isEmpty(const BitmapView &bitmap) {
+  if (bitmap.stride() == bitmap.width()) {
+    // The rows are contiguous, so they can be scanned all at once.
+    return Internal::isEmpty(
+        ImmutablePixels{bitmap.data(), bitmap.width() * bitmap.height()});
+  }
+  for (std::size_t y = 0; y < bitmap.height(); ++y) {
+    if (!Internal::isEmpty(bitmap.rowAt(y))) { return false; }
+  }
+  return true;
+}
+
 Pixel &Bitmap::pixelAt(const std::size_t x, const std::size_t y) {
   if (x >= width()) { Internal::throwInvalidX(x); }
   if (y >= height()) { Internal::throwInvalidY(y); }
@@ -229,7 +781,9 @@ Pixel const &Bitmap::pixelAt(const std::size_t x, const std::size_t y) const {
 
 namespace Internal {
 
-BitSet::BitSet(const std::size_t bitCount) {
+BitSet::BitSet(const std::size_t bitCount,
+               std::pmr::memory_resource *const resource)
+    : m_words{resource} {
   const std::size_t maxPadding = bitsPer<Word> - std::size_t{1};
   // Align the number of bits, so we get a whole number of words.
   const std::size_t alignedBitCount = (bitCount + maxPadding) & ~maxPadding;
@@ -238,12 +792,7 @@ BitSet::BitSet(const std::size_t bitCount) {
 }
 
 bool BitSet::test(const std::size_t bitIndex) const {
-  auto const [wordIndex, bitMask] = toWord(bitIndex);
-  if (wordIndex >= m_words.size()) {
-    // Out of range bits are considered to be off.
-    return false;
-  }
-  return static_cast<bool>(m_words[wordIndex] & bitMask);
+  return BitSpan{m_words}.test(bitIndex);
 }
 
 void BitSet::set(const std::size_t bitIndex) {
@@ -263,6 +812,86 @@ void BitSet::clear(const std::size_t bitIndex) {
   m_words[wordIndex] &= ~bitMask;
 }
 
+void BitWriter::write(const BitSet &bits, const std::size_t bitCount) {
+  const std::span<Word const> words = bits.words();
+  const std::size_t wholeWordCount = bitCount / bitsPer<Word>;
+  for (std::size_t wordIndex = 0; wordIndex < wholeWordCount; ++wordIndex) {
+    // Out of range bits are considered to be off.
+    write(wordIndex < words.size() ? words[wordIndex] : Word{0},
+          bitsPer<Word>);
+  }
+  if (const std::size_t tailBitCount = bitCount % bitsPer<Word>) {
+    const Word tail =
+        wholeWordCount < words.size() ? words[wholeWordCount] : Word{0};
+    write(tail >> (bitsPer<Word> - tailBitCount), tailBitCount);
+  }
+}
+
+void BitWriter::flush() {
+  if (m_freeBitCount != bitsPer<Word>) { store(m_wordIndex, m_buffer); }
+}
+
+void BitWriter::discardCompleteWords() {
+  std::pmr::vector<Word> &words = m_output->m_words;
+  const auto discardedWordCount = static_cast<std::ptrdiff_t>(
+      std::min(completeWordCount(), words.size()));
+  words.erase(words.begin(), words.begin() + discardedWordCount);
+  m_firstWordIndex = m_wordIndex;
+}
+
+void BitWriter::store(std::size_t wordIndex, const Word word) {
+  std::pmr::vector<Word> &words = m_output->m_words;
+  wordIndex -= m_firstWordIndex;
+  if (wordIndex >= words.size()) {
+    // Out of range bits are considered to be off. There's no need to store
+    // them, unless they are followed by some bits that are on.
+    if (!word) { return; }
+    words.resize(wordIndex + std::size_t{1});
+  }
+  words[wordIndex] = word;
+}
+
+void BitSet::reserve(const std::size_t bitCount) {
+  m_words.reserve(align(bitCount, bitsPer<Word>) / bitsPer<Word>);
+}
+
+std::size_t BitSet::count(const std::size_t firstBit,
+                          const std::size_t lastBit) const noexcept {
+  return BitSpan{m_words}.count(firstBit, lastBit);
+}
+
+bool BitSpan::test(const std::size_t bitIndex) const noexcept {
+  auto const [wordIndex, bitMask] = BitSet::toWord(bitIndex);
+  if (wordIndex >= m_words.size()) {
+    // Out of range bits are considered to be off.
+    return false;
+  }
+  return static_cast<bool>(m_words[wordIndex] & bitMask);
+}
+
+std::size_t BitSpan::count(const std::size_t firstBit,
+                           const std::size_t lastBit) const noexcept {
+  // Out of range bits are considered to be off.
+  const std::size_t endBit = std::min(lastBit, m_words.size() * bitsPer<Word>);
+  if (firstBit >= endBit) { return 0; }
+  const std::size_t firstWord = firstBit / bitsPer<Word>;
+  const std::size_t lastWord = (endBit - std::size_t{1}) / bitsPer<Word>;
+  // Bits are stored starting with the most significant one.
+  const Word firstMask = ~Word{0} >> (firstBit % bitsPer<Word>);
+  const Word lastMask = ~Word{0}
+                        << (bitsPer<Word> - std::size_t{1} -
+                            (endBit - std::size_t{1}) % bitsPer<Word>);
+  if (firstWord == lastWord) {
+    return std::popcount(m_words[firstWord] & firstMask & lastMask);
+  }
+  std::size_t result = std::popcount(m_words[firstWord] & firstMask);
+  for (std::size_t wordIndex = firstWord + 1; wordIndex < lastWord;
+       ++wordIndex) {
+    result += std::popcount(m_words[wordIndex]);
+  }
+  return result + std::popcount(m_words[lastWord] & lastMask);
+}
+
 std::pair<std::size_t /* wordIndex */, Word /* bitMask */>
 BitSet::toWord(const std::size_t bitIndex) {
   // NOTE: assumes that only 32-bit and 64-bit targets are supported.
@@ -278,48 +907,1150 @@ BitSet::toWord(const std::size_t bitIndex) {
 } // namespace Internal
 
 CompressedBitmap::CompressedBitmap(const std::size_t width,
-                                   const std::size_t height)
-    : m_size{width, height}, m_rowLookupTable{height} {}
+                                   const std::size_t height,
+                                   std::pmr::memory_resource *const resource)
+    : m_size{width, height}, m_rowLookupTable{height, resource},
+      m_pixelData{0, resource} {}
 
 bool CompressedBitmap::isEmptyRowAt(const std::size_t y) const {
+  return static_cast<CompressedBitmapView>(*this).isEmptyRowAt(y);
+}
+
+void CompressedBitmap::buildRowIndex(const std::size_t rowGroupSize) {
+  if (isTiled()) { return; }
+  m_rowGroupSize = std::min(rowGroupSize, height());
+  m_rowIndex.resize(rowGroupCount());
+  Internal::Decoder rowDecoder{m_pixelData, m_codeFormat};
+  for (std::size_t groupIndex = 0; groupIndex < m_rowIndex.size();
+       ++groupIndex) {
+    m_rowIndex[groupIndex] = rowDecoder.bitIndex();
+    const std::size_t firstY = groupIndex * m_rowGroupSize;
+    const std::size_t rowCount = m_rowLookupTable.count(
+        firstY, std::min(firstY + m_rowGroupSize, height()));
+    rowDecoder.skipRows(rowCount, width());
+  }
+}
+
+void CompressedBitmap::validateIndex() const {
+  static_cast<CompressedBitmapView>(*this).validateIndex();
+}
+
+CompressedBitmap::operator CompressedBitmapView() const noexcept {
+  return CompressedBitmapView{m_size,
+                              m_rowLookupTable.words(),
+                              m_pixelData.words(),
+                              m_rowGroupSize,
+                              m_rowIndex,
+                              m_tileSize,
+                              m_tileIndex,
+                              m_codeFormat};
+}
+
+namespace Internal {
+
+/// ProgressReporter passes the progress of a job on to a ProgressHandler no
+/// more often than once per interval, and stops the job once it's cancelled.
+/// Every thread counts its rows with a ProgressCounter, so that the threads
+/// don't contend for the reporter on every row.
+struct [[nodiscard]] ProgressReporter final {
+  using Clock = std::chrono::steady_clock;
+
+  /// Reports that the job has started.
+  /// Throws Cancelled if the job was cancelled already.
+  ProgressReporter(const ProgressHandler &progress, const std::size_t stepCount,
+                   const std::chrono::milliseconds interval,
+                   const CancellationToken *const cancellation)
+      : m_progress{&progress}, m_totalStepCount{stepCount},
+        m_interval{interval}, m_cancellation{cancellation} {
+    throwIfCancelled();
+    (*m_progress)(0, m_totalStepCount);
+    m_nextReportTime = Clock::now() + m_interval;
+  }
+
+  ProgressReporter(const ProgressReporter &) = delete;
+  ProgressReporter &operator=(const ProgressReporter &) = delete;
+
+  /// Returns how many steps a ProgressCounter counts before it checks in.
+  std::size_t stepsPerCheck() const noexcept {
+    return m_interval.count() ? StepsPerCheck : 1;
+  }
+
+  /// Adds the steps that were done. Reports the progress unless it was
+  /// reported less than an interval ago, or another thread is reporting it.
+  /// Throws Cancelled if the job was cancelled.
+  void advance(const std::size_t stepCount) {
+    m_stepCount.fetch_add(stepCount, std::memory_order_relaxed);
+    throwIfCancelled();
+    const std::unique_lock lock{m_mutex, std::try_to_lock};
+    if (!lock.owns_lock()) { return; }
+    if (m_interval.count() && Clock::now() < m_nextReportTime) { return; }
+    report(m_stepCount.load(std::memory_order_relaxed));
+  }
+
+  /// Reports that all the steps are done.
+  void finish() {
+    const std::lock_guard lock{m_mutex};
+    if (m_reportedStepCount != m_totalStepCount) { report(m_totalStepCount); }
+  }
+
+private:
+  /// Specifies how many rows a thread does between two checks. It's small
+  /// enough to stop a job in a blink, and large enough for the checks not to
+  /// show up in a profile.
+  static constexpr std::size_t StepsPerCheck = 16;
+
+  const ProgressHandler *m_progress;
+  std::size_t m_totalStepCount;
+  std::chrono::milliseconds m_interval;
+  const CancellationToken *m_cancellation;
+
+  /// Holds the number of steps the threads checked in with.
+  std::atomic<std::size_t> m_stepCount{0};
+
+  /// Guards the members below, and serializes the calls of the handler.
+  std::mutex m_mutex;
+  std::size_t m_reportedStepCount{0};
+  Clock::time_point m_nextReportTime;
+
+  void throwIfCancelled() const {
+    if (m_cancellation && m_cancellation->isCancelled()) { throw Cancelled{}; }
+  }
+
+  /// Precondition: the mutex is locked, or there's only one thread.
+  void report(const std::size_t stepCount) {
+    // The steps of another thread may have been reported in the meantime.
+    if (stepCount <= m_reportedStepCount) { return; }
+    (*m_progress)(stepCount, m_totalStepCount);
+    m_reportedStepCount = stepCount;
+    if (m_interval.count()) { m_nextReportTime = Clock::now() + m_interval; }
+  }
+};
+
+namespace {
+
+/// ProgressCounter counts the steps of one thread, and passes them on to a
+/// ProgressReporter a few at a time.
+struct [[nodiscard]] ProgressCounter final {
+
+  explicit ProgressCounter(ProgressReporter &reporter) noexcept
+      : m_reporter{&reporter}, m_stepsPerCheck{reporter.stepsPerCheck()} {}
+
+  /// Throws Cancelled if the job was cancelled.
+  void step(const std::size_t stepCount = 1) {
+    m_stepCount += stepCount;
+    if (m_stepCount >= m_stepsPerCheck) { flush(); }
+  }
+
+  /// Passes on the steps that were counted since the last check.
+  /// Throws Cancelled if the job was cancelled.
+  void flush() {
+    if (m_stepCount) { m_reporter->advance(std::exchange(m_stepCount, 0)); }
+  }
+
+private:
+  ProgressReporter *m_reporter;
+  std::size_t m_stepsPerCheck;
+  std::size_t m_stepCount{0};
+};
+
+/// WordSpanReader reads the words of a compressed bitmap that was saved into
+/// memory. Instead of copying them, it hands out the spans they occupy.
+struct WordSpanReader final {
+  std::span<Word const> words;
+  std::size_t wordIndex = 0;
+
+  /// Returns the next `wordCount` words.
+  /// Throws InvalidFormat if there are fewer words left.
+  std::span<Word const> take(const std::size_t wordCount) {
+    if (wordCount > words.size() - wordIndex) {
+      throw InvalidFormat{InvalidFormat::CorruptData};
+    }
+    const std::span<Word const> result = words.subspan(wordIndex, wordCount);
+    wordIndex += wordCount;
+    return result;
+  }
+};
+
+void read(WordSpanReader &reader, std::size_t &value) {
+  value = reader.take(1)[0];
+}
+
+} // namespace
+} // namespace Internal
+
+CompressedBitmapView::CompressedBitmapView(
+    const std::span<Internal::Word const> words)
+    : m_size{1, 1} {
+  using namespace Internal;
+  WordSpanReader reader{words};
+  const Word features = loadHeader(reader, m_size);
+  std::size_t lookupTableBitCount = height();
+  if (features & TiledFeature) {
+    read(reader, m_tileSize);
+    if (!m_tileSize) { throw InvalidFormat{InvalidFormat::CorruptData}; }
+    lookupTableBitCount = tileGrid().tileCount();
+  }
+  m_codeFormat = loadCodeFormat(reader, features);
+  m_rowLookupTable =
+      reader.take(align(lookupTableBitCount, bitsPer<Word>) / bitsPer<Word>);
+  std::size_t numDataWords = 0;
+  read(reader, numDataWords);
+  m_pixelData = reader.take(numDataWords);
+  if (features & RowIndexFeature) {
+    read(reader, m_rowGroupSize);
+    if (!m_rowGroupSize || m_rowGroupSize > height()) {
+      throw InvalidFormat{InvalidFormat::CorruptData};
+    }
+    m_rowIndex = reader.take(rowGroupCount());
+  }
+  if (features & TiledFeature) {
+    m_tileIndex = reader.take(tileGrid().tileCount());
+  }
+  validateIndex();
+}
+
+bool CompressedBitmapView::isEmptyRowAt(const std::size_t y) const {
   if (y >= height()) { Internal::throwInvalidY(y); }
-  return !m_rowLookupTable.test(y);
+  if (!isTiled()) { return !m_rowLookupTable.test(y); }
+  // Non-empty tiles may still have empty rows. There's no way to tell, other
+  // than decoding the row.
+  const Internal::TileGrid grid = tileGrid();
+  const std::size_t firstTile = y / m_tileSize * grid.columnCount();
+  if (!m_rowLookupTable.count(firstTile, firstTile + grid.columnCount())) {
+    return true;
+  }
+  std::vector<Pixel> pixels(width());
+  decodeTiledRow(y, pixels);
+  return Internal::isEmpty(pixels);
+}
+
+void CompressedBitmapView::validateIndex() const {
+  // The entries may point past the saved pixel data: the trailing words that
+  // are 0 are never saved. Decoders read those words as 0, that is, as white
+  // blocks, so only the order of the entries matters.
+  for (const std::span<Internal::Word const> index :
+       {m_rowIndex, m_tileIndex}) {
+    Internal::Word previousEntry = 0;
+    for (const Internal::Word entry : index) {
+      if (entry < previousEntry) {
+        throw InvalidFormat{InvalidFormat::CorruptData};
+      }
+      previousEntry = entry;
+    }
+  }
+}
+
+void CompressedBitmapView::decodeTiledRow(const std::size_t y,
+                                          const MutablePixels pixels) const {
+  const Internal::TileGrid grid = tileGrid();
+  const std::size_t row = y / m_tileSize;
+  const std::size_t rowInTile = y % m_tileSize;
+  for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+    const std::size_t tileIndex = row * grid.columnCount() + column;
+    const std::size_t tileWidth = grid.tileWidth(column);
+    const MutablePixels tilePixels =
+        pixels.subspan(column * m_tileSize, tileWidth);
+    if (!m_rowLookupTable.test(tileIndex)) {
+      std::memset(tilePixels.data(), White, tilePixels.size());
+      continue;
+    }
+    Internal::Decoder tileDecoder{m_pixelData, m_tileIndex[tileIndex],
+                                  m_codeFormat};
+    tileDecoder.skipRows(rowInTile, tileWidth);
+    tileDecoder.decode(tilePixels);
+  }
+}
+
+void CompressedBitmapView::decodeTiles(
+    const std::size_t firstRow, const std::size_t lastRow,
+    const Internal::RowSink &sink, Internal::ProgressReporter &progress,
+    CodecStatistics *const statistics) const {
+  const Internal::TileGrid grid = tileGrid();
+  Internal::ProgressCounter rowProgress{progress};
+  for (std::size_t row = firstRow; row < lastRow; ++row) {
+    const std::size_t firstY = row * m_tileSize;
+    const std::size_t lastY = firstY + grid.tileHeight(row);
+    for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+      const std::size_t tileIndex = row * grid.columnCount() + column;
+      const std::size_t x = column * m_tileSize;
+      const std::size_t tileWidth = grid.tileWidth(column);
+      if (!m_rowLookupTable.test(tileIndex)) {
+        if (statistics) { statistics->emptyRowCount += lastY - firstY; }
+        if (sink.isWhite) { continue; }
+        for (std::size_t y = firstY; y < lastY; ++y) {
+          std::memset(rowAt(sink, y).data() + x, White, tileWidth);
+        }
+        continue;
+      }
+      Internal::Decoder tileDecoder{m_pixelData, m_tileIndex[tileIndex],
+                                    m_codeFormat};
+      tileDecoder.collectStatistics(statistics);
+      for (std::size_t y = firstY; y < lastY; ++y) {
+        tileDecoder.decode(rowAt(sink, y).subspan(x, tileWidth));
+      }
+    }
+    rowProgress.step(lastY - firstY);
+  }
+  rowProgress.flush();
+}
+
+MutablePixels CompressedBitmapView::rowAt(const Internal::RowSink &sink,
+                                          const std::size_t y) const {
+  const MutablePixels pixels = sink.rowAt(y);
+  if (pixels.size() != width()) {
+    throw InvalidSize{pixels.size(), 1,
+                      pixels.size() < width() ? InvalidSize::TooSmall
+                                              : InvalidSize::TooLarge};
+  }
+  return pixels;
+}
+
+Internal::Decoder CompressedBitmapView::decoderAt(const std::size_t y) const {
+  std::size_t firstY = 0;
+  std::size_t bitIndex = 0;
+  if (hasRowIndex()) {
+    firstY = y - y % m_rowGroupSize;
+    bitIndex = m_rowIndex[y / m_rowGroupSize];
+  }
+  Internal::Decoder rowDecoder{m_pixelData, bitIndex, m_codeFormat};
+  rowDecoder.skipRows(m_rowLookupTable.count(firstY, y), width());
+  return rowDecoder;
+}
+
+CompressedBitmap compress(const BitmapView &sourceBitmap,
+                          const ProgressHandler progress) {
+  return compress(sourceBitmap, CompressionOptions{}, progress);
+}
+
+namespace Internal {
+namespace {
+
+/// Returns the number of bits the rows in range [firstY, lastY) take once
+/// they are encoded in the given code format.
+std::size_t compressedSizeOf(const BitmapView &bitmap, const std::size_t firstY,
+                             const std::size_t lastY,
+                             const CodeFormat &format) {
+  std::size_t bitCount = 0;
+  for (std::size_t y = firstY; y < lastY; ++y) {
+    const ImmutablePixels row = bitmap.rowAt(y);
+    if (!isEmpty(row)) { bitCount += Encoder::bitCountOf(row, format); }
+  }
+  return bitCount;
+}
+
+/// Returns the code format with the block width that BlockWidth stands for.
+/// BlockWidth::Auto picks the width that takes the fewest bits for up to 64
+/// non-empty rows, spread evenly over the bitmap. Ties go to the narrower
+/// blocks. Tiles are encoded the same way rows are, so the whole rows are a
+/// fair sample of them too.
+CodeFormat resolveCodeFormat(const BitmapView &bitmap,
+                             const BlockWidth blockWidth,
+                             const bool runLengthCodes) {
+  if (blockWidth != BlockWidth::Auto) {
+    return {static_cast<std::size_t>(blockWidth), runLengthCodes};
+  }
+  constexpr std::size_t SampleRowCount = 64;
+  constexpr std::array<std::size_t, 3> BlockWidths{4, 8, 16};
+  std::array<std::size_t, BlockWidths.size()> bitCounts{};
+  const std::size_t step =
+      std::max(bitmap.height() / SampleRowCount, std::size_t{1});
+  for (std::size_t y = 0; y < bitmap.height(); y += step) {
+    const ImmutablePixels row = bitmap.rowAt(y);
+    if (isEmpty(row)) { continue; }
+    for (std::size_t index = 0; index < BlockWidths.size(); ++index) {
+      bitCounts[index] +=
+          Encoder::bitCountOf(row, {BlockWidths[index], runLengthCodes});
+    }
+  }
+  return {BlockWidths[static_cast<std::size_t>(
+              std::min_element(bitCounts.begin(), bitCounts.end()) -
+              bitCounts.begin())],
+          runLengthCodes};
+}
+
+} // namespace
+} // namespace Internal
+
+std::size_t compressedSizeOf(const BitmapView &bitmap,
+                             const BlockWidth blockWidth,
+                             const bool runLengthCodes) {
+  return Internal::compressedSizeOf(
+      bitmap, 0, bitmap.height(),
+      Internal::resolveCodeFormat(bitmap, blockWidth, runLengthCodes));
+}
+
+std::size_t CompressedBitmap::encodeRows(const BitmapView &sourceBitmap,
+                                         const std::size_t firstY,
+                                         const std::size_t lastY,
+                                         Internal::BitSet &pixelData,
+                                         Internal::ProgressReporter &progress,
+                                         CodecStatistics *const statistics) {
+  // Growing the pixel data one word at a time is way slower than figuring out
+  // its size up front.
+  pixelData.reserve(
+      Internal::compressedSizeOf(sourceBitmap, firstY, lastY, m_codeFormat));
+  Internal::Encoder rowEncoder{pixelData, statistics, m_codeFormat};
+  Internal::ProgressCounter rowProgress{progress};
+  for (std::size_t y = firstY; y < lastY; ++y) {
+    if (hasRowIndex() && y % m_rowGroupSize == 0) {
+      m_rowIndex[y / m_rowGroupSize] = rowEncoder.bitIndex();
+    }
+    const ImmutablePixels currentRow = sourceBitmap.rowAt(y);
+    if (Internal::isEmpty(currentRow)) {
+      // Empty rows are skipped. The corresponding entry in the lookup table is
+      // set to 0 anyways.
+      if (statistics) { ++statistics->emptyRowCount; }
+    } else {
+      m_rowLookupTable.set(y);
+      rowEncoder.encode(currentRow);
+    }
+    rowProgress.step();
+  }
+  rowProgress.flush();
+  return rowEncoder.bitIndex();
+}
+
+std::size_t CompressedBitmap::encodeTiles(const BitmapView &sourceBitmap,
+                                          const std::size_t firstRow,
+                                          const std::size_t lastRow,
+                                          Internal::BitSet &pixelData,
+                                          Internal::ProgressReporter &progress,
+                                          CodecStatistics *const statistics) {
+  const Internal::TileGrid grid = tileGrid();
+  Internal::Encoder tileEncoder{pixelData, statistics, m_codeFormat};
+  Internal::ProgressCounter rowProgress{progress};
+  for (std::size_t row = firstRow; row < lastRow; ++row) {
+    const std::size_t firstY = row * m_tileSize;
+    const std::size_t lastY = firstY + grid.tileHeight(row);
+    for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+      m_tileIndex[row * grid.columnCount() + column] = tileEncoder.bitIndex();
+      const std::size_t x = column * m_tileSize;
+      const std::size_t tileWidth = grid.tileWidth(column);
+      const auto tileRowAt = [&](const std::size_t y) {
+        return sourceBitmap.rowAt(y).subspan(x, tileWidth);
+      };
+      // Empty tiles are skipped, just like empty rows are.
+      std::size_t y = firstY;
+      while (y < lastY && Internal::isEmpty(tileRowAt(y))) { ++y; }
+      if (y == lastY) {
+        if (statistics) { statistics->emptyRowCount += lastY - firstY; }
+        continue;
+      }
+      for (y = firstY; y < lastY; ++y) { tileEncoder.encode(tileRowAt(y)); }
+    }
+    rowProgress.step(lastY - firstY);
+  }
+  rowProgress.flush();
+  return tileEncoder.bitIndex();
+}
+
+namespace Internal {
+namespace {
+
+std::size_t resolveThreadCount(const std::size_t threadCount) {
+  if (threadCount) { return threadCount; }
+  const unsigned hardwareThreadCount = std::thread::hardware_concurrency();
+  return std::max(std::size_t{1}, std::size_t{hardwareThreadCount});
+}
+
+std::pmr::memory_resource *
+resolveMemoryResource(std::pmr::memory_resource *const resource) {
+  return resource ? resource : std::pmr::get_default_resource();
+}
+
+/// Returns how tall the bands of a bitmap should be. Every thread gets a few
+/// bands, so that the ones that end up with lots of empty rows can help out
+/// the others. The bands are a multiple of `alignment` rows tall.
+std::size_t bandHeightFor(const std::size_t height,
+                          const std::size_t threadCount,
+                          const std::size_t alignment) {
+  const std::size_t bandCount = threadCount * 4;
+  return align((height + bandCount - 1) / bandCount, alignment);
+}
+
+/// Calls `task` for every index in range [0, taskCount) on up to
+/// `threadCount` threads, including the calling one. If a task throws, the
+/// remaining tasks are abandoned and the exception is rethrown.
+void runInParallel(const std::size_t threadCount, const std::size_t taskCount,
+                   const std::function<void(std::size_t)> &task) {
+  std::atomic<std::size_t> nextTaskIndex{0};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  const auto runTasks = [&] {
+    try {
+      for (std::size_t taskIndex = nextTaskIndex++; taskIndex < taskCount;
+           taskIndex = nextTaskIndex++) {
+        task(taskIndex);
+      }
+    } catch (...) {
+      std::lock_guard lock{errorMutex};
+      if (!error) { error = std::current_exception(); }
+      // Make the other threads give up.
+      nextTaskIndex = taskCount;
+    }
+  };
+  {
+    std::vector<std::thread> threads;
+    threads.reserve(std::min(threadCount, taskCount));
+    for (std::size_t threadIndex = 1;
+         threadIndex < threadCount && threadIndex < taskCount; ++threadIndex) {
+      threads.emplace_back(runTasks);
+    }
+    runTasks();
+    for (std::thread &thread : threads) { thread.join(); }
+  }
+  if (error) { std::rethrow_exception(error); }
+}
+
+/// EncodedBand holds the encoded rows of a horizontal band of a bitmap.
+struct EncodedBand final {
+  std::size_t firstY = 0;
+  std::size_t lastY = 0;
+  BitSet pixelData;
+  std::size_t bitCount = 0;
+  CodecStatistics statistics;
+};
+
+/// Returns where the statistics are collected, that is, nowhere unless they
+/// are enabled.
+CodecStatistics *resolveStatistics(CodecStatistics *const statistics) {
+  return StatisticsAreEnabled ? statistics : nullptr;
+}
+
+/// PhaseTimer adds the time that passes until it's destroyed to a phase of the
+/// statistics, unless they are not collected.
+struct [[nodiscard]] PhaseTimer final {
+  using Clock = std::chrono::steady_clock;
+  using Phase = std::chrono::nanoseconds CodecStatistics::*;
+
+  PhaseTimer(CodecStatistics *const statistics, const Phase phase)
+      : m_statistics{statistics}, m_phase{phase},
+        m_start{statistics ? Clock::now() : Clock::time_point{}} {}
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  ~PhaseTimer() {
+    if (m_statistics) {
+      m_statistics->*m_phase +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               m_start);
+    }
+  }
+
+private:
+  CodecStatistics *m_statistics;
+  Phase m_phase;
+  Clock::time_point m_start;
+};
+
+} // namespace
+} // namespace Internal
+
+void CompressedBitmap::compressTiles(const BitmapView &sourceBitmap,
+                                     const std::size_t threadCount,
+                                     Internal::ProgressReporter &progress,
+                                     CodecStatistics *const statistics) {
+  using namespace Internal;
+  const TileGrid grid = tileGrid();
+  m_rowLookupTable = BitSet{grid.tileCount(), m_rowLookupTable.resource()};
+  m_tileIndex.resize(grid.tileCount());
+
+  // The bands are made of whole rows of tiles. Here `firstY` and `lastY` of a
+  // band are the rows of tiles.
+  const std::size_t bandHeight = bandHeightFor(grid.rowCount(), threadCount, 1);
+  const std::size_t bandCount = (grid.rowCount() + bandHeight - 1) / bandHeight;
+  std::vector<EncodedBand> bands(bandCount);
+  {
+    const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+    runInParallel(threadCount, bandCount, [&](const std::size_t bandIndex) {
+      EncodedBand &band = bands[bandIndex];
+      band.firstY = bandIndex * bandHeight;
+      band.lastY = std::min(grid.rowCount(), band.firstY + bandHeight);
+      band.bitCount =
+          encodeTiles(sourceBitmap, band.firstY, band.lastY, band.pixelData,
+                      progress, statistics ? &band.statistics : nullptr);
+    });
+  }
+
+  // Splice the bands together. The tile index entries of every band move by
+  // the number of bits that come before it.
+  const PhaseTimer timer{statistics, &CodecStatistics::splicingTime};
+  std::size_t totalBitCount = 0;
+  for (const EncodedBand &band : bands) { totalBitCount += band.bitCount; }
+  m_pixelData.reserve(totalBitCount);
+  BitWriter pixelWriter{m_pixelData};
+  for (const EncodedBand &band : bands) {
+    for (std::size_t tileIndex = band.firstY * grid.columnCount();
+         tileIndex < band.lastY * grid.columnCount(); ++tileIndex) {
+      m_tileIndex[tileIndex] += pixelWriter.bitCount();
+    }
+    pixelWriter.write(band.pixelData, band.bitCount);
+    if (statistics) { *statistics += band.statistics; }
+  }
+  pixelWriter.flush();
+
+  // Only the tiles that are not empty take some bits.
+  for (std::size_t tileIndex = 0; tileIndex < m_tileIndex.size();
+       ++tileIndex) {
+    const std::size_t endBitIndex = tileIndex + 1 < m_tileIndex.size()
+                                        ? m_tileIndex[tileIndex + 1]
+                                        : totalBitCount;
+    if (endBitIndex != m_tileIndex[tileIndex]) {
+      m_rowLookupTable.set(tileIndex);
+    }
+  }
 }
 
-CompressedBitmap compress(const Bitmap &sourceBitmap,
+CompressedBitmap compress(const BitmapView &sourceBitmap,
+                          const CompressionOptions &options,
                           const ProgressHandler progress) {
+  using namespace Internal;
   const std::size_t width = sourceBitmap.width();
   const std::size_t height = sourceBitmap.height();
-  CompressedBitmap result{width, height};
-  Internal::Encoder rowEncoder{result.m_pixelData};
-  for (std::size_t y = 0; y < height; ++y) {
-    progress(y, height);
-    const ImmutablePixels currentRow = sourceBitmap.rowAt(y);
+  CompressedBitmap result{width, height,
+                          resolveMemoryResource(options.memoryResource)};
+  const std::size_t threadCount = resolveThreadCount(options.threadCount);
+  CodecStatistics *const statistics = resolveStatistics(options.statistics);
+  ProgressReporter reporter{progress, height, options.progressInterval,
+                            options.cancellation};
+  result.m_codeFormat = resolveCodeFormat(sourceBitmap, options.blockWidth,
+                                          options.runLengthCodes);
+  if (options.tileSize) {
+    result.m_tileSize = options.tileSize;
+    result.compressTiles(sourceBitmap, threadCount, reporter, statistics);
+    reporter.finish();
+    return result;
+  }
+  result.m_rowGroupSize = std::min(options.rowGroupSize, height);
+  if (result.hasRowIndex()) {
+    result.m_rowIndex.resize(result.rowGroupCount());
+  }
+
+  // No two threads may touch the same word of the row lookup table.
+  const std::size_t bandHeight =
+      bandHeightFor(height, threadCount, bitsPer<Word>);
+  const std::size_t bandCount = (height + bandHeight - 1) / bandHeight;
+  if (threadCount == 1 || bandCount == 1) {
+    {
+      const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+      result.encodeRows(sourceBitmap, 0, height, result.m_pixelData, reporter,
+                        statistics);
+    }
+    reporter.finish();
+    return result;
+  }
+
+  std::vector<EncodedBand> bands(bandCount);
+  {
+    const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+    runInParallel(threadCount, bandCount, [&](const std::size_t bandIndex) {
+      EncodedBand &band = bands[bandIndex];
+      band.firstY = bandIndex * bandHeight;
+      band.lastY = std::min(height, band.firstY + bandHeight);
+      band.bitCount = result.encodeRows(
+          sourceBitmap, band.firstY, band.lastY, band.pixelData, reporter,
+          statistics ? &band.statistics : nullptr);
+    });
+  }
+
+  // Splice the bands together. The row index entries of every band move by the
+  // number of bits that come before it.
+  {
+    const PhaseTimer timer{statistics, &CodecStatistics::splicingTime};
+    std::size_t totalBitCount = 0;
+    for (const EncodedBand &band : bands) { totalBitCount += band.bitCount; }
+    result.m_pixelData.reserve(totalBitCount);
+    BitWriter pixelWriter{result.m_pixelData};
+    for (const EncodedBand &band : bands) {
+      if (result.hasRowIndex()) {
+        const std::size_t groupSize = result.m_rowGroupSize;
+        const std::size_t firstGroup =
+            (band.firstY + groupSize - 1) / groupSize;
+        const std::size_t lastGroup = (band.lastY + groupSize - 1) / groupSize;
+        for (std::size_t group = firstGroup; group < lastGroup; ++group) {
+          result.m_rowIndex[group] += pixelWriter.bitCount();
+        }
+      }
+      pixelWriter.write(band.pixelData, band.bitCount);
+      if (statistics) { *statistics += band.statistics; }
+    }
+    pixelWriter.flush();
+  }
+  reporter.finish();
+  return result;
+}
+
+StreamingEncoder::StreamingEncoder(const std::size_t width,
+                                   const std::size_t height,
+                                   const CompressionOptions &options)
+    : m_size{width, height}, m_rowLookupTable{height},
+      m_rowEncoder{m_pixelData, Internal::resolveStatistics(options.statistics),
+                   {options.blockWidth == BlockWidth::Auto
+                        ? Internal::DefaultBlockWidth
+                        : static_cast<std::size_t>(options.blockWidth),
+                    options.runLengthCodes}},
+      m_rowGroupSize{std::min(options.rowGroupSize, height)} {
+  if (m_rowGroupSize) {
+    m_rowIndex.reserve(height / m_rowGroupSize +
+                       (height % m_rowGroupSize != 0));
+  }
+}
+
+void StreamingEncoder::push(const ImmutablePixels rows) {
+  if (rows.size() % width()) {
+    throw InvalidSize{rows.size(), 1, InvalidSize::TooSmall};
+  }
+  const std::size_t rowCount = rows.size() / width();
+  if (rowCount > height() - m_rowCount) { Internal::throwInvalidY(height()); }
+  const Internal::PhaseTimer timer{m_rowEncoder.statistics(),
+                                   &CodecStatistics::codingTime};
+  for (std::size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex) {
+    const std::size_t y = m_rowCount++;
+    if (m_rowGroupSize && y % m_rowGroupSize == 0) {
+      m_rowIndex.push_back(m_rowEncoder.bitIndex());
+    }
+    const ImmutablePixels currentRow =
+        rows.subspan(rowIndex * width(), width());
     if (Internal::isEmpty(currentRow)) {
       // Empty rows are skipped. The corresponding entry in the lookup table is
       // set to 0 anyways.
+      if (CodecStatistics *const statistics = m_rowEncoder.statistics()) {
+        ++statistics->emptyRowCount;
+      }
       continue;
     }
-    result.m_rowLookupTable.set(y);
-    rowEncoder.encode(currentRow);
+    m_rowLookupTable.set(y);
+    m_rowEncoder.encode(currentRow);
   }
-  progress(height, height);
+}
+
+CompressedBitmap StreamingEncoder::finish() {
+  requireAllRows();
+  CompressedBitmap result{width(), height()};
+  result.m_rowLookupTable = std::move(m_rowLookupTable);
+  result.m_pixelData = std::move(m_pixelData);
+  result.m_rowGroupSize = m_rowGroupSize;
+  result.m_rowIndex = std::move(m_rowIndex);
+  result.m_codeFormat = m_rowEncoder.codeFormat();
   return result;
 }
 
-Bitmap uncompress(const CompressedBitmap &sourceBitmap,
+void StreamingEncoder::requireAllRows() const {
+  if (m_rowCount != height()) { Internal::throwInvalidY(m_rowCount); }
+}
+
+StreamingDecoder::StreamingDecoder(const CompressedBitmapView &sourceBitmap)
+    : m_size{sourceBitmap.m_size},
+      m_rowLookupTable{sourceBitmap.m_rowLookupTable},
+      m_pixelData{sourceBitmap.m_pixelData},
+      m_tileSize{sourceBitmap.m_tileSize},
+      m_tileIndex{sourceBitmap.m_tileIndex},
+      m_codeFormat{sourceBitmap.m_codeFormat} {}
+
+void StreamingDecoder::collectStatistics(
+    CodecStatistics *const statistics) noexcept {
+  m_statistics = Internal::resolveStatistics(statistics);
+  for (Internal::Decoder &tileDecoder : m_tileDecoders) {
+    tileDecoder.collectStatistics(m_statistics);
+  }
+}
+
+bool StreamingDecoder::pull(const MutablePixels pixels) {
+  if (pixels.size() != width()) {
+    throw InvalidSize{pixels.size(), 1,
+                      pixels.size() < width() ? InvalidSize::TooSmall
+                                              : InvalidSize::TooLarge};
+  }
+  if (m_rowCount == height()) { return false; }
+  const Internal::PhaseTimer timer{m_statistics,
+                                   &CodecStatistics::codingTime};
+  if (m_tileSize) {
+    decodeTiledRow(pixels);
+  } else if (!m_rowLookupTable.test(m_rowCount)) {
+    std::memset(pixels.data(), White, pixels.size());
+    if (m_statistics) { ++m_statistics->emptyRowCount; }
+  } else {
+    if (m_readWords) { readRow(); }
+    Internal::Decoder rowDecoder{m_pixelData, m_bitIndex, m_codeFormat};
+    rowDecoder.collectStatistics(m_statistics);
+    rowDecoder.decode(pixels);
+    m_bitIndex = rowDecoder.bitIndex();
+  }
+  if (++m_rowCount == height() && m_readWords) { readRest(); }
+  return true;
+}
+
+void StreamingDecoder::decodeTiledRow(const MutablePixels pixels) {
+  const Internal::TileGrid grid{m_size, m_tileSize};
+  const std::size_t row = m_rowCount / m_tileSize;
+  if (m_rowCount % m_tileSize == 0) {
+    m_tileDecoders.clear();
+    for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+      m_tileDecoders.emplace_back(
+          m_pixelData, m_tileIndex[row * grid.columnCount() + column],
+          m_codeFormat);
+      m_tileDecoders.back().collectStatistics(m_statistics);
+    }
+  }
+  for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+    const MutablePixels tilePixels =
+        pixels.subspan(column * m_tileSize, grid.tileWidth(column));
+    if (m_rowLookupTable.test(row * grid.columnCount() + column)) {
+      m_tileDecoders[column].decode(tilePixels);
+    } else {
+      std::memset(tilePixels.data(), White, tilePixels.size());
+      if (m_statistics) { ++m_statistics->emptyRowCount; }
+    }
+  }
+}
+
+void StreamingDecoder::readRow() {
+  using namespace Internal;
+  // Forget the words that were decoded already. The decoder may have gone past
+  // the words that were read only if there are no more of them.
+  const std::size_t decodedWordCount = m_bitIndex / bitsPer<Word>;
+  m_buffer.erase(m_buffer.begin(),
+                 m_buffer.begin() + static_cast<std::ptrdiff_t>(std::min(
+                                        decodedWordCount, m_buffer.size())));
+  m_bitIndex %= bitsPer<Word>;
+  // A row takes the most bits when all of its blocks are literals.
+  const std::size_t blockWidth = m_codeFormat.blockWidth;
+  const std::size_t blockCount =
+      (width() + blockWidth - std::size_t{1}) / blockWidth;
+  const std::size_t maxBitCount =
+      m_bitIndex + blockCount * m_codeFormat.literalBitCount();
+  const std::size_t wordCount =
+      std::min(align(maxBitCount, bitsPer<Word>) / bitsPer<Word>,
+               m_buffer.size() + m_unreadWordCount);
+  if (const std::size_t bufferedWordCount = m_buffer.size();
+      wordCount > bufferedWordCount) {
+    m_buffer.resize(wordCount);
+    m_readWords(std::span<Word>{m_buffer}.subspan(bufferedWordCount));
+    m_unreadWordCount -= wordCount - bufferedWordCount;
+  }
+  m_pixelData = m_buffer;
+}
+
+void StreamingDecoder::readRest() {
+  using namespace Internal;
+  // Whatever is left is read in chunks of the size of the buffer.
+  m_buffer.resize(std::max(m_buffer.size(), std::size_t{1}));
+  const auto skipWords = [this](std::size_t wordCount) {
+    while (wordCount) {
+      const std::size_t chunkSize = std::min(wordCount, m_buffer.size());
+      m_readWords(std::span<Word>{m_buffer}.first(chunkSize));
+      wordCount -= chunkSize;
+    }
+  };
+  skipWords(m_unreadWordCount);
+  m_unreadWordCount = 0;
+  if (m_features & RowIndexFeature) {
+    Word rowGroupSize = 0;
+    m_readWords(std::span<Word>{&rowGroupSize, 1});
+    if (!rowGroupSize || rowGroupSize > height()) {
+      throw InvalidFormat{InvalidFormat::CorruptData};
+    }
+    skipWords(height() / rowGroupSize + (height() % rowGroupSize != 0));
+  }
+  m_readWords = nullptr;
+  m_pixelData = {};
+  m_buffer = {};
+}
+
+Bitmap uncompress(const CompressedBitmapView &sourceBitmap,
                   const ProgressHandler progress) {
+  return uncompress(sourceBitmap, DecompressionOptions{}, progress);
+}
+
+void CompressedBitmapView::decodeRows(
+    Internal::Decoder &rowDecoder, const std::size_t firstY,
+    const std::size_t lastY, const Internal::RowSink &sink,
+    Internal::ProgressReporter &progress) const {
+  Internal::ProgressCounter rowProgress{progress};
+  for (std::size_t y = firstY; y < lastY; ++y) {
+    if (m_rowLookupTable.test(y)) {
+      rowDecoder.decode(rowAt(sink, y));
+    } else {
+      if (CodecStatistics *const statistics = rowDecoder.statistics()) {
+        ++statistics->emptyRowCount;
+      }
+      if (!sink.isWhite) {
+        const MutablePixels pixels = rowAt(sink, y);
+        std::memset(pixels.data(), White, pixels.size());
+      }
+    }
+    rowProgress.step();
+  }
+  rowProgress.flush();
+}
+
+Bitmap uncompress(const CompressedBitmapView &sourceBitmap,
+                  const DecompressionOptions &options,
+                  const ProgressHandler progress) {
+  // Every pixel gets written, the white ones included, so there's no point in
+  // initializing them first.
+  Bitmap result{sourceBitmap.width(), sourceBitmap.height(), uninitialized,
+                Internal::resolveMemoryResource(options.memoryResource)};
+  Internal::uncompressInto(
+      sourceBitmap,
+      Internal::RowSink{[&result](const std::size_t y) {
+                          return result.rowAt(y);
+                        },
+                        false},
+      options, progress);
+  return result;
+}
+
+void Internal::uncompressInto(const CompressedBitmapView &sourceBitmap,
+                              const RowSink &sink,
+                              const DecompressionOptions &options,
+                              const ProgressHandler &progress) {
   const std::size_t width = sourceBitmap.width();
   const std::size_t height = sourceBitmap.height();
-  Bitmap result{width, height};
-  Internal::Decoder rowDecoder{sourceBitmap.m_pixelData};
-  for (std::size_t y = 0; y < height; ++y) {
-    progress(y, height);
-    if (sourceBitmap.m_rowLookupTable.test(y)) {
+  const std::size_t threadCount = resolveThreadCount(options.threadCount);
+  CodecStatistics *const statistics = resolveStatistics(options.statistics);
+  ProgressReporter reporter{progress, height, options.progressInterval,
+                            options.cancellation};
+  // Every band counts on its own, so that the threads don't share the counts.
+  std::vector<CodecStatistics> bandStatistics;
+  const auto statisticsOf = [&](const std::size_t bandIndex) {
+    return statistics ? &bandStatistics[bandIndex] : nullptr;
+  };
+  const auto addBandStatistics = [&] {
+    if (!statistics) { return; }
+    for (const CodecStatistics &band : bandStatistics) { *statistics += band; }
+  };
+  if (sourceBitmap.isTiled()) {
+    // Every tile can be decoded on its own. The bands are made of whole rows
+    // of tiles.
+    const std::size_t rowCount = sourceBitmap.tileGrid().rowCount();
+    const std::size_t bandHeight = bandHeightFor(rowCount, threadCount, 1);
+    const std::size_t bandCount = (rowCount + bandHeight - 1) / bandHeight;
+    bandStatistics.resize(statistics ? bandCount : 0);
+    {
+      const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+      runInParallel(threadCount, bandCount, [&](const std::size_t bandIndex) {
+        const std::size_t firstRow = bandIndex * bandHeight;
+        sourceBitmap.decodeTiles(firstRow,
+                                 std::min(rowCount, firstRow + bandHeight),
+                                 sink, reporter, statisticsOf(bandIndex));
+      });
+    }
+    addBandStatistics();
+    reporter.finish();
+    return;
+  }
+  const std::size_t bandHeight = bandHeightFor(height, threadCount, 1);
+  const std::size_t bandCount = (height + bandHeight - 1) / bandHeight;
+  if (threadCount == 1 || bandCount == 1) {
+    {
+      const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+      Decoder rowDecoder{sourceBitmap.m_pixelData, 0,
+                         sourceBitmap.m_codeFormat};
+      rowDecoder.collectStatistics(statistics);
+      sourceBitmap.decodeRows(rowDecoder, 0, height, sink, reporter);
+    }
+    reporter.finish();
+    return;
+  }
+
+  // Every band needs to know where its first row starts. The row index tells
+  // that right away. Otherwise, the codes of the rows above have to be
+  // skipped, which is still much cheaper than decoding them.
+  std::vector<std::size_t> bandBitIndices;
+  if (!sourceBitmap.hasRowIndex()) {
+    const PhaseTimer timer{statistics, &CodecStatistics::scanningTime};
+    bandBitIndices.reserve(bandCount);
+    Decoder scanner{sourceBitmap.m_pixelData, 0, sourceBitmap.m_codeFormat};
+    for (std::size_t firstY = 0; firstY < height; firstY += bandHeight) {
+      bandBitIndices.push_back(scanner.bitIndex());
+      const std::size_t lastY = std::min(height, firstY + bandHeight);
+      scanner.skipRows(sourceBitmap.m_rowLookupTable.count(firstY, lastY),
+                       width);
+    }
+  }
+  bandStatistics.resize(statistics ? bandCount : 0);
+  {
+    const PhaseTimer timer{statistics, &CodecStatistics::codingTime};
+    runInParallel(threadCount, bandCount, [&](const std::size_t bandIndex) {
+      const std::size_t firstY = bandIndex * bandHeight;
+      const std::size_t lastY = std::min(height, firstY + bandHeight);
+      Decoder rowDecoder =
+          bandBitIndices.empty()
+              ? sourceBitmap.decoderAt(firstY)
+              : Decoder{sourceBitmap.m_pixelData, bandBitIndices[bandIndex],
+                        sourceBitmap.m_codeFormat};
+      rowDecoder.collectStatistics(statisticsOf(bandIndex));
+      sourceBitmap.decodeRows(rowDecoder, firstY, lastY, sink, reporter);
+    });
+  }
+  addBandStatistics();
+  reporter.finish();
+}
+
+void uncompressRow(const CompressedBitmapView &sourceBitmap,
+                   const std::size_t y, const MutablePixels pixels) {
+  if (y >= sourceBitmap.height()) { Internal::throwInvalidY(y); }
+  if (pixels.size() != sourceBitmap.width()) {
+    throw InvalidSize{pixels.size(), 1,
+                      pixels.size() < sourceBitmap.width()
+                          ? InvalidSize::TooSmall
+                          : InvalidSize::TooLarge};
+  }
+  if (sourceBitmap.isTiled()) {
+    sourceBitmap.decodeTiledRow(y, pixels);
+    return;
+  }
+  if (!sourceBitmap.m_rowLookupTable.test(y)) {
+    std::memset(pixels.data(), White, pixels.size());
+    return;
+  }
+  sourceBitmap.decoderAt(y).decode(pixels);
+}
+
+Bitmap uncompressRows(const CompressedBitmapView &sourceBitmap,
+                      const std::size_t firstY, const std::size_t rowCount) {
+  if (firstY >= sourceBitmap.height()) { Internal::throwInvalidY(firstY); }
+  if (rowCount > sourceBitmap.height() - firstY) {
+    Internal::throwInvalidY(firstY + rowCount - std::size_t{1});
+  }
+  if (sourceBitmap.isTiled()) {
+    return uncompressRegion(sourceBitmap, 0, firstY, sourceBitmap.width(),
+                            rowCount);
+  }
+  Bitmap result{sourceBitmap.width(), rowCount};
+  Internal::Decoder rowDecoder = sourceBitmap.decoderAt(firstY);
+  for (std::size_t y = 0; y < rowCount; ++y) {
+    if (sourceBitmap.m_rowLookupTable.test(firstY + y)) {
       rowDecoder.decode(result.rowAt(y));
     }
   }
-  progress(height, height);
+  return result;
+}
+
+Bitmap uncompressRegion(const CompressedBitmapView &sourceBitmap,
+                        const std::size_t x, const std::size_t y,
+                        const std::size_t width, const std::size_t height) {
+  if (x >= sourceBitmap.width()) { Internal::throwInvalidX(x); }
+  if (y >= sourceBitmap.height()) { Internal::throwInvalidY(y); }
+  if (width > sourceBitmap.width() - x) {
+    Internal::throwInvalidX(x + width - std::size_t{1});
+  }
+  if (height > sourceBitmap.height() - y) {
+    Internal::throwInvalidY(y + height - std::size_t{1});
+  }
+  Bitmap result{width, height};
+  if (!sourceBitmap.isTiled()) {
+    // The rows have to be decoded whole.
+    std::vector<Pixel> rowPixels(sourceBitmap.width());
+    Internal::Decoder rowDecoder = sourceBitmap.decoderAt(y);
+    for (std::size_t resultY = 0; resultY < height; ++resultY) {
+      if (sourceBitmap.m_rowLookupTable.test(y + resultY)) {
+        rowDecoder.decode(rowPixels);
+        std::memcpy(result.rowAt(resultY).data(), rowPixels.data() + x, width);
+      }
+    }
+    return result;
+  }
+  // Only the tiles that overlap the region are decoded. The rows of a tile
+  // still have to be decoded whole.
+  const Internal::TileGrid grid = sourceBitmap.tileGrid();
+  const std::size_t tileSize = grid.tileSize();
+  std::vector<Pixel> tilePixels(std::min(tileSize, sourceBitmap.width()));
+  for (std::size_t row = y / tileSize; row <= (y + height - 1) / tileSize;
+       ++row) {
+    const std::size_t tileY = row * tileSize;
+    const std::size_t firstY = std::max(y, tileY);
+    const std::size_t lastY =
+        std::min(y + height, tileY + grid.tileHeight(row));
+    for (std::size_t column = x / tileSize;
+         column <= (x + width - 1) / tileSize; ++column) {
+      const std::size_t tileIndex = row * grid.columnCount() + column;
+      // Empty tiles are white already.
+      if (!sourceBitmap.m_rowLookupTable.test(tileIndex)) { continue; }
+      const std::size_t tileX = column * tileSize;
+      const std::size_t tileWidth = grid.tileWidth(column);
+      const std::size_t firstX = std::max(x, tileX);
+      const std::size_t lastX = std::min(x + width, tileX + tileWidth);
+      Internal::Decoder tileDecoder{sourceBitmap.m_pixelData,
+                                    sourceBitmap.m_tileIndex[tileIndex],
+                                    sourceBitmap.m_codeFormat};
+      tileDecoder.skipRows(firstY - tileY, tileWidth);
+      for (std::size_t tileRowY = firstY; tileRowY < lastY; ++tileRowY) {
+        tileDecoder.decode(MutablePixels{tilePixels}.first(tileWidth));
+        std::memcpy(result.rowAt(tileRowY - y).data() + (firstX - x),
+                    tilePixels.data() + (firstX - tileX), lastX - firstX);
+      }
+    }
+  }
+  return result;
+}
+
+Bitmap uncompressPreview(const CompressedBitmapView &sourceBitmap,
+                         const std::size_t scale) {
+  if (!scale) { throw InvalidSize{0, 0, InvalidSize::TooSmall}; }
+  const std::size_t sourceWidth = sourceBitmap.width();
+  const std::size_t sourceHeight = sourceBitmap.height();
+  Bitmap result{sourceWidth / scale + (sourceWidth % scale != 0),
+                sourceHeight / scale + (sourceHeight % scale != 0)};
+  std::vector<Pixel> rowPixels(sourceWidth);
+  // Specifies the row the decoders are positioned at.
+  std::size_t decoderY = 0;
+  Internal::Decoder rowDecoder{sourceBitmap.m_pixelData, 0,
+                               sourceBitmap.m_codeFormat};
+  // Holds one decoder per tile of the current row of tiles of a tiled bitmap,
+  // so that every tile is scanned once, from top to bottom.
+  std::vector<Internal::Decoder> tileDecoders;
+  for (std::size_t resultY = 0; resultY < result.height(); ++resultY) {
+    const std::size_t y = resultY * scale;
+    if (sourceBitmap.isTiled()) {
+      const Internal::TileGrid grid = sourceBitmap.tileGrid();
+      const std::size_t tileY = y - y % grid.tileSize();
+      const std::size_t firstTile =
+          tileY / grid.tileSize() * grid.columnCount();
+      if (decoderY <= tileY) {
+        tileDecoders.clear();
+        for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+          tileDecoders.emplace_back(
+              sourceBitmap.m_pixelData,
+              sourceBitmap.m_tileIndex[firstTile + column],
+              sourceBitmap.m_codeFormat);
+        }
+        decoderY = tileY;
+      }
+      for (std::size_t column = 0; column < grid.columnCount(); ++column) {
+        const MutablePixels tilePixels = MutablePixels{rowPixels}.subspan(
+            column * grid.tileSize(), grid.tileWidth(column));
+        if (!sourceBitmap.m_rowLookupTable.test(firstTile + column)) {
+          std::memset(tilePixels.data(), White, tilePixels.size());
+          continue;
+        }
+        tileDecoders[column].skipRows(y - decoderY, tilePixels.size());
+        tileDecoders[column].decode(tilePixels);
+      }
+      decoderY = y + std::size_t{1};
+    } else {
+      // Empty rows are white already.
+      if (!sourceBitmap.m_rowLookupTable.test(y)) { continue; }
+      if (sourceBitmap.hasRowIndex() &&
+          y - decoderY >= sourceBitmap.rowGroupSize()) {
+        rowDecoder = sourceBitmap.decoderAt(y);
+      } else {
+        rowDecoder.skipRows(sourceBitmap.m_rowLookupTable.count(decoderY, y),
+                            sourceWidth);
+      }
+      rowDecoder.decode(rowPixels);
+      decoderY = y + std::size_t{1};
+    }
+    const MutablePixels resultRow = result.rowAt(resultY);
+    for (std::size_t x = 0; x < resultRow.size(); ++x) {
+      const std::size_t firstX = x * scale;
+      const std::size_t lastX = std::min(sourceWidth, firstX + scale);
+      resultRow[x] = *std::min_element(rowPixels.data() + firstX,
+                                       rowPixels.data() + lastX);
+    }
+  }
   return result;
 }
 
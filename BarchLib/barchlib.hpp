@@ -1,18 +1,27 @@
 #ifndef BARCHLIB_HPP
 #define BARCHLIB_HPP
 
-#include <array>      // for std::array
-#include <concepts>   // for std::same_as
-#include <cstddef>    // for std::size_t
-#include <cstdint>    // for std::uint8_t
-#include <cstring>    // for std::memcmp
-#include <exception>  // for std::exception
-#include <functional> // for std::function
-#include <memory>     // for std::unique_ptr
-#include <new>        // for placement new
-#include <span>       // for std::span
-#include <utility>    // for std::pair
-#include <vector>     // for std::vector
+#include <algorithm>       // for std::min
+#include <array>           // for std::array
+#include <atomic>          // for std::atomic
+#include <chrono>          // for std::chrono::nanoseconds
+#include <concepts>        // for std::same_as
+#include <cstddef>         // for std::size_t
+#include <cstdint>         // for std::uint8_t
+#include <cstring>         // for std::memcmp
+#include <exception>       // for std::exception
+#include <functional>      // for std::function
+#include <memory>          // for std::unique_ptr
+#include <memory_resource> // for std::pmr::memory_resource
+#include <span>            // for std::span
+#include <utility>         // for std::pair
+#include <vector>          // for std::vector
+
+/// BARCHLIB_STATISTICS turns the collection of CodecStatistics on. It's off by
+/// default, and then the collection is compiled out entirely.
+#ifndef BARCHLIB_STATISTICS
+#define BARCHLIB_STATISTICS 0
+#endif
 
 namespace BarchLib::inline v1 {
 
@@ -22,6 +31,19 @@ using Pixel = std::uint8_t;
 constexpr inline Pixel White = 0xFFU;
 constexpr inline Pixel Black = 0x00U;
 
+/// PixelAlignment is the alignment of the pixels of every Bitmap in bytes. It's
+/// the size of a cache line on the CPUs we care about, so that rows handed to
+/// different threads don't share one at the start of the bitmap.
+constexpr inline std::size_t PixelAlignment = 64;
+
+/// Uninitialized tells a constructor to leave the memory it allocates as it is.
+/// That saves a pass over the memory when every byte gets overwritten anyway.
+struct Uninitialized final {
+  explicit Uninitialized() = default;
+};
+
+constexpr inline Uninitialized uninitialized{};
+
 /// InvalidSize will be thrown during Bitmap and CompressedBitmap construction
 /// when the requested size cannot be handled.
 struct InvalidSize final : std::exception {
@@ -75,6 +97,37 @@ private:
   std::size_t m_value;
 };
 
+/// InvalidFormat will be thrown while loading a CompressedBitmap that was saved
+/// in a format this version of BarchLib doesn't understand.
+struct InvalidFormat final : std::exception {
+
+  /// Reason tells us why this exception was thrown.
+  enum Reason {
+    /// Specifies that the data was saved by a newer version of BarchLib.
+    UnsupportedVersion = 0,
+    /// Specifies that the data relies on features that are unknown to this
+    /// version of BarchLib.
+    UnsupportedFeatures = 1,
+    /// Specifies that the data contradicts itself.
+    CorruptData = 2,
+  };
+
+  InvalidFormat(const Reason reason) : m_reason{reason} {}
+
+  const char *what() const noexcept override;
+
+  Reason reason() const noexcept { return m_reason; }
+
+private:
+  Reason m_reason;
+};
+
+/// Cancelled will be thrown by compress() and uncompress() once the
+/// CancellationToken they were given is cancelled.
+struct Cancelled final : std::exception {
+  const char *what() const noexcept override;
+};
+
 /// MutablePixels represent a reqnge of pixels. The pixels in the range can be
 /// modified.
 using MutablePixels = std::span<Pixel>;
@@ -84,6 +137,14 @@ using MutablePixels = std::span<Pixel>;
 using ImmutablePixels = std::span<Pixel const>;
 
 // clang-format off
+/// PixelSink receives decoded pixels. `rowAt(sink, y)` returns where the row at
+/// Y goes. The rows are `width` pixels long, where `width` is the width of the
+/// decoded bitmap. Several threads may ask for different rows at the same time.
+template <typename T>
+concept PixelSink = requires(T& sink, std::size_t y) {
+  { rowAt(sink, y) } -> std::same_as<MutablePixels>;
+};
+
 template <typename T, typename U>
 concept Writer = requires(T& writer, const U& value) {
   { write(writer, value) } -> std::same_as<void>;
@@ -94,15 +155,29 @@ concept Reader = requires(T& reader, U& value) {
   { read(reader, value) } -> std::same_as<void>;
 };
 
+/// SpanWriter writes contiguous values at once. BarchLib writes the bulk of a
+/// compressed bitmap (the row lookup table, the pixel data and the row index)
+/// as a few large spans of words, and only the header one value at a time. An
+/// implementation should therefore transfer a span with as few calls to the
+/// underlying storage as possible instead of writing its values one by one.
 template<typename T, typename U>
 concept SpanWriter = requires(T& writer, std::span<U const> values) {
   { write(writer, values) } -> std::same_as<void>;
 };
 
+/// SpanReader reads contiguous values at once. See SpanWriter.
 template <typename T, typename U>
 concept SpanReader = requires(T& reader, std::span<U> values) {
   { read(reader, values) } -> std::same_as<void>;
 };
+
+/// SeekableWriter can go back and overwrite what was written earlier. The
+/// positions are opaque: they only need to be understood by the writer.
+template <typename T>
+concept SeekableWriter = requires(T& writer, std::size_t position) {
+  { tell(writer) } -> std::same_as<std::size_t>;
+  { seek(writer, position) } -> std::same_as<void>;
+};
 // clang-format on
 
 /// The types and functions in this namespace are internal to BarchLib.
@@ -155,7 +230,43 @@ void save(BitmapSizeWriter auto &writer, const BitmapSize &size) {
 
 } // namespace Internal
 
-/// Bitmap represents an uncompressed grayscale bitmap.
+/// BitmapView refers to the pixels of an uncompressed grayscale bitmap without
+/// owning them. The rows don't need to be contiguous: they are `stride` bytes
+/// apart, like the scan lines of most images.
+struct [[nodiscard]] BitmapView final {
+
+  /// Preconditions:
+  /// 	- width and height are not 0;
+  /// 	- stride is not less than width;
+  /// 	- data points to `height` rows of `width` pixels, `stride` bytes apart.
+  BitmapView(const Pixel *data, std::size_t width, std::size_t height,
+             std::size_t stride);
+
+  std::size_t width() const noexcept { return m_size.width(); }
+  std::size_t height() const noexcept { return m_size.height(); }
+
+  /// Returns the distance between the starts of two consecutive rows in bytes.
+  std::size_t stride() const noexcept { return m_stride; }
+
+  const Pixel *data() const noexcept { return m_data; }
+
+  /// Precondition: y is in range [0, height()).
+  [[nodiscard]] ImmutablePixels rowAt(std::size_t y) const;
+
+private:
+  const Pixel *m_data;
+
+  Internal::BitmapSize m_size;
+
+  std::size_t m_stride;
+};
+
+/// Returns `true` if all the pixels of `bitmap` are white.
+[[nodiscard]] bool isEmpty(const BitmapView &bitmap);
+
+/// Bitmap represents an uncompressed grayscale bitmap. Its pixels come from a
+/// polymorphic memory resource, so that they can be recycled, say, from an
+/// arena of a worker thread. They are aligned to PixelAlignment.
 struct [[nodiscard]] Bitmap final {
 
   /// Construct an empty bitmap. That is, all the pixels in the image have the
@@ -163,23 +274,35 @@ struct [[nodiscard]] Bitmap final {
   /// Preconditions:
   /// 	- width and height are not 0;
   /// 	- width and height represent an image that can be stored in memory.
-  Bitmap(std::size_t width, std::size_t height, Pixel background = White);
-
-  Bitmap(const Bitmap &other);
-
-  Bitmap(Bitmap &&other) noexcept;
+  Bitmap(std::size_t width, std::size_t height, Pixel background = White,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource());
+
+  /// Construct a bitmap whose pixels are left uninitialized. The caller is
+  /// expected to overwrite all of them before they are read.
+  /// Preconditions: the same as above.
+  Bitmap(std::size_t width, std::size_t height, Uninitialized,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource());
+
+  /// Like the copies of std::pmr containers, the copy doesn't inherit the
+  /// memory resource of `other`.
+  Bitmap(const Bitmap &other,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource());
+
+  /// The pixels are moved along with the memory resource they came from.
+  Bitmap(Bitmap &&other) noexcept = default;
 
   ~Bitmap() noexcept = default;
 
+  /// The pixels are copied into a new allocation from the memory resource of
+  /// this bitmap.
   Bitmap &operator=(const Bitmap &other) {
-    this->~Bitmap();
-    return *::new (this) Bitmap{other};
+    return *this = Bitmap{other, resource()};
   }
 
-  Bitmap &operator=(Bitmap &&other) noexcept {
-    this->~Bitmap();
-    return *::new (this) Bitmap{other};
-  }
+  Bitmap &operator=(Bitmap &&other) noexcept = default;
 
   friend bool operator==(const Bitmap &lhs, const Bitmap &rhs) noexcept {
     if (&lhs == &rhs) { return true; }
@@ -195,12 +318,27 @@ struct [[nodiscard]] Bitmap final {
   Pixel *data() noexcept { return m_data.get(); }
   const Pixel *data() const noexcept { return m_data.get(); }
 
+  /// Returns the memory resource the pixels come from.
+  std::pmr::memory_resource *resource() const noexcept {
+    return m_data.get_deleter().resource;
+  }
+
   /// Precondition: y is in range [0, height()).
   [[nodiscard]] MutablePixels rowAt(std::size_t y);
 
   /// Precondition: y is in range [0, height()).
   [[nodiscard]] ImmutablePixels rowAt(std::size_t y) const;
 
+  /// Returns a view that refers to the pixels of this bitmap.
+  operator BitmapView() const {
+    return BitmapView{data(), width(), height(), width()};
+  }
+
+  /// Makes Bitmap a PixelSink.
+  friend MutablePixels rowAt(Bitmap &bitmap, const std::size_t y) {
+    return bitmap.rowAt(y);
+  }
+
   /// Preconditions:
   /// - x is in range [0, width());
   /// - y is in range [0, height()).
@@ -212,12 +350,22 @@ struct [[nodiscard]] Bitmap final {
   [[nodiscard]] Pixel const &pixelAt(std::size_t x, std::size_t y) const;
 
 private:
+  /// PixelDeleter gives the pixels back to the memory resource they came from.
+  struct PixelDeleter final {
+    std::pmr::memory_resource *resource;
+    std::size_t size;
+
+    void operator()(Pixel *pixels) const noexcept {
+      resource->deallocate(pixels, size, PixelAlignment);
+    }
+  };
+
   /// Holds the size of this Bitmap in pixels.
   Internal::BitmapSize m_size;
 
   /// Holds the 2D array of pixels that make up the image. There are `m_width *
   /// m_height` pixels in this array.
-  std::unique_ptr<Pixel[]> m_data;
+  std::unique_ptr<Pixel[], PixelDeleter> m_data;
 };
 
 namespace Internal {
@@ -245,7 +393,14 @@ struct [[nodiscard]] BitSet final {
   // If you're wondering why we don't use std::vector<bool> instead, reevaluate
   // your life choices.
 
-  BitSet(std::size_t bitCount = 0);
+  BitSet(std::size_t bitCount = 0,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource());
+
+  /// Returns the memory resource the words come from.
+  std::pmr::memory_resource *resource() const noexcept {
+    return m_words.get_allocator().resource();
+  }
 
   [[nodiscard]] bool test(std::size_t bitIndex) const;
 
@@ -257,6 +412,14 @@ struct [[nodiscard]] BitSet final {
 
   std::size_t wordCount() const noexcept { return m_words.size(); }
 
+  /// Reserves the storage for `bitCount` bits, so that setting them doesn't
+  /// reallocate.
+  void reserve(std::size_t bitCount);
+
+  /// Returns the number of bits that are set in range [firstBit, lastBit).
+  [[nodiscard]] std::size_t count(std::size_t firstBit,
+                                  std::size_t lastBit) const noexcept;
+
   /// unsafeResize resizes the underlying vector of words. This is required for
   /// proper BitSet loading. The use of this method elsewhere is discouraged.
   void unsafeResize(const std::size_t wordCount) { m_words.resize(wordCount); }
@@ -266,7 +429,10 @@ struct [[nodiscard]] BitSet final {
   }
 
 private:
-  std::vector<Word> m_words;
+  friend struct BitWriter;
+  friend struct BitSpan;
+
+  std::pmr::vector<Word> m_words;
 
   static std::pair<std::size_t /* wordIndex */, Word /* bitMask */>
   toWord(std::size_t bitIndex);
@@ -278,6 +444,312 @@ void save(BitSetWriter auto &writer, const BitSet &bitSet) {
   write(writer, bitSet.words());
 }
 
+/// BitSpan refers to bits that are laid out the same way as the bits of a
+/// BitSet, without owning them.
+struct [[nodiscard]] BitSpan final {
+
+  BitSpan(const std::span<Word const> words = {}) noexcept : m_words{words} {}
+
+  [[nodiscard]] bool test(std::size_t bitIndex) const noexcept;
+
+  /// Returns the number of bits that are set in range [firstBit, lastBit).
+  [[nodiscard]] std::size_t count(std::size_t firstBit,
+                                  std::size_t lastBit) const noexcept;
+
+  std::span<Word const> words() const noexcept { return m_words; }
+
+  std::size_t wordCount() const noexcept { return m_words.size(); }
+
+private:
+  std::span<Word const> m_words;
+};
+
+/// BitWriter appends bits to a BitSet. The bits are gathered in a register and
+/// stored into the BitSet a whole Word at a time.
+///
+/// Just like BitSet::set and BitSet::clear, it never stores trailing words
+/// that have no bits set. Therefore, the output is the same as if every bit was
+/// written one by one.
+struct [[nodiscard]] BitWriter final {
+
+  BitWriter(BitSet &output) noexcept : m_output{&output} {}
+
+  /// Appends the `bitCount` least significant bits of `bits`. The most
+  /// significant of them goes first.
+  /// Preconditions:
+  /// 	- bitCount is in range [1, bitsPer<Word>];
+  /// 	- the bits above `bitCount` are clear.
+  void write(const Word bits, const std::size_t bitCount) {
+    if (bitCount < m_freeBitCount) {
+      m_freeBitCount -= bitCount;
+      m_buffer |= bits << m_freeBitCount;
+      return;
+    }
+    // The current word is full. Store it and start a new one with the bits
+    // that did not fit.
+    const std::size_t spillBitCount = bitCount - m_freeBitCount;
+    m_buffer |= bits >> spillBitCount;
+    store(m_wordIndex++, m_buffer);
+    m_freeBitCount = bitsPer<Word> - spillBitCount;
+    m_buffer = spillBitCount ? bits << m_freeBitCount : Word{0};
+  }
+
+  /// Appends the first `bitCount` bits of `bits`. They may start at any
+  /// position within a word. They are shifted into place a word at a time.
+  void write(const BitSet &bits, std::size_t bitCount);
+
+  /// Stores the partially filled word, so that all the bits written so far
+  /// can be seen in the output. Writing may continue afterwards.
+  void flush();
+
+  /// Returns the number of complete words that are held by the output. Some
+  /// of them may be missing from the output, if there are no bits set in them
+  /// and in the words that follow them.
+  std::size_t completeWordCount() const noexcept {
+    return m_wordIndex - m_firstWordIndex;
+  }
+
+  /// Removes the complete words from the output. The bits that follow them
+  /// move to the start of the output. The bit count is not affected.
+  void discardCompleteWords();
+
+  /// Returns the number of bits written so far.
+  std::size_t bitCount() const noexcept {
+    return m_wordIndex * bitsPer<Word> + (bitsPer<Word> - m_freeBitCount);
+  }
+
+private:
+  BitSet *m_output;
+
+  /// Specifies the index of the word that is being filled.
+  std::size_t m_wordIndex{0};
+
+  /// Specifies the index of the word that is stored first in the output. It
+  /// is not 0 once some words were discarded.
+  std::size_t m_firstWordIndex{0};
+
+  /// Holds the bits of the word that is being filled.
+  Word m_buffer{0};
+
+  /// Specifies how many bits are still free in `m_buffer`.
+  std::size_t m_freeBitCount{bitsPer<Word>};
+
+  void store(std::size_t wordIndex, Word word);
+};
+
+/// BitReader reads bits from a sequence of words. It keeps a window of the
+/// upcoming bits in a register, so that a code can be peeked at and consumed
+/// with a couple of shifts instead of testing its bits one by one.
+struct [[nodiscard]] BitReader final {
+
+  BitReader(const std::span<Word const> words,
+            const std::size_t bitIndex = 0) noexcept
+      : m_words{words}, m_wordIndex{bitIndex / bitsPer<Word>},
+        m_offset{bitIndex % bitsPer<Word>}, m_current{wordAt(m_wordIndex)},
+        m_next{wordAt(m_wordIndex + std::size_t{1})} {}
+
+  /// Returns the upcoming `bitsPer<Word>` bits. The bit that comes next is the
+  /// most significant one. Bits past the end of the input are clear.
+  Word peek() const noexcept {
+    if (!m_offset) { return m_current; }
+    return (m_current << m_offset) | (m_next >> (bitsPer<Word> - m_offset));
+  }
+
+  /// Advances the position by `bitCount` bits.
+  /// Precondition: bitCount is in range [0, bitsPer<Word>].
+  void consume(const std::size_t bitCount) noexcept {
+    m_offset += bitCount;
+    if (m_offset >= bitsPer<Word>) {
+      m_offset -= bitsPer<Word>;
+      m_current = m_next;
+      m_next = wordAt(++m_wordIndex + std::size_t{1});
+    }
+  }
+
+  /// Returns the position in the stream of bits.
+  std::size_t bitIndex() const noexcept {
+    return m_wordIndex * bitsPer<Word> + m_offset;
+  }
+
+private:
+  std::span<Word const> m_words;
+
+  /// Specifies the index of the word that holds the next bit.
+  std::size_t m_wordIndex;
+
+  /// Specifies the position of the next bit within `m_current`.
+  std::size_t m_offset;
+
+  Word m_current;
+  Word m_next;
+
+  Word wordAt(const std::size_t wordIndex) const noexcept {
+    // Out of range bits are considered to be off.
+    return wordIndex < m_words.size() ? m_words[wordIndex] : Word{0};
+  }
+};
+
+/// FormatMagic is the first word of the files that start with a format
+/// header. Files without it are in the original format, which starts with the
+/// image width. A width this large cannot be stored in memory anyways.
+constexpr inline Word FormatMagic = static_cast<Word>(0x4B30'3448'4352'4142U);
+//                                                        K 0  4 H  C R  A B
+
+/// FormatVersion specifies the version of the format header that is written by
+/// this version of BarchLib.
+constexpr inline Word FormatVersion = 2;
+
+/// FormatFeature enumerates the optional parts of the format. The format header
+/// holds a combination of them.
+enum FormatFeature : Word {
+  /// Specifies that the pixel data is followed by the row index.
+  RowIndexFeature = 1U << 0,
+  /// Specifies that the pixels are encoded tile by tile rather than row by
+  /// row. The tile size follows the size of the bitmap, and the tile index
+  /// follows everything else.
+  TiledFeature = 1U << 1,
+  /// Specifies that the blocks of pixels are not 4 pixels wide. The block
+  /// width follows the size of the bitmap and the tile size.
+  BlockWidthFeature = 1U << 2,
+  /// Specifies that runs of white or black blocks have codes of their own.
+  /// See Encoder.
+  RunLengthFeature = 1U << 3,
+};
+
+/// KnownFormatFeatures holds all the features this version of BarchLib can
+/// load.
+constexpr inline Word KnownFormatFeatures =
+    RowIndexFeature | TiledFeature | BlockWidthFeature | RunLengthFeature;
+
+/// DefaultBlockWidth specifies how many pixels make up a block of the files
+/// without BlockWidthFeature.
+constexpr inline std::size_t DefaultBlockWidth = 4;
+
+/// Returns `true` if the codec has a flavor for blocks that are `blockWidth`
+/// pixels wide.
+constexpr bool isValidBlockWidth(const std::size_t blockWidth) noexcept {
+  return blockWidth == 4 || blockWidth == 8 || blockWidth == 16;
+}
+
+/// CodeFormat describes the codes that the pixel data is made of.
+struct CodeFormat final {
+  /// Specifies how many pixels a code stands for: 4, 8 or 16.
+  std::size_t blockWidth = DefaultBlockWidth;
+
+  /// Specifies whether runs of white or black blocks have codes of their own.
+  bool hasRunCodes = false;
+
+  /// Returns the format features that tell how the pixel data is coded.
+  Word features() const noexcept {
+    return (blockWidth != DefaultBlockWidth ? BlockWidthFeature : Word{0}) |
+           (hasRunCodes ? RunLengthFeature : Word{0});
+  }
+
+  /// Returns the number of bits a literal block takes.
+  std::size_t literalBitCount() const noexcept {
+    return (hasRunCodes ? 3 : 2) + blockWidth * bitsPer<Pixel>;
+  }
+};
+
+struct Decoder;
+
+/// Writes the format header, unless there are no features, followed by the
+/// size of the bitmap.
+void saveHeader(BitmapSizeWriter auto &writer, const Word features,
+                const BitmapSize &size) {
+  if (features) {
+    write(writer, FormatMagic);
+    write(writer, FormatVersion);
+    write(writer, features);
+  }
+  save(writer, size);
+}
+
+/// Reads what saveHeader wrote. Returns the features.
+/// Throws InvalidFormat if this version of BarchLib cannot load the rest.
+Word loadHeader(BitmapSizeReader auto &reader, BitmapSize &size) {
+  // Files in the original format don't have a header. They start with the
+  // image width right away.
+  Word features = 0;
+  std::size_t width = 0;
+  read(reader, width);
+  if (width == FormatMagic) {
+    std::size_t version = 0;
+    read(reader, version);
+    if (version < 2 || version > FormatVersion) {
+      throw InvalidFormat{InvalidFormat::UnsupportedVersion};
+    }
+    read(reader, features);
+    if (features & ~KnownFormatFeatures) {
+      throw InvalidFormat{InvalidFormat::UnsupportedFeatures};
+    }
+    read(reader, width);
+  }
+  std::size_t height = 0;
+  read(reader, height);
+  size = BitmapSize{width, height};
+  return features;
+}
+
+/// Writes the part of the code format that the features don't tell: the block
+/// width, unless it's DefaultBlockWidth.
+void saveCodeFormat(BitmapSizeWriter auto &writer, const CodeFormat &format) {
+  if (format.features() & BlockWidthFeature) {
+    write(writer, format.blockWidth);
+  }
+}
+
+/// Reads what saveCodeFormat wrote, given the features that loadHeader
+/// returned.
+/// Throws InvalidFormat if the codec has no flavor for the block width.
+CodeFormat loadCodeFormat(BitmapSizeReader auto &reader, const Word features) {
+  CodeFormat format;
+  if (features & BlockWidthFeature) {
+    read(reader, format.blockWidth);
+    if (!isValidBlockWidth(format.blockWidth)) {
+      throw InvalidFormat{InvalidFormat::CorruptData};
+    }
+  }
+  format.hasRunCodes = (features & RunLengthFeature) != 0;
+  return format;
+}
+
+/// TileGrid splits a bitmap into square tiles. The tiles at the right and
+/// bottom edges are cut short if the bitmap size is not a multiple of the tile
+/// size. The tiles are numbered row by row.
+struct TileGrid final {
+
+  /// Precondition: tileSize is not 0.
+  TileGrid(const BitmapSize &size, const std::size_t tileSize) noexcept
+      : m_size{size}, m_tileSize{tileSize} {}
+
+  std::size_t tileSize() const noexcept { return m_tileSize; }
+
+  std::size_t columnCount() const noexcept {
+    return m_size.width() / m_tileSize + (m_size.width() % m_tileSize != 0);
+  }
+
+  std::size_t rowCount() const noexcept {
+    return m_size.height() / m_tileSize + (m_size.height() % m_tileSize != 0);
+  }
+
+  std::size_t tileCount() const noexcept { return columnCount() * rowCount(); }
+
+  /// Returns the width of the tiles in the given column.
+  std::size_t tileWidth(const std::size_t column) const noexcept {
+    return std::min(m_tileSize, m_size.width() - column * m_tileSize);
+  }
+
+  /// Returns the height of the tiles in the given row.
+  std::size_t tileHeight(const std::size_t row) const noexcept {
+    return std::min(m_tileSize, m_size.height() - row * m_tileSize);
+  }
+
+private:
+  BitmapSize m_size;
+  std::size_t m_tileSize;
+};
+
 } // namespace Internal
 
 template <typename T>
@@ -288,37 +760,427 @@ template <typename T>
 concept CompressedBitmapReader =
     Internal::BitmapSizeReader<T> && Internal::BitSetReader<T>;
 
+template <typename T>
+concept CompressedBitmapStreamWriter =
+    CompressedBitmapWriter<T> && SeekableWriter<T>;
+
+struct CompressedBitmap;
+struct CompressedBitmapView;
+struct StreamingEncoder;
+struct StreamingDecoder;
+
+/// ProgressHandler is told how many of the rows are done. It's called when the
+/// job starts, when it's done, and at most once per progress interval in
+/// between. The calls never overlap, even if several threads do the job, and
+/// `currentStep` never goes down.
 using ProgressHandler = std::function<void(std::size_t /* currentStep */,
                                            std::size_t /* totalSteps */)>;
 
+/// DefaultProgressInterval is short enough for a progress bar to move smoothly,
+/// and long enough not to flood an event loop with updates.
+constexpr inline std::chrono::milliseconds DefaultProgressInterval{50};
+
+/// CancellationToken lets any thread stop compress() or uncompress() early.
+/// The threads that do the job check it every few rows, and throw Cancelled
+/// once it's cancelled.
+struct CancellationToken final {
+  void cancel() noexcept {
+    m_isCancelled.store(true, std::memory_order_relaxed);
+  }
+
+  /// Makes the token usable for another job.
+  void reset() noexcept {
+    m_isCancelled.store(false, std::memory_order_relaxed);
+  }
+
+  bool isCancelled() const noexcept {
+    return m_isCancelled.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<bool> m_isCancelled{false};
+};
+
+/// Tells whether BarchLib was built with BARCHLIB_STATISTICS turned on.
+constexpr inline bool StatisticsAreEnabled = BARCHLIB_STATISTICS != 0;
+
+/// CodecStatistics tell why a bitmap compresses the way it does. They are only
+/// collected if StatisticsAreEnabled. Otherwise, they stay 0.
+struct CodecStatistics final {
+  /// Holds the number of rows that were skipped because they are empty. The
+  /// rows of empty tiles count too.
+  std::size_t emptyRowCount = 0;
+
+  /// Hold the number of blocks that were coded as white, black and literal
+  /// blocks respectively.
+  std::size_t whiteBlockCount = 0;
+  std::size_t blackBlockCount = 0;
+  std::size_t literalBlockCount = 0;
+
+  /// Holds the number of run codes. The blocks they stand for are counted as
+  /// white or black blocks above.
+  std::size_t runCount = 0;
+
+  /// Holds the number of blocks that were padded, because the width of the
+  /// rows (or tiles) is not a multiple of the block width. They are not
+  /// counted above.
+  std::size_t paddingBlockCount = 0;
+
+  /// Holds the number of bits of the pixel data that were written or read.
+  std::size_t bitCount = 0;
+
+  /// Holds the time it took to find where the bands start, so that they can
+  /// be decoded by several threads.
+  std::chrono::nanoseconds scanningTime{0};
+
+  /// Holds the time it took to encode or decode the rows.
+  std::chrono::nanoseconds codingTime{0};
+
+  /// Holds the time it took to splice the bands that were encoded by several
+  /// threads together.
+  std::chrono::nanoseconds splicingTime{0};
+
+  CodecStatistics &operator+=(const CodecStatistics &other) noexcept;
+};
+
+/// BlockWidth enumerates how many pixels a code of the pixel data stands for.
+/// Wider blocks take fewer bits for long white and black runs, but more bits
+/// for the blocks that are neither white nor black.
+enum class BlockWidth : std::size_t {
+  /// Picks whichever of the widths below takes the fewest bits, judging by a
+  /// sample of the rows.
+  Auto = 0,
+  Four = 4,
+  Eight = 8,
+  Sixteen = 16,
+};
+
+/// CompressionOptions tweak the way a Bitmap is compressed.
+struct CompressionOptions final {
+  /// Specifies how many consecutive rows share an entry of the row index. The
+  /// row index allows decoding a row without decoding the rows above it.
+  /// Smaller groups make random access faster at the cost of 1 word per group.
+  /// 0 means that no row index is built. Larger groups than the height of the
+  /// bitmap are clamped to it.
+  std::size_t rowGroupSize = 0;
+
+  /// Specifies how many threads may compress horizontal bands of the bitmap
+  /// at the same time. 0 means one thread per hardware thread. The result is
+  /// the same regardless of the number of threads.
+  std::size_t threadCount = 1;
+
+  /// Specifies the width and height of the tiles the bitmap is split into.
+  /// Every tile is encoded on its own, so that a region can be decoded at a
+  /// cost proportional to its size. 0 means that the rows are encoded whole.
+  /// Tiled bitmaps don't need a row index, so `rowGroupSize` is ignored.
+  std::size_t tileSize = 0;
+
+  /// Specifies how many pixels make up a block. Bitmaps with blocks of 4
+  /// pixels are the only ones that older versions of BarchLib can load.
+  BlockWidth blockWidth = BlockWidth::Four;
+
+  /// Specifies whether runs of 8 or more white or black blocks get a code of
+  /// their own, whose size grows with the logarithm of the run length. That
+  /// makes the margins of a page nearly free, at the cost of 1 more bit per
+  /// literal block. Older versions of BarchLib cannot load such bitmaps.
+  bool runLengthCodes = false;
+
+  /// Specifies where the compressed bitmap gets its memory from. nullptr means
+  /// the default memory resource. Only the calling thread allocates from it;
+  /// the other threads allocate their scratch buffers from the default one.
+  std::pmr::memory_resource *memoryResource = nullptr;
+
+  /// Specifies where the statistics are added to. nullptr means that they are
+  /// not collected.
+  CodecStatistics *statistics = nullptr;
+
+  /// Specifies how often the progress is reported at most. 0 means that it's
+  /// reported after every row.
+  std::chrono::milliseconds progressInterval = DefaultProgressInterval;
+
+  /// Specifies the token that stops the compression once it's cancelled.
+  /// nullptr means that it cannot be cancelled.
+  const CancellationToken *cancellation = nullptr;
+};
+
+/// DecompressionOptions tweak the way a CompressedBitmap is uncompressed.
+struct DecompressionOptions final {
+  /// Specifies how many threads may decode horizontal bands of the bitmap at
+  /// the same time. 0 means one thread per hardware thread. Bitmaps with a
+  /// row index are split into bands right away. The others are scanned once
+  /// to find where the bands start.
+  std::size_t threadCount = 1;
+
+  /// Specifies where the uncompressed Bitmap gets its pixels from. nullptr
+  /// means the default memory resource. Only the calling thread allocates from
+  /// it.
+  std::pmr::memory_resource *memoryResource = nullptr;
+
+  /// Specifies where the statistics are added to. nullptr means that they are
+  /// not collected.
+  CodecStatistics *statistics = nullptr;
+
+  /// See CompressionOptions::progressInterval.
+  std::chrono::milliseconds progressInterval = DefaultProgressInterval;
+
+  /// Specifies the token that stops the decompression once it's cancelled.
+  /// nullptr means that it cannot be cancelled.
+  const CancellationToken *cancellation = nullptr;
+};
+
+namespace Internal {
+
+struct ProgressReporter;
+
+/// RowSink hands out the rows of a PixelSink, whatever its type is.
+struct RowSink final {
+  /// Returns where the row at Y goes.
+  std::function<MutablePixels(std::size_t /* y */)> rowAt;
+
+  /// Specifies that the pixels are white already, so that empty rows and tiles
+  /// don't need to be filled.
+  bool isWhite = false;
+};
+
+void uncompressInto(const CompressedBitmapView &sourceBitmap,
+                    const RowSink &sink, const DecompressionOptions &options,
+                    const ProgressHandler &progress);
+
+} // namespace Internal
+
+/// StridedPixels is a PixelSink that refers to rows of pixels that are laid out
+/// at a fixed distance from each other, like the scan lines of most images.
+struct StridedPixels final {
+  /// Points to the first pixel of the first row.
+  Pixel *data;
+
+  /// Specifies how many pixels there are in a row.
+  std::size_t width;
+
+  /// Specifies the distance between the starts of two consecutive rows in
+  /// bytes. It's at least `width`.
+  std::size_t stride;
+
+  friend MutablePixels rowAt(StridedPixels &pixels, const std::size_t y) {
+    return {pixels.data + y * pixels.stride, pixels.width};
+  }
+};
+
+/// CompressedBitmapView refers to a compressed bitmap that was saved into
+/// memory, for example a file that was mapped into memory. Nothing is copied:
+/// the row lookup table and the pixel data are read straight from the saved
+/// words. A CompressedBitmap converts to a view of itself implicitly, so the
+/// functions that decode rows accept either of them.
+struct [[nodiscard]] CompressedBitmapView final {
+
+  /// Refers to the compressed bitmap that `words` start with. The words must
+  /// be laid out in memory the same way save() writes them, and must outlive
+  /// the view.
+  /// Throws InvalidFormat if this version of BarchLib cannot load the words,
+  /// or if there are too few of them.
+  explicit CompressedBitmapView(std::span<Internal::Word const> words);
+
+  std::size_t width() const noexcept { return m_size.width(); }
+  std::size_t height() const noexcept { return m_size.height(); }
+
+  bool isEmptyRowAt(std::size_t y) const;
+
+  /// See CompressedBitmap::hasRowIndex.
+  bool hasRowIndex() const noexcept { return m_rowGroupSize != 0; }
+
+  /// See CompressedBitmap::rowGroupSize.
+  std::size_t rowGroupSize() const noexcept { return m_rowGroupSize; }
+
+  /// See CompressedBitmap::isTiled.
+  bool isTiled() const noexcept { return m_tileSize != 0; }
+
+  /// See CompressedBitmap::tileSize.
+  std::size_t tileSize() const noexcept { return m_tileSize; }
+
+  /// See CompressedBitmap::blockWidth.
+  std::size_t blockWidth() const noexcept { return m_codeFormat.blockWidth; }
+
+  /// See CompressedBitmap::hasRunCodes.
+  bool hasRunCodes() const noexcept { return m_codeFormat.hasRunCodes; }
+
+  friend Bitmap uncompress(const CompressedBitmapView &sourceBitmap,
+                           ProgressHandler progress);
+
+  friend Bitmap uncompress(const CompressedBitmapView &sourceBitmap,
+                           const DecompressionOptions &options,
+                           ProgressHandler progress);
+
+  friend void uncompressRow(const CompressedBitmapView &sourceBitmap,
+                            std::size_t y, MutablePixels pixels);
+
+  friend Bitmap uncompressRows(const CompressedBitmapView &sourceBitmap,
+                               std::size_t firstY, std::size_t rowCount);
+
+  friend Bitmap uncompressRegion(const CompressedBitmapView &sourceBitmap,
+                                 std::size_t x, std::size_t y,
+                                 std::size_t width, std::size_t height);
+
+  friend Bitmap uncompressPreview(const CompressedBitmapView &sourceBitmap,
+                                  std::size_t scale);
+
+  friend void Internal::uncompressInto(const CompressedBitmapView &sourceBitmap,
+                                       const Internal::RowSink &sink,
+                                       const DecompressionOptions &options,
+                                       const ProgressHandler &progress);
+
+private:
+  friend CompressedBitmap;
+  friend StreamingDecoder;
+
+  /// See CompressedBitmap::m_size.
+  Internal::BitmapSize m_size;
+
+  /// See CompressedBitmap::m_rowLookupTable.
+  Internal::BitSpan m_rowLookupTable;
+
+  /// See CompressedBitmap::m_pixelData.
+  std::span<Internal::Word const> m_pixelData;
+
+  /// See CompressedBitmap::m_rowGroupSize.
+  std::size_t m_rowGroupSize{0};
+
+  /// See CompressedBitmap::m_rowIndex.
+  std::span<Internal::Word const> m_rowIndex;
+
+  /// See CompressedBitmap::m_tileSize.
+  std::size_t m_tileSize{0};
+
+  /// See CompressedBitmap::m_tileIndex.
+  std::span<Internal::Word const> m_tileIndex;
+
+  /// See CompressedBitmap::m_codeFormat.
+  Internal::CodeFormat m_codeFormat;
+
+  CompressedBitmapView(const Internal::BitmapSize &size,
+                       Internal::BitSpan rowLookupTable,
+                       std::span<Internal::Word const> pixelData,
+                       std::size_t rowGroupSize,
+                       std::span<Internal::Word const> rowIndex,
+                       std::size_t tileSize,
+                       std::span<Internal::Word const> tileIndex,
+                       const Internal::CodeFormat &codeFormat) noexcept
+      : m_size{size}, m_rowLookupTable{rowLookupTable}, m_pixelData{pixelData},
+        m_rowGroupSize{rowGroupSize}, m_rowIndex{rowIndex},
+        m_tileSize{tileSize}, m_tileIndex{tileIndex},
+        m_codeFormat{codeFormat} {}
+
+  std::size_t rowGroupCount() const noexcept {
+    return height() / m_rowGroupSize + (height() % m_rowGroupSize != 0);
+  }
+
+  /// Precondition: the bitmap is tiled.
+  Internal::TileGrid tileGrid() const noexcept {
+    return Internal::TileGrid{m_size, m_tileSize};
+  }
+
+  /// Throws InvalidFormat if the row index or the tile index points past the
+  /// pixel data.
+  void validateIndex() const;
+
+  /// Decodes the row at Y of a tiled bitmap into `pixels`.
+  void decodeTiledRow(std::size_t y, MutablePixels pixels) const;
+
+  /// Decodes the tiles of the tile rows in range [firstRow, lastRow) into the
+  /// same pixels of `sink`.
+  void decodeTiles(std::size_t firstRow, std::size_t lastRow,
+                   const Internal::RowSink &sink,
+                   Internal::ProgressReporter &progress,
+                   CodecStatistics *statistics) const;
+
+  /// Returns a decoder that is positioned at the start of the row at Y.
+  Internal::Decoder decoderAt(std::size_t y) const;
+
+  /// Decodes the rows in range [firstY, lastY) into the same rows of `sink`.
+  /// The decoder must be positioned at the start of the row at `firstY`. The
+  /// statistics go wherever the decoder puts them.
+  void decodeRows(Internal::Decoder &rowDecoder, std::size_t firstY,
+                  std::size_t lastY, const Internal::RowSink &sink,
+                  Internal::ProgressReporter &progress) const;
+
+  /// Returns the row at Y of `sink`.
+  /// Throws InvalidSize if its size is not width().
+  MutablePixels rowAt(const Internal::RowSink &sink, std::size_t y) const;
+};
+
 /// CompressedBitmap represents a Bitmap that was compressed with a fancy-pants
 /// algorithm. Almost the famous Middle Out algorithm by Richard Hendricks.
 struct [[nodiscard]] CompressedBitmap final {
 
-  /// Constructs an empty compressed bitmap.
+  /// Constructs an empty compressed bitmap. The row lookup table and the pixel
+  /// data get their memory from `resource`.
   /// Preconditions:
   /// 	- width and height are not 0;
   /// 	- width and height represent an image that can be stored in memory.
-  CompressedBitmap(std::size_t width, std::size_t height);
+  CompressedBitmap(
+      std::size_t width, std::size_t height,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
   std::size_t width() const noexcept { return m_size.width(); }
   std::size_t height() const noexcept { return m_size.height(); }
 
   bool isEmptyRowAt(std::size_t y) const;
 
-  friend CompressedBitmap compress(const Bitmap &sourceBitmap,
+  /// Returns `true` if rows can be decoded without decoding the rows above
+  /// them first.
+  bool hasRowIndex() const noexcept { return m_rowGroupSize != 0; }
+
+  /// Returns how many consecutive rows share an entry of the row index, or 0
+  /// if there's no row index.
+  std::size_t rowGroupSize() const noexcept { return m_rowGroupSize; }
+
+  /// Returns `true` if the pixels are encoded tile by tile. Every tile can be
+  /// decoded without decoding the others.
+  bool isTiled() const noexcept { return m_tileSize != 0; }
+
+  /// Returns the width and height of the tiles, or 0 if the bitmap is not
+  /// tiled.
+  std::size_t tileSize() const noexcept { return m_tileSize; }
+
+  /// Returns how many pixels make up a block of the pixel data: 4, 8 or 16.
+  std::size_t blockWidth() const noexcept { return m_codeFormat.blockWidth; }
+
+  /// Returns `true` if runs of white or black blocks have codes of their own.
+  bool hasRunCodes() const noexcept { return m_codeFormat.hasRunCodes; }
+
+  /// Builds the row index by scanning the pixel data. That's useful for the
+  /// bitmaps that were compressed or saved without one. Tiled bitmaps don't
+  /// need one, so nothing happens for them. Larger groups than the height are
+  /// clamped to it.
+  /// Precondition: rowGroupSize is not 0.
+  void buildRowIndex(std::size_t rowGroupSize);
+
+  /// Returns a view that refers to this bitmap. The view is valid as long as
+  /// this bitmap is neither modified nor destroyed.
+  operator CompressedBitmapView() const noexcept;
+
+  friend CompressedBitmap compress(const BitmapView &sourceBitmap,
                                    ProgressHandler progress);
 
-  friend Bitmap uncompress(const CompressedBitmap &sourceBitmap,
-                           ProgressHandler progress);
+  friend CompressedBitmap compress(const BitmapView &sourceBitmap,
+                                   const CompressionOptions &options,
+                                   ProgressHandler progress);
 
   friend CompressedBitmap load(CompressedBitmapReader auto &reader) {
-    using Internal::load;
+    using namespace Internal;
     CompressedBitmap bitmap{1, 1};
-    load(reader, bitmap.m_size);
-    // Read the row lookup table. It's size is dictated by the image haight.
+    const Word features = loadHeader(reader, bitmap.m_size);
+    if (features & TiledFeature) {
+      read(reader, bitmap.m_tileSize);
+      if (!bitmap.m_tileSize) {
+        throw InvalidFormat{InvalidFormat::CorruptData};
+      }
+    }
+    bitmap.m_codeFormat = loadCodeFormat(reader, features);
+    // Read the row lookup table. It's size is dictated by the image haight, or
+    // by the number of tiles.
     const std::size_t bitsPerWord = Internal::bitsPer<Internal::Word>;
-    std::size_t bitCount = Internal::align(bitmap.height(), bitsPerWord);
+    std::size_t bitCount =
+        Internal::align(bitmap.lookupTableBitCount(), bitsPerWord);
     bitmap.m_rowLookupTable.unsafeResize(bitCount / bitsPerWord);
     load(reader, bitmap.m_rowLookupTable);
     // Read pixel data. It's size is stored explicitly in the image.
@@ -326,25 +1188,61 @@ struct [[nodiscard]] CompressedBitmap final {
     read(reader, numDataWords);
     bitmap.m_pixelData.unsafeResize(numDataWords);
     load(reader, bitmap.m_pixelData);
+    // Read the row index. Its size is dictated by the row group size.
+    if (features & RowIndexFeature) {
+      read(reader, bitmap.m_rowGroupSize);
+      if (!bitmap.m_rowGroupSize || bitmap.m_rowGroupSize > bitmap.height()) {
+        throw InvalidFormat{InvalidFormat::CorruptData};
+      }
+      bitmap.m_rowIndex.resize(bitmap.rowGroupCount());
+      read(reader, std::span<Word>{bitmap.m_rowIndex});
+    }
+    // Read the tile index. Its size is dictated by the number of tiles.
+    if (features & TiledFeature) {
+      bitmap.m_tileIndex.resize(bitmap.tileGrid().tileCount());
+      read(reader, std::span<Word>{bitmap.m_tileIndex});
+    }
+    bitmap.validateIndex();
     return bitmap;
   }
 
   friend void save(CompressedBitmapWriter auto &writer,
                    const CompressedBitmap &bitmap) {
-    save(writer, bitmap.m_size);
+    using namespace Internal;
+    // Bitmaps that don't need any of the optional features are saved in the
+    // original format. Older versions of BarchLib can still load them.
+    const Word features =
+        (bitmap.hasRowIndex() ? RowIndexFeature : Word{0}) |
+        (bitmap.isTiled() ? TiledFeature : Word{0}) |
+        bitmap.m_codeFormat.features();
+    saveHeader(writer, features, bitmap.m_size);
+    if (features & TiledFeature) { write(writer, bitmap.m_tileSize); }
+    saveCodeFormat(writer, bitmap.m_codeFormat);
     save(writer, bitmap.m_rowLookupTable);
     // Write how many words are occupied by pixel data.
     write(writer, bitmap.m_pixelData.wordCount());
     save(writer, bitmap.m_pixelData);
+    if (features & RowIndexFeature) {
+      write(writer, bitmap.m_rowGroupSize);
+      write(writer, std::span<Word const>{bitmap.m_rowIndex});
+    }
+    if (features & TiledFeature) {
+      write(writer, std::span<Word const>{bitmap.m_tileIndex});
+    }
   }
 
 private:
+  friend StreamingEncoder;
+
   /// Holds the size of this CompressedBitmap in pixels.
   Internal::BitmapSize m_size;
 
   /// Holds one bit per row. The bit determines whether the row is empty. Bits
   /// that correspond to empty rows are off. Bits that correspond to non-empty
   /// rows are on. A row is empty if all of its pixels are white.
+  ///
+  /// Tiled bitmaps hold one bit per tile instead, which determines whether the
+  /// tile is empty the same way.
   Internal::BitSet m_rowLookupTable;
 
   /// Holds the encoded data of non-empty rows. The encoding scheme is this:
@@ -352,25 +1250,259 @@ private:
   /// - 10  represents 4 contiguous black pixels;
   /// - 11  starts a sequence of 4 pixels.
   ///   ^^~~~ These are bits.
+  /// Blocks of 8 or 16 pixels are encoded the same way, and so are runs of
+  /// blocks, see m_codeFormat and Encoder.
   Internal::BitSet m_pixelData;
+
+  /// Specifies how many pixels every code of `m_pixelData` stands for, and
+  /// whether runs have codes of their own.
+  Internal::CodeFormat m_codeFormat;
+
+  /// Specifies how many consecutive rows share an entry of `m_rowIndex`. It
+  /// is 0 when there's no row index.
+  std::size_t m_rowGroupSize{0};
+
+  /// Holds one entry per group of rows. The entry is the position in
+  /// `m_pixelData` where the first non-empty row of the group (or of the
+  /// groups below it) starts.
+  std::vector<Internal::Word> m_rowIndex;
+
+  /// Specifies the width and height of the tiles. It is 0 when the rows are
+  /// encoded whole.
+  std::size_t m_tileSize{0};
+
+  /// Holds one entry per tile. The entry is the position in `m_pixelData`
+  /// where the rows of the tile start. They are encoded one after another,
+  /// unless the tile is empty, in which case they are not encoded at all.
+  std::vector<Internal::Word> m_tileIndex;
+
+  std::size_t rowGroupCount() const noexcept {
+    return height() / m_rowGroupSize + (height() % m_rowGroupSize != 0);
+  }
+
+  /// Precondition: the bitmap is tiled.
+  Internal::TileGrid tileGrid() const noexcept {
+    return Internal::TileGrid{m_size, m_tileSize};
+  }
+
+  /// Returns the number of bits in the row lookup table.
+  std::size_t lookupTableBitCount() const noexcept {
+    return isTiled() ? tileGrid().tileCount() : height();
+  }
+
+  /// Throws InvalidFormat if the row index or the tile index points past the
+  /// pixel data.
+  void validateIndex() const;
+
+  /// Encodes the rows in range [firstY, lastY) of the source bitmap into
+  /// `pixelData`, and marks the non-empty ones in the row lookup table. The
+  /// entries of the row index are relative to the start of `pixelData`.
+  /// Returns the number of bits that were written.
+  std::size_t encodeRows(const BitmapView &sourceBitmap, std::size_t firstY,
+                         std::size_t lastY, Internal::BitSet &pixelData,
+                         Internal::ProgressReporter &progress,
+                         CodecStatistics *statistics);
+
+  /// Encodes the tiles of the tile rows in range [firstRow, lastRow) of the
+  /// source bitmap into `pixelData`. The entries of the tile index are
+  /// relative to the start of `pixelData`. The row lookup table is left
+  /// alone. Returns the number of bits that were written.
+  std::size_t encodeTiles(const BitmapView &sourceBitmap, std::size_t firstRow,
+                          std::size_t lastRow, Internal::BitSet &pixelData,
+                          Internal::ProgressReporter &progress,
+                          CodecStatistics *statistics);
+
+  /// Splits the source bitmap into tiles and encodes them on up to
+  /// `threadCount` threads.
+  void compressTiles(const BitmapView &sourceBitmap, std::size_t threadCount,
+                     Internal::ProgressReporter &progress,
+                     CodecStatistics *statistics);
+
 };
 
 CompressedBitmap load(CompressedBitmapReader auto &reader);
 
+/// CompressedBitmapInfo describes a saved CompressedBitmap without its pixels.
+struct CompressedBitmapInfo final {
+  std::size_t width{0};
+  std::size_t height{0};
+
+  /// See CompressedBitmap::tileSize.
+  std::size_t tileSize{0};
+
+  /// See CompressedBitmap::blockWidth.
+  std::size_t blockWidth{Internal::DefaultBlockWidth};
+
+  /// See CompressedBitmap::hasRunCodes.
+  bool hasRunCodes{false};
+
+  /// Specifies how many rows are not empty. Tiled bitmaps tell how many tiles
+  /// are not empty instead.
+  std::size_t nonEmptyRowCount{0};
+
+  /// Specifies the size of the pixel data in bytes.
+  std::size_t payloadSize{0};
+};
+
+/// Reads the header and the row lookup table of a saved CompressedBitmap, and
+/// stops right before its pixel data. The size of the bitmap is at a fixed
+/// offset, and the rest takes one bit per row, so that's a small read even for
+/// a huge bitmap. The reader is left positioned at the pixel data.
+/// Throws InvalidFormat if this version of BarchLib cannot load the data.
+CompressedBitmapInfo loadInfo(CompressedBitmapReader auto &reader) {
+  using namespace Internal;
+  BitmapSize size{1, 1};
+  const Word features = loadHeader(reader, size);
+  CompressedBitmapInfo info;
+  info.width = size.width();
+  info.height = size.height();
+  if (features & TiledFeature) {
+    read(reader, info.tileSize);
+    if (!info.tileSize) { throw InvalidFormat{InvalidFormat::CorruptData}; }
+  }
+  const CodeFormat codeFormat = loadCodeFormat(reader, features);
+  info.blockWidth = codeFormat.blockWidth;
+  info.hasRunCodes = codeFormat.hasRunCodes;
+  const std::size_t bitCount =
+      info.tileSize ? TileGrid{size, info.tileSize}.tileCount() : info.height;
+  BitSet rowLookupTable;
+  rowLookupTable.unsafeResize(align(bitCount, bitsPer<Word>) / bitsPer<Word>);
+  load(reader, rowLookupTable);
+  info.nonEmptyRowCount = rowLookupTable.count(0, bitCount);
+  std::size_t numDataWords = 0;
+  read(reader, numDataWords);
+  info.payloadSize = numDataWords * sizeof(Word);
+  return info;
+}
+
+CompressedBitmap compress(
+    const BitmapView &sourceBitmap,
+    ProgressHandler progress = [](const std::size_t /* currentStep */,
+                                  const std::size_t /* totalSteps */) {});
+
 CompressedBitmap compress(
-    const Bitmap &sourceBitmap,
+    const BitmapView &sourceBitmap, const CompressionOptions &options,
+    ProgressHandler progress = [](const std::size_t /* currentStep */,
+                                  const std::size_t /* totalSteps */) {});
+
+Bitmap uncompress(
+    const CompressedBitmapView &sourceBitmap,
     ProgressHandler progress = [](const std::size_t /* currentStep */,
                                   const std::size_t /* totalSteps */) {});
 
 Bitmap uncompress(
-    const CompressedBitmap &sourceBitmap,
+    const CompressedBitmapView &sourceBitmap,
+    const DecompressionOptions &options,
     ProgressHandler progress = [](const std::size_t /* currentStep */,
                                   const std::size_t /* totalSteps */) {});
 
+/// Decodes all the pixels of `sourceBitmap` into `sink` rather than into a new
+/// Bitmap. That saves both the memory and the time it takes to copy the pixels
+/// when they are needed somewhere else anyways.
+/// Throws InvalidSize if a row of the sink is not sourceBitmap.width() pixels
+/// long, and Cancelled if the decompression was cancelled. Either way, some of
+/// the rows of the sink may have been written already.
+void uncompressInto(
+    const CompressedBitmapView &sourceBitmap, PixelSink auto &sink,
+    const DecompressionOptions &options = {},
+    ProgressHandler progress = [](const std::size_t /* currentStep */,
+                                  const std::size_t /* totalSteps */) {}) {
+  const auto sinkRowAt = [&sink](const std::size_t y) {
+    return rowAt(sink, y);
+  };
+  Internal::uncompressInto(sourceBitmap, Internal::RowSink{sinkRowAt}, options,
+                           progress);
+}
+
+/// Returns the exact number of bits that the encoded pixels of `bitmap` take
+/// once it is compressed with blocks of the given width, and with or without
+/// run codes. Empty rows take none. BlockWidth::Auto is the width that
+/// compress() would pick.
+[[nodiscard]] std::size_t
+compressedSizeOf(const BitmapView &bitmap,
+                 BlockWidth blockWidth = BlockWidth::Four,
+                 bool runLengthCodes = false);
+
+/// Decodes the row at Y into `pixels`. If the bitmap has a row index, only
+/// the rows of the same row group that are above Y need to be skipped.
+/// Preconditions:
+/// 	- y is in range [0, height());
+/// 	- pixels.size() is equal to width().
+void uncompressRow(const CompressedBitmapView &sourceBitmap, std::size_t y,
+                   MutablePixels pixels);
+
+/// Decodes `rowCount` rows starting with the row at `firstY`.
+/// Preconditions:
+/// 	- rowCount is not 0;
+/// 	- firstY + rowCount is in range [1, height()].
+Bitmap uncompressRows(const CompressedBitmapView &sourceBitmap,
+                      std::size_t firstY, std::size_t rowCount);
+
+/// Decodes the region of `width` x `height` pixels whose top left corner is at
+/// (x, y). Tiled bitmaps decode only the tiles that overlap the region. The
+/// others decode the whole rows the region spans.
+/// Preconditions:
+/// 	- width and height are not 0;
+/// 	- x + width is in range [1, sourceBitmap.width()];
+/// 	- y + height is in range [1, sourceBitmap.height()].
+Bitmap uncompressRegion(const CompressedBitmapView &sourceBitmap,
+                        std::size_t x, std::size_t y, std::size_t width,
+                        std::size_t height);
+
+/// Decodes a preview that is `scale` times smaller than `sourceBitmap` in both
+/// directions. Only every scale-th row is decoded, and the empty ones are not
+/// decoded at all. The codes of the rows in between are skipped, unless the
+/// row index lets the decoder jump over them. Tiled bitmaps keep a decoder per
+/// column of tiles, so every tile is scanned once. Every pixel of the preview
+/// is the darkest of the `scale` pixels of its row, so that thin black lines
+/// don't vanish.
+/// Throws InvalidSize if `scale` is 0.
+Bitmap uncompressPreview(const CompressedBitmapView &sourceBitmap,
+                         std::size_t scale);
+
 namespace Internal {
 
+/// InstructionSet enumerates the kernels that BarchLib has for the scanning of
+/// pixels. The best one that the CPU supports is picked at runtime.
+enum class InstructionSet {
+  Scalar = 0, ///< Portable C++.
+  SSE2 = 1,
+  AVX2 = 2,
+  AVX512 = 3, ///< AVX-512 Foundation.
+};
+
+/// Returns the best instruction set that is supported by the CPU and the OS.
+[[nodiscard]] InstructionSet detectInstructionSet() noexcept;
+
+/// Returns `true` if all the pixels are white.
 [[nodiscard]] bool isEmpty(const ImmutablePixels pixels);
 
+/// Same as above, but uses the kernel for the given instruction set.
+/// Precondition: the instruction set is supported.
+[[nodiscard]] bool isEmpty(const ImmutablePixels pixels,
+                           InstructionSet instructionSet);
+
+/// BlockClasses tells which of (up to) 64 consecutive blocks of four pixels
+/// are white and which are black. Bit N corresponds to block N. The blocks
+/// that are neither white nor black are encoded literally.
+struct BlockClasses final {
+  std::uint64_t white;
+  std::uint64_t black;
+};
+
+/// BlockClassesCapacity specifies how many blocks fit into BlockClasses.
+constexpr inline std::size_t BlockClassesCapacity = 64;
+
+/// Classifies the blocks of four pixels that make up `pixels`.
+/// Precondition: pixels.size() is a multiple of 4 and is not larger than
+/// `4 * BlockClassesCapacity`.
+[[nodiscard]] BlockClasses classifyBlocks(const ImmutablePixels pixels);
+
+/// Same as above, but uses the kernel for the given instruction set.
+/// Precondition: the instruction set is supported.
+[[nodiscard]] BlockClasses classifyBlocks(const ImmutablePixels pixels,
+                                          InstructionSet instructionSet);
+
 // PixelBlock represents a combination of four consecutive pixels.
 using PixelBlock = std::uint32_t;
 
@@ -422,49 +1554,411 @@ constexpr inline auto split = splitLittleEndian;
 #error "Cannot detect the endianess of your target platform."
 #endif
 
+/// MinRunLength specifies how many white or black blocks in a row make up a
+/// run that has a code of its own. Shorter runs take fewer bits as they are.
+constexpr inline std::size_t MinRunLength = 8;
+
 /// Encoder knows how to encode pixels into a stream of bits.
+///
+/// Every code stands for a block of `blockWidth` pixels: 4, 8 or 16 of them.
+/// The codes of the blocks that are neither white nor black are followed by
+/// their pixels, which are moved 4 at a time. The loops that do that are
+/// instantiated for every block width, and the right one is picked once per
+/// row.
+///
+/// If the code format has run codes, these are the codes instead:
+/// - 0   represents a white block;
+/// - 10  represents a black block;
+/// - 110 starts a literal block;
+/// - 111 starts a run of at least `MinRunLength` blocks. The next bit is 0 for
+///   white and 1 for black, and the length minus `MinRunLength - 1` follows
+///   as an Elias gamma code: N zeros, then the N + 1 bits of the number.
+/// A run never spans several rows.
 struct [[nodiscard]] Encoder final {
 
-  Encoder(BitSet &output) noexcept : m_output{&output} {}
+  /// The blocks are counted into `statistics`, unless it's nullptr.
+  /// Precondition: format.blockWidth is 4, 8 or 16.
+  Encoder(BitSet &output, CodecStatistics *statistics = nullptr,
+          const CodeFormat &format = {}) noexcept
+      : m_writer{output}, m_statistics{statistics}, m_format{format} {}
 
   void encode(ImmutablePixels pixels);
 
+  BitWriter &writer() noexcept { return m_writer; }
+
+  CodecStatistics *statistics() const noexcept { return m_statistics; }
+
+  const CodeFormat &codeFormat() const noexcept { return m_format; }
+
+  /// Returns the number of bits `encode` writes for `pixels` in the given
+  /// code format.
+  [[nodiscard]] static std::size_t bitCountOf(ImmutablePixels pixels,
+                                              const CodeFormat &format = {});
+
+  /// Returns the position in the stream of bits.
+  std::size_t bitIndex() const noexcept { return m_writer.bitCount(); }
+
 private:
-  BitSet *m_output;
+  BitWriter m_writer;
 
-  /// Specifies the position in the stream of bits.
-  std::size_t m_index{0};
+  CodecStatistics *m_statistics;
 
-  void write0(); ///< Writes a clear bit.
-  void write1(); ///< Writes a set   bit.
+  CodeFormat m_format;
 
-  using WriteBit = void (Encoder::*)();
+  template <std::size_t Width> void encodeBlocks(ImmutablePixels pixels);
 
-  constexpr static WriteBit Write[2] = {&Encoder::write0, &Encoder::write1};
+  /// Writes the code of a single block.
+  template <std::size_t Width> void write(const Pixel *block);
 
-  void write(const PixelBlock block);
+  /// Writes up to `BlockClassesCapacity` blocks that were classified up front.
+  /// Precondition: the code format has no run codes.
+  template <std::size_t Width>
+  void write(const Pixel *pixels, std::size_t blockCount,
+             BlockClasses classes);
+
+  /// Writes the code of a literal block, followed by its pixels.
+  template <std::size_t Width> void writeLiteral(const Pixel *block);
+
+  /// Writes the codes of `blockCount` blocks of the given color.
+  /// Precondition: the code format has run codes.
+  void writeRun(Pixel color, std::size_t blockCount);
 };
 
-/// Decoder knows how to decode pixels from a stream of bits.
+/// Decoder knows how to decode pixels from a stream of bits. See Encoder.
 struct [[nodiscard]] Decoder final {
 
-  Decoder(const BitSet &input) noexcept : m_input{&input} {}
+  /// Precondition: format.blockWidth is 4, 8 or 16.
+  Decoder(const BitSet &input, const CodeFormat &format = {}) noexcept
+      : m_reader{input.words()}, m_format{format} {}
+
+  /// Precondition: format.blockWidth is 4, 8 or 16.
+  Decoder(const std::span<Word const> input, const std::size_t bitIndex = 0,
+          const CodeFormat &format = {}) noexcept
+      : m_reader{input, bitIndex}, m_format{format} {}
 
   void decode(MutablePixels pixels);
 
+  /// Skips the codes of `blockCount` blocks.
+  void skip(std::size_t blockCount);
+
+  /// Skips the codes of `rowCount` rows that are `width` pixels wide.
+  void skipRows(const std::size_t rowCount, const std::size_t width) {
+    const std::size_t blockWidth = m_format.blockWidth;
+    skip(rowCount * ((width + blockWidth - std::size_t{1}) / blockWidth));
+  }
+
+  const CodeFormat &codeFormat() const noexcept { return m_format; }
+
+  /// Returns the position in the stream of bits.
+  std::size_t bitIndex() const noexcept { return m_reader.bitIndex(); }
+
+  /// Counts the blocks that are decoded from now on into `statistics`, unless
+  /// it's nullptr. The skipped ones don't count.
+  void collectStatistics(CodecStatistics *statistics) noexcept {
+    m_statistics = statistics;
+  }
+
+  CodecStatistics *statistics() const noexcept { return m_statistics; }
+
 private:
-  const BitSet *m_input;
+  BitReader m_reader;
+
+  CodeFormat m_format;
 
-  /// Specifies the position in the stream of bits.
-  std::size_t m_index{0};
+  CodecStatistics *m_statistics = nullptr;
 
-  /// Returns `true` if the bit is set, `false` otherwise.
-  bool readBit();
+  /// Decodes the code of a single block into `Width` pixels.
+  template <std::size_t Width> void read(Pixel *block);
 
-  PixelBlock read();
+  /// Decodes a literal block into `Width` pixels, code and all.
+  template <std::size_t Width> void readLiteral(Pixel *block);
+
+  /// Decodes the length of a run, which follows its code and color.
+  std::size_t readRunLength();
+
+  /// Decodes `blockCount` blocks into `pixels`. If `Store` is `false`, the
+  /// blocks are skipped and `pixels` is not used.
+  template <bool Store, std::size_t Width>
+  void decodeBlocks(Pixel *pixels, std::size_t blockCount);
 };
 
 } // namespace Internal
+
+/// StreamingEncoder compresses a bitmap that is delivered a few rows at a time,
+/// so that the whole Bitmap never has to be in memory. The rows are encoded
+/// exactly like compress() does it.
+///
+/// The pixel data is either kept in memory, or streamed to a writer as the
+/// rows are pushed. In the latter case, the memory footprint doesn't depend on
+/// the amount of pixel data. Only the row lookup table (1 bit per row) and the
+/// row index (1 word per row group) are kept until the end.
+struct [[nodiscard]] StreamingEncoder final {
+
+  /// The rows are always encoded whole: `options.tileSize` is ignored. The
+  /// rows are not known up front, so BlockWidth::Auto means blocks of 4
+  /// pixels.
+  /// Preconditions:
+  /// 	- width and height are not 0;
+  /// 	- width and height represent an image that can be stored in memory.
+  StreamingEncoder(std::size_t width, std::size_t height,
+                   const CompressionOptions &options = {});
+
+  StreamingEncoder(const StreamingEncoder &) = delete;
+  StreamingEncoder &operator=(const StreamingEncoder &) = delete;
+
+  std::size_t width() const noexcept { return m_size.width(); }
+  std::size_t height() const noexcept { return m_size.height(); }
+
+  /// Returns the number of rows that were pushed so far.
+  std::size_t rowCount() const noexcept { return m_rowCount; }
+
+  /// Encodes the next rows. `rows` holds one or more rows, one after another.
+  /// Preconditions:
+  /// 	- rows.size() is a multiple of width();
+  /// 	- there are no more than `height() - rowCount()` rows.
+  void push(ImmutablePixels rows);
+
+  /// Returns the compressed bitmap that is made of the pushed rows. The
+  /// encoder cannot be used afterwards.
+  /// Preconditions:
+  /// 	- all the rows were pushed;
+  /// 	- the pixel data was not streamed to a writer.
+  [[nodiscard]] CompressedBitmap finish();
+
+  /// Writes everything that comes before the pixel data. The row lookup table
+  /// and the size of the pixel data are not known yet, so placeholders are
+  /// written instead. finish(writer) fills them in.
+  /// Precondition: no rows were pushed yet.
+  void start(CompressedBitmapStreamWriter auto &writer) {
+    Internal::saveHeader(writer, features(), m_size);
+    Internal::saveCodeFormat(writer, m_rowEncoder.codeFormat());
+    m_rowLookupTablePosition = tell(writer);
+    save(writer, m_rowLookupTable);
+    write(writer, std::size_t{0});
+  }
+
+  /// Same as push(rows), but also writes the pixel data that is complete.
+  /// Precondition: start(writer) was called.
+  void push(const ImmutablePixels rows,
+            CompressedBitmapStreamWriter auto &writer) {
+    push(rows);
+    writeCompleteWords(writer);
+  }
+
+  /// Writes the rest of the pixel data and the row index, and fills in the
+  /// placeholders. The result is the same as saving the CompressedBitmap
+  /// that finish() returns. The writer is positioned at the end afterwards.
+  /// Preconditions:
+  /// 	- start(writer) was called;
+  /// 	- all the rows were pushed.
+  void finish(CompressedBitmapStreamWriter auto &writer) {
+    requireAllRows();
+    writeCompleteWords(writer);
+    // The last word is not complete. Just like the complete ones, it is
+    // written only if it has some bits set.
+    if (m_pixelData.wordCount() && m_pixelData.words()[0]) {
+      writePendingZeroWords(writer);
+      write(writer, m_pixelData.words()[0]);
+      ++m_writtenWordCount;
+    }
+    if (features() & Internal::RowIndexFeature) {
+      write(writer, m_rowGroupSize);
+      write(writer, std::span<Internal::Word const>{m_rowIndex});
+    }
+    const std::size_t endPosition = tell(writer);
+    seek(writer, m_rowLookupTablePosition);
+    save(writer, m_rowLookupTable);
+    write(writer, m_writtenWordCount);
+    seek(writer, endPosition);
+  }
+
+private:
+  Internal::BitmapSize m_size;
+
+  /// Specifies how many rows were pushed so far.
+  std::size_t m_rowCount{0};
+
+  /// See CompressedBitmap::m_rowLookupTable.
+  Internal::BitSet m_rowLookupTable;
+
+  /// Holds the pixel data. Once it is streamed to a writer, only the words
+  /// that weren't written yet are held.
+  Internal::BitSet m_pixelData;
+
+  Internal::Encoder m_rowEncoder;
+
+  /// See CompressedBitmap::m_rowGroupSize.
+  std::size_t m_rowGroupSize;
+
+  /// See CompressedBitmap::m_rowIndex.
+  std::vector<Internal::Word> m_rowIndex;
+
+  /// Specifies where the row lookup table placeholder was written.
+  std::size_t m_rowLookupTablePosition{0};
+
+  /// Specifies how many words of pixel data were written.
+  std::size_t m_writtenWordCount{0};
+
+  /// Specifies how many words without bits set are held back. They are
+  /// written only if a word with some bits set follows them.
+  std::size_t m_pendingZeroWordCount{0};
+
+  Internal::Word features() const noexcept {
+    using namespace Internal;
+    return (m_rowGroupSize ? RowIndexFeature : Word{0}) |
+           m_rowEncoder.codeFormat().features();
+  }
+
+  /// Throws InvalidCoordinate if some of the rows were not pushed yet.
+  void requireAllRows() const;
+
+  void writePendingZeroWords(CompressedBitmapStreamWriter auto &writer) {
+    for (; m_pendingZeroWordCount; --m_pendingZeroWordCount) {
+      write(writer, Internal::Word{0});
+      ++m_writtenWordCount;
+    }
+  }
+
+  /// Writes the complete words of pixel data and removes them from memory.
+  void writeCompleteWords(CompressedBitmapStreamWriter auto &writer) {
+    Internal::BitWriter &pixelWriter = m_rowEncoder.writer();
+    const std::size_t completeWordCount = pixelWriter.completeWordCount();
+    const std::span<Internal::Word const> words = m_pixelData.words().first(
+        std::min(completeWordCount, m_pixelData.wordCount()));
+    std::size_t wordIndex = 0;
+    while (wordIndex < words.size()) {
+      if (!words[wordIndex]) {
+        ++m_pendingZeroWordCount;
+        ++wordIndex;
+        continue;
+      }
+      // Write a whole run of words with some bits set at once.
+      std::size_t endIndex = wordIndex + 1;
+      while (endIndex < words.size() && words[endIndex]) { ++endIndex; }
+      writePendingZeroWords(writer);
+      write(writer, words.subspan(wordIndex, endIndex - wordIndex));
+      m_writtenWordCount += endIndex - wordIndex;
+      wordIndex = endIndex;
+    }
+    // The complete words that are missing from the pixel data are clear.
+    m_pendingZeroWordCount += completeWordCount - words.size();
+    pixelWriter.discardCompleteWords();
+  }
+};
+
+/// StreamingDecoder uncompresses a bitmap one row at a time into pixels that
+/// the caller provides, so that the whole Bitmap never has to be in memory.
+///
+/// The compressed bitmap is either held in memory, or loaded from a reader as
+/// the rows are pulled. In the latter case, only the row lookup table and the
+/// pixel data of about one row are kept in memory. Either way, empty rows are
+/// filled with white without touching the pixel data at all.
+struct [[nodiscard]] StreamingDecoder final {
+
+  /// Decodes the rows of `sourceBitmap`. The bitmap that the view refers to
+  /// must outlive the decoder.
+  explicit StreamingDecoder(const CompressedBitmapView &sourceBitmap);
+
+  /// Loads the header and the row lookup table right away, and the pixel data
+  /// as the rows are pulled. Once the last row is pulled, the rest of the
+  /// compressed bitmap is read, so that the reader is positioned right past
+  /// it. The reader must outlive the decoder.
+  /// Throws InvalidFormat if this version of BarchLib cannot load the data,
+  /// or if the bitmap is tiled. The rows of a tiled bitmap are scattered all
+  /// over its pixel data, so it has to be held in memory.
+  explicit StreamingDecoder(CompressedBitmapReader auto &reader)
+      : m_size{1, 1},
+        m_readWords{[&reader](const std::span<Internal::Word> words) {
+          read(reader, words);
+        }} {
+    using namespace Internal;
+    m_features = loadHeader(reader, m_size);
+    if (m_features & TiledFeature) {
+      throw InvalidFormat{InvalidFormat::UnsupportedFeatures};
+    }
+    m_codeFormat = loadCodeFormat(reader, m_features);
+    m_loadedRowLookupTable.unsafeResize(align(height(), bitsPer<Word>) /
+                                        bitsPer<Word>);
+    load(reader, m_loadedRowLookupTable);
+    m_rowLookupTable = m_loadedRowLookupTable.words();
+    read(reader, m_unreadWordCount);
+  }
+
+  StreamingDecoder(const StreamingDecoder &) = delete;
+  StreamingDecoder &operator=(const StreamingDecoder &) = delete;
+
+  std::size_t width() const noexcept { return m_size.width(); }
+  std::size_t height() const noexcept { return m_size.height(); }
+
+  /// Returns the number of rows that were pulled so far.
+  std::size_t rowCount() const noexcept { return m_rowCount; }
+
+  /// Counts the rows and blocks that are pulled from now on, and the time it
+  /// takes to decode them, into `statistics`, unless it's nullptr.
+  void collectStatistics(CodecStatistics *statistics) noexcept;
+
+  /// Decodes the next row into `pixels`. Returns `false` without touching
+  /// `pixels` if all the rows were pulled already.
+  /// Precondition: pixels.size() is equal to width().
+  bool pull(MutablePixels pixels);
+
+private:
+  Internal::BitmapSize m_size;
+
+  /// Reads the next words of the compressed bitmap. It is empty if the
+  /// compressed bitmap is held in memory, or once it was read completely.
+  std::function<void(std::span<Internal::Word>)> m_readWords;
+
+  /// Specifies how many rows were pulled so far.
+  std::size_t m_rowCount{0};
+
+  /// See CompressedBitmap::m_rowLookupTable.
+  Internal::BitSpan m_rowLookupTable;
+
+  /// Holds the row lookup table that was read.
+  Internal::BitSet m_loadedRowLookupTable;
+
+  /// Holds the pixel data that is decoded next. While loading from a reader,
+  /// it's the words of `m_buffer`.
+  std::span<Internal::Word const> m_pixelData;
+
+  /// Specifies where the next non-empty row starts in `m_pixelData`.
+  std::size_t m_bitIndex{0};
+
+  /// Holds the pixel data that was read, but not decoded yet.
+  std::vector<Internal::Word> m_buffer;
+
+  /// Holds the features of the format that is being read.
+  Internal::Word m_features{0};
+
+  /// Specifies how many words of pixel data were not read yet.
+  std::size_t m_unreadWordCount{0};
+
+  /// See CompressedBitmap::m_tileSize.
+  std::size_t m_tileSize{0};
+
+  /// See CompressedBitmap::m_tileIndex.
+  std::span<Internal::Word const> m_tileIndex;
+
+  /// See CompressedBitmap::m_codeFormat.
+  Internal::CodeFormat m_codeFormat;
+
+  /// Holds one decoder per tile of the current row of tiles of a tiled bitmap.
+  /// Each of them is positioned at the start of the next row of its tile.
+  std::vector<Internal::Decoder> m_tileDecoders;
+
+  CodecStatistics *m_statistics{nullptr};
+
+  /// Decodes the next row of a tiled bitmap into `pixels`.
+  void decodeTiledRow(MutablePixels pixels);
+
+  /// Reads enough pixel data to decode the next row.
+  void readRow();
+
+  /// Reads the pixel data that is left and the row index.
+  void readRest();
+};
+
 } // namespace BarchLib::inline v1
 
 #endif // BARCHLIB_HPP
@@ -0,0 +1,266 @@
+#include <algorithm>   // for std::copy_n, std::min
+#include <chrono>      // for std::chrono::steady_clock
+#include <cstdint>     // for std::uint64_t
+#include <cstdio>      // for std::printf
+#include <functional>  // for std::function
+#include <iterator>    // for std::size
+#include <span>        // for std::span
+#include <string>      // for std::string
+#include <string_view> // for std::string_view
+#include <vector>      // for std::vector
+
+#include <barchlib.hpp>
+
+// BarchLibBench measures how fast bitmaps of a synthetic corpus are compressed,
+// uncompressed, saved and loaded. The corpus covers the kinds of pages we deal
+// with, at a few sizes whose widths are not a multiple of 4 on purpose.
+//
+// Usage: BarchLibBench [filter]
+//
+// Only the rows whose image or operation name contains `filter` are measured.
+// Throughput is always given in megabytes of uncompressed pixels per second,
+// so that the operations can be compared to each other.
+
+namespace {
+
+/// WordBuffer keeps the words of a saved bitmap in memory, so that saving and
+/// loading don't measure the disk.
+struct WordBuffer {
+  std::vector<std::size_t> words;
+  std::size_t readIndex = 0;
+};
+
+void write(WordBuffer &buffer, const std::size_t value) {
+  buffer.words.push_back(value);
+}
+
+void write(WordBuffer &buffer, const std::span<std::size_t const> values) {
+  buffer.words.insert(buffer.words.end(), values.begin(), values.end());
+}
+
+void read(WordBuffer &buffer, std::size_t &value) {
+  value = buffer.words[buffer.readIndex++];
+}
+
+void read(WordBuffer &buffer, const std::span<std::size_t> values) {
+  std::copy_n(buffer.words.begin() +
+                  static_cast<std::ptrdiff_t>(buffer.readIndex),
+              values.size(), values.begin());
+  buffer.readIndex += values.size();
+}
+
+/// Random is a tiny, deterministic pseudo-random number generator, so that
+/// every run measures the same pixels.
+struct Random {
+  std::uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+  std::uint64_t next() noexcept {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  /// Returns a number in range [0, limit).
+  std::size_t below(const std::size_t limit) noexcept {
+    return static_cast<std::size_t>(next() % limit);
+  }
+};
+
+BarchLib::Bitmap makeBlankPage(const std::size_t width,
+                               const std::size_t height) {
+  return BarchLib::Bitmap{width, height};
+}
+
+BarchLib::Bitmap makeBlackPage(const std::size_t width,
+                               const std::size_t height) {
+  return BarchLib::Bitmap{width, height, BarchLib::Black};
+}
+
+/// Makes a page of text-like strokes: lines of glyphs with margins and gaps
+/// between the lines, so that most rows are empty and the rest are sparse.
+BarchLib::Bitmap makeTextPage(const std::size_t width,
+                              const std::size_t height) {
+  constexpr std::size_t Margin = 40;
+  constexpr std::size_t LineHeight = 36;
+  constexpr std::size_t GlyphHeight = 20;
+  constexpr std::size_t GlyphWidth = 12;
+  BarchLib::Bitmap bitmap{width, height};
+  Random random;
+  for (std::size_t top = Margin; top + GlyphHeight + Margin < height;
+       top += LineHeight) {
+    for (std::size_t left = Margin; left + GlyphWidth + Margin < width;
+         left += GlyphWidth) {
+      // Some cells are spaces between the words.
+      if (random.below(6) == 0) { continue; }
+      // Every glyph is a vertical stem and a horizontal bar.
+      const std::size_t stemX = left + random.below(GlyphWidth - 2);
+      const std::size_t barY = top + random.below(GlyphHeight);
+      for (std::size_t y = top; y < top + GlyphHeight; ++y) {
+        bitmap.pixelAt(stemX, y) = BarchLib::Black;
+        bitmap.pixelAt(stemX + 1, y) = BarchLib::Black;
+      }
+      for (std::size_t x = left; x < left + GlyphWidth - 2; ++x) {
+        bitmap.pixelAt(x, barY) = BarchLib::Black;
+      }
+    }
+  }
+  return bitmap;
+}
+
+/// Makes a page of halftone noise: every pixel is black or white at random.
+/// Almost every block has to be stored as is, which is the worst case.
+BarchLib::Bitmap makeHalftonePage(const std::size_t width,
+                                  const std::size_t height) {
+  BarchLib::Bitmap bitmap{width, height};
+  Random random;
+  for (std::size_t y = 0; y < height; ++y) {
+    for (BarchLib::Pixel &pixel : bitmap.rowAt(y)) {
+      pixel = random.below(2) ? BarchLib::Black : BarchLib::White;
+    }
+  }
+  return bitmap;
+}
+
+struct ImageClass {
+  const char *name;
+  BarchLib::Bitmap (*make)(std::size_t width, std::size_t height);
+};
+
+constexpr ImageClass ImageClasses[] = {
+    {"blank", makeBlankPage},
+    {"text", makeTextPage},
+    {"halftone", makeHalftonePage},
+    {"black", makeBlackPage},
+};
+
+struct ImageSize {
+  std::size_t width;
+  std::size_t height;
+};
+
+// A thumbnail, an A4 page scanned at 300 DPI and at 600 DPI.
+constexpr ImageSize ImageSizes[] = {
+    {317, 449},
+    {2481, 3507},
+    {4961, 7015},
+};
+
+/// Runs `operation` until it took a quarter of a second and at least 3 times.
+/// Returns the fastest run in seconds, which is the least noisy measure.
+double measure(const std::function<void()> &operation) {
+  using Clock = std::chrono::steady_clock;
+  constexpr std::chrono::duration<double> MinimumTotal{0.25};
+  std::chrono::duration<double> total{0};
+  std::chrono::duration<double> fastest{0};
+  for (std::size_t run = 0; run < 3 || total < MinimumTotal; ++run) {
+    const auto start = Clock::now();
+    operation();
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    fastest = run == 0 ? elapsed : std::min(fastest, elapsed);
+    total += elapsed;
+  }
+  return fastest.count();
+}
+
+void report(const char *imageName, const ImageSize &size,
+            const char *operationName, const double seconds,
+            const double ratio) {
+  const double megabytes =
+      static_cast<double>(size.width * size.height) / 1e6;
+  const double nanosecondsPerRow =
+      seconds * 1e9 / static_cast<double>(size.height);
+  const std::string sizeName =
+      std::to_string(size.width) + "x" + std::to_string(size.height);
+  std::printf("%-9s %-10s %-11s %10.1f %12.1f %8.2f\n", imageName,
+              sizeName.c_str(), operationName, megabytes / seconds,
+              nanosecondsPerRow, ratio);
+}
+
+/// Keeps the results alive, so that the compiler can't optimize the work away.
+volatile std::size_t resultSink = 0;
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::string_view filter = argc > 1 ? argv[1] : "";
+  const auto isSelected = [filter](const std::string_view imageName,
+                                   const std::string_view operationName) {
+    return filter.empty() || imageName.find(filter) != std::string_view::npos ||
+           operationName.find(filter) != std::string_view::npos;
+  };
+
+  std::size_t checksum = 0;
+
+  std::printf("%-9s %-10s %-11s %10s %12s %8s\n", "image", "size", "operation",
+              "MB/s", "ns/row", "ratio");
+  for (const ImageClass &imageClass : ImageClasses) {
+    for (const ImageSize &size : ImageSizes) {
+      const BarchLib::Bitmap bitmap = imageClass.make(size.width, size.height);
+      const BarchLib::CompressedBitmap compressedBitmap = compress(bitmap);
+      WordBuffer savedBitmap;
+      save(savedBitmap, compressedBitmap);
+      BarchLib::CompressionOptions autoOptions;
+      autoOptions.blockWidth = BarchLib::BlockWidth::Auto;
+      const BarchLib::CompressedBitmap autoBitmap =
+          compress(bitmap, autoOptions);
+      WordBuffer savedAutoBitmap;
+      save(savedAutoBitmap, autoBitmap);
+      BarchLib::CompressionOptions runOptions;
+      runOptions.runLengthCodes = true;
+      const BarchLib::CompressedBitmap runBitmap = compress(bitmap, runOptions);
+      WordBuffer savedRunBitmap;
+      save(savedRunBitmap, runBitmap);
+      // The ratio of the uncompressed size to the saved size.
+      const auto ratioOf = [&bitmap](const WordBuffer &buffer) {
+        return static_cast<double>(bitmap.pixelCount()) /
+               static_cast<double>(buffer.words.size() * sizeof(std::size_t));
+      };
+      const double ratio = ratioOf(savedBitmap);
+      const double autoRatio = ratioOf(savedAutoBitmap);
+      const double runRatio = ratioOf(savedRunBitmap);
+
+      const std::function<void()> operations[] = {
+          [&] { checksum += compress(bitmap).height(); },
+          [&] { checksum += uncompress(compressedBitmap).height(); },
+          [&] {
+            WordBuffer buffer;
+            buffer.words.reserve(savedBitmap.words.size());
+            save(buffer, compressedBitmap);
+            checksum += buffer.words.size();
+          },
+          [&] {
+            savedBitmap.readIndex = 0;
+            checksum += BarchLib::load(savedBitmap).height();
+          },
+          [&] { checksum += compress(bitmap, autoOptions).height(); },
+          [&] { checksum += uncompress(autoBitmap).height(); },
+          [&] { checksum += compress(bitmap, runOptions).height(); },
+          [&] { checksum += uncompress(runBitmap).height(); },
+      };
+      // The block width that is picked goes into the name of the operation.
+      const std::string autoSuffix =
+          "/" + std::to_string(autoBitmap.blockWidth());
+      const std::string compressAutoName = "compress" + autoSuffix;
+      const std::string uncompressAutoName = "uncompress" + autoSuffix;
+      const char *const operationNames[] = {
+          "compress",
+          "uncompress",
+          "save",
+          "load",
+          compressAutoName.c_str(),
+          uncompressAutoName.c_str(),
+          "compress/run",
+          "uncompress/run"};
+      const double ratios[] = {ratio,     ratio,     ratio,    ratio,
+                               autoRatio, autoRatio, runRatio, runRatio};
+      for (std::size_t index = 0; index < std::size(operations); ++index) {
+        if (!isSelected(imageClass.name, operationNames[index])) { continue; }
+        report(imageClass.name, size, operationNames[index],
+               measure(operations[index]), ratios[index]);
+      }
+    }
+  }
+  resultSink = checksum;
+  return 0;
+}
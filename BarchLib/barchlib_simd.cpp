@@ -0,0 +1,320 @@
+#include "barchlib.hpp"
+
+#include <cstring> // for std::memcpy
+
+// The SIMD kernels are compiled for their target instruction sets regardless
+// of the compiler flags. The one that is actually used is picked at runtime.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#define BARCHLIB_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h> // for __cpuid, __cpuidex
+#define BARCHLIB_TARGET(isa)
+#else
+#include <cpuid.h> // for __get_cpuid, __get_cpuid_count
+#define BARCHLIB_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define BARCHLIB_X86 0
+#endif
+
+//******************************************************************************
+// Portable kernels. They are also used for the pixels that don't fill a whole
+// SIMD register.
+
+namespace BarchLib::inline v1::Internal {
+namespace {
+
+using IsEmptyKernel = bool (*)(const Pixel *pixels, std::size_t pixelCount);
+
+using ClassifyBlocksKernel = BlockClasses (*)(const Pixel *pixels,
+                                              std::size_t blockCount);
+
+bool isEmptyScalar(const Pixel *const pixels, const std::size_t pixelCount) {
+  std::size_t pixelIndex = 0;
+  for (; pixelIndex + sizeof(std::uint64_t) <= pixelCount;
+       pixelIndex += sizeof(std::uint64_t)) {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, pixels + pixelIndex, sizeof(chunk));
+    if (chunk != ~std::uint64_t{0}) { return false; }
+  }
+  for (; pixelIndex < pixelCount; ++pixelIndex) {
+    if (pixels[pixelIndex] != White) { return false; }
+  }
+  return true;
+}
+
+BlockClasses classifyBlocksScalar(const Pixel *const pixels,
+                                  const std::size_t blockCount) {
+  BlockClasses classes{0, 0};
+  for (std::size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex) {
+    // The byte order doesn't matter: all four pixels have the same color.
+    std::uint32_t block;
+    std::memcpy(&block, pixels + blockIndex * 4, sizeof(block));
+    const std::uint64_t bit = std::uint64_t{1} << blockIndex;
+    if (block == 0xFF'FF'FF'FFU) { classes.white |= bit; }
+    if (block == 0x00'00'00'00U) { classes.black |= bit; }
+  }
+  return classes;
+}
+
+#if BARCHLIB_X86
+
+//******************************************************************************
+// SSE2 kernels. They look at 16 pixels (4 blocks) at a time.
+
+BARCHLIB_TARGET("sse2")
+bool isEmptySSE2(const Pixel *const pixels, const std::size_t pixelCount) {
+  const __m128i white = _mm_set1_epi8(static_cast<char>(White));
+  std::size_t pixelIndex = 0;
+  for (; pixelIndex + 16 <= pixelCount; pixelIndex += 16) {
+    const __m128i chunk = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(pixels + pixelIndex));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, white)) != 0xFFFF) {
+      return false;
+    }
+  }
+  return isEmptyScalar(pixels + pixelIndex, pixelCount - pixelIndex);
+}
+
+BARCHLIB_TARGET("sse2")
+BlockClasses classifyBlocksSSE2(const Pixel *const pixels,
+                                const std::size_t blockCount) {
+  const __m128i white = _mm_set1_epi32(-1);
+  const __m128i black = _mm_setzero_si128();
+  BlockClasses classes{0, 0};
+  std::size_t blockIndex = 0;
+  for (; blockIndex + 4 <= blockCount; blockIndex += 4) {
+    const __m128i chunk = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(pixels + blockIndex * 4));
+    const auto whiteMask = static_cast<std::uint64_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, white))));
+    const auto blackMask = static_cast<std::uint64_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, black))));
+    classes.white |= whiteMask << blockIndex;
+    classes.black |= blackMask << blockIndex;
+  }
+  // A full chunk of 64 blocks leaves no tail, and shifting by 64 is undefined.
+  if (blockIndex < blockCount) {
+    const BlockClasses tail =
+        classifyBlocksScalar(pixels + blockIndex * 4, blockCount - blockIndex);
+    classes.white |= tail.white << blockIndex;
+    classes.black |= tail.black << blockIndex;
+  }
+  return classes;
+}
+
+//******************************************************************************
+// AVX2 kernels. The empty row check looks at 64 pixels at a time, and the
+// block classifier at 32 pixels (8 blocks).
+
+BARCHLIB_TARGET("avx2")
+bool isEmptyAVX2(const Pixel *const pixels, const std::size_t pixelCount) {
+  const __m256i white = _mm256_set1_epi8(static_cast<char>(White));
+  std::size_t pixelIndex = 0;
+  for (; pixelIndex + 64 <= pixelCount; pixelIndex += 64) {
+    const __m256i chunk0 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pixels + pixelIndex));
+    const __m256i chunk1 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pixels + pixelIndex + 32));
+    // A pixel is white only if all of its bits are on.
+    const __m256i chunk = _mm256_and_si256(chunk0, chunk1);
+    if (!_mm256_testc_si256(chunk, white)) { return false; }
+  }
+  return isEmptySSE2(pixels + pixelIndex, pixelCount - pixelIndex);
+}
+
+BARCHLIB_TARGET("avx2")
+BlockClasses classifyBlocksAVX2(const Pixel *const pixels,
+                                const std::size_t blockCount) {
+  const __m256i white = _mm256_set1_epi32(-1);
+  const __m256i black = _mm256_setzero_si256();
+  BlockClasses classes{0, 0};
+  std::size_t blockIndex = 0;
+  for (; blockIndex + 8 <= blockCount; blockIndex += 8) {
+    const __m256i chunk = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pixels + blockIndex * 4));
+    const auto whiteMask = static_cast<std::uint64_t>(_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, white))));
+    const auto blackMask = static_cast<std::uint64_t>(_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, black))));
+    classes.white |= whiteMask << blockIndex;
+    classes.black |= blackMask << blockIndex;
+  }
+  if (blockIndex < blockCount) {
+    const BlockClasses tail =
+        classifyBlocksSSE2(pixels + blockIndex * 4, blockCount - blockIndex);
+    classes.white |= tail.white << blockIndex;
+    classes.black |= tail.black << blockIndex;
+  }
+  return classes;
+}
+
+//******************************************************************************
+// AVX-512 kernels. They look at 64 pixels (16 blocks) at a time.
+
+BARCHLIB_TARGET("avx512f")
+bool isEmptyAVX512(const Pixel *const pixels, const std::size_t pixelCount) {
+  const __m512i white = _mm512_set1_epi32(-1);
+  std::size_t pixelIndex = 0;
+  for (; pixelIndex + 64 <= pixelCount; pixelIndex += 64) {
+    const __m512i chunk = _mm512_loadu_si512(pixels + pixelIndex);
+    if (_mm512_cmpneq_epi32_mask(chunk, white)) { return false; }
+  }
+  return isEmptyAVX2(pixels + pixelIndex, pixelCount - pixelIndex);
+}
+
+BARCHLIB_TARGET("avx512f")
+BlockClasses classifyBlocksAVX512(const Pixel *const pixels,
+                                  const std::size_t blockCount) {
+  const __m512i white = _mm512_set1_epi32(-1);
+  const __m512i black = _mm512_setzero_si512();
+  BlockClasses classes{0, 0};
+  std::size_t blockIndex = 0;
+  for (; blockIndex + 16 <= blockCount; blockIndex += 16) {
+    const __m512i chunk = _mm512_loadu_si512(pixels + blockIndex * 4);
+    const auto whiteMask =
+        static_cast<std::uint64_t>(_mm512_cmpeq_epi32_mask(chunk, white));
+    const auto blackMask =
+        static_cast<std::uint64_t>(_mm512_cmpeq_epi32_mask(chunk, black));
+    classes.white |= whiteMask << blockIndex;
+    classes.black |= blackMask << blockIndex;
+  }
+  if (blockIndex < blockCount) {
+    const BlockClasses tail =
+        classifyBlocksAVX2(pixels + blockIndex * 4, blockCount - blockIndex);
+    classes.white |= tail.white << blockIndex;
+    classes.black |= tail.black << blockIndex;
+  }
+  return classes;
+}
+
+//******************************************************************************
+// CPU feature detection.
+
+void cpuid(const unsigned leaf, const unsigned subleaf, unsigned (&regs)[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int values[4];
+  __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int index = 0; index < 4; ++index) {
+    regs[index] = static_cast<unsigned>(values[index]);
+  }
+#else
+  if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2],
+                         &regs[3])) {
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+  }
+#endif
+}
+
+unsigned maxCpuidLeaf() {
+  unsigned regs[4];
+  cpuid(0, 0, regs);
+  return regs[0];
+}
+
+/// Returns the state components that the OS saves on context switches.
+std::uint64_t xgetbv() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return _xgetbv(0);
+#else
+  unsigned eax = 0;
+  unsigned edx = 0;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (std::uint64_t{edx} << 32) | eax;
+#endif
+}
+
+InstructionSet queryInstructionSet() noexcept {
+  constexpr unsigned SSE2Bit = 1U << 26;     // CPUID.1:EDX
+  constexpr unsigned OSXSAVEBit = 1U << 27;  // CPUID.1:ECX
+  constexpr unsigned AVXBit = 1U << 28;      // CPUID.1:ECX
+  constexpr unsigned AVX2Bit = 1U << 5;      // CPUID.7.0:EBX
+  constexpr unsigned AVX512FBit = 1U << 16;  // CPUID.7.0:EBX
+  constexpr std::uint64_t YMMState = 0x06U;  // XMM and YMM registers.
+  constexpr std::uint64_t ZMMState = 0xE6U;  // Plus opmask and ZMM registers.
+
+  const unsigned maxLeaf = maxCpuidLeaf();
+  if (maxLeaf < 1) { return InstructionSet::Scalar; }
+  unsigned leaf1[4];
+  cpuid(1, 0, leaf1);
+  if (!(leaf1[3] & SSE2Bit)) { return InstructionSet::Scalar; }
+  // The wider registers are usable only if the OS preserves them.
+  if (maxLeaf < 7 || !(leaf1[2] & OSXSAVEBit) || !(leaf1[2] & AVXBit)) {
+    return InstructionSet::SSE2;
+  }
+  const std::uint64_t osState = xgetbv();
+  if ((osState & YMMState) != YMMState) { return InstructionSet::SSE2; }
+  unsigned leaf7[4];
+  cpuid(7, 0, leaf7);
+  if (!(leaf7[1] & AVX2Bit)) { return InstructionSet::SSE2; }
+  if ((leaf7[1] & AVX512FBit) && (osState & ZMMState) == ZMMState) {
+    return InstructionSet::AVX512;
+  }
+  return InstructionSet::AVX2;
+}
+
+#else
+
+InstructionSet queryInstructionSet() noexcept {
+  return InstructionSet::Scalar;
+}
+
+#endif // BARCHLIB_X86
+
+//******************************************************************************
+// Kernel dispatch.
+
+struct Kernels final {
+  IsEmptyKernel isEmpty;
+  ClassifyBlocksKernel classifyBlocks;
+};
+
+Kernels kernelsFor(const InstructionSet instructionSet) noexcept {
+  switch (instructionSet) {
+#if BARCHLIB_X86
+  case InstructionSet::AVX512:
+    return {&isEmptyAVX512, &classifyBlocksAVX512};
+  case InstructionSet::AVX2:
+    return {&isEmptyAVX2, &classifyBlocksAVX2};
+  case InstructionSet::SSE2:
+    return {&isEmptySSE2, &classifyBlocksSSE2};
+#endif
+  default:
+    return {&isEmptyScalar, &classifyBlocksScalar};
+  }
+}
+
+const Kernels &bestKernels() noexcept {
+  static const Kernels kernels = kernelsFor(detectInstructionSet());
+  return kernels;
+}
+
+} // namespace
+
+InstructionSet detectInstructionSet() noexcept {
+  static const InstructionSet instructionSet = queryInstructionSet();
+  return instructionSet;
+}
+
+bool isEmpty(const ImmutablePixels pixels) {
+  return bestKernels().isEmpty(pixels.data(), pixels.size());
+}
+
+bool isEmpty(const ImmutablePixels pixels,
+             const InstructionSet instructionSet) {
+  return kernelsFor(instructionSet).isEmpty(pixels.data(), pixels.size());
+}
+
+BlockClasses classifyBlocks(const ImmutablePixels pixels) {
+  return bestKernels().classifyBlocks(pixels.data(), pixels.size() / 4);
+}
+
+BlockClasses classifyBlocks(const ImmutablePixels pixels,
+                            const InstructionSet instructionSet) {
+  return kernelsFor(instructionSet)
+      .classifyBlocks(pixels.data(), pixels.size() / 4);
+}
+
+} // namespace BarchLib::inline v1::Internal
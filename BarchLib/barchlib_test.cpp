@@ -1,10 +1,16 @@
 #include <catch2/catch_all.hpp>
 
-#include <algorithm> // for std::fill
-#include <array>     // for std::array
-#include <iomanip>   // for std::setfill, std::setw
-#include <limits>    // for std::numeric_limits
-#include <sstream>   // for std::stringstream
+#include <algorithm>       // for std::fill, std::min, std::min_element
+#include <array>           // for std::array
+#include <chrono>          // for std::chrono::milliseconds
+#include <cstdint>         // for std::uintptr_t
+#include <iomanip>         // for std::setfill, std::setw
+#include <limits>          // for std::numeric_limits
+#include <memory_resource> // for std::pmr::memory_resource
+#include <random>          // for std::mt19937_64
+#include <sstream>         // for std::stringstream
+#include <utility>         // for std::pair
+#include <vector>          // for std::vector
 
 #include <barchlib.hpp>
 
@@ -132,6 +138,98 @@ SCENARIO("Bitmap does not allow out of bounds access", "[Bitmap]") {
   }
 }
 
+namespace {
+
+/// CountingResource counts the bytes that are currently allocated from it.
+struct CountingResource final : std::pmr::memory_resource {
+  std::size_t allocatedSize = 0;
+
+private:
+  void *do_allocate(const std::size_t size,
+                    const std::size_t alignment) override {
+    void *const result =
+        std::pmr::new_delete_resource()->allocate(size, alignment);
+    allocatedSize += size;
+    return result;
+  }
+
+  void do_deallocate(void *const pointer, const std::size_t size,
+                     const std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+    allocatedSize -= size;
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // namespace
+
+SCENARIO("Bitmap gets its pixels from a memory resource", "[Bitmap]") {
+  GIVEN("a 3x5 bitmap constructed with a memory resource") {
+    CountingResource resource;
+    {
+      BarchLib::Bitmap bitmap{3, 5, BarchLib::Black, &resource};
+      THEN("its pixels come from that resource") {
+        REQUIRE(bitmap.resource() == &resource);
+        REQUIRE(resource.allocatedSize == 15);
+        REQUIRE(bitmap.pixelAt(2, 4) == BarchLib::Black);
+      }
+      THEN("its pixels are aligned to a cache line") {
+        const auto address = reinterpret_cast<std::uintptr_t>(bitmap.data());
+        REQUIRE(address % BarchLib::PixelAlignment == 0);
+      }
+      WHEN("it's copied") {
+        const BarchLib::Bitmap copy{bitmap};
+        THEN("the copy gets its pixels from the default resource") {
+          REQUIRE(copy.resource() == std::pmr::get_default_resource());
+          REQUIRE(resource.allocatedSize == 15);
+          REQUIRE(copy == bitmap);
+        }
+      }
+      WHEN("another bitmap is copied into it") {
+        const BarchLib::Bitmap other{2, 2};
+        bitmap = other;
+        THEN("it keeps its memory resource") {
+          REQUIRE(bitmap.resource() == &resource);
+          REQUIRE(resource.allocatedSize == 4);
+          REQUIRE(bitmap == BarchLib::Bitmap{2, 2});
+        }
+      }
+    }
+    THEN("its pixels are given back once it's destroyed") {
+      REQUIRE(resource.allocatedSize == 0);
+    }
+  }
+  GIVEN("a bitmap constructed without initializing its pixels") {
+    BarchLib::Bitmap bitmap{4, 2, BarchLib::uninitialized};
+    THEN("it still knows its size") {
+      REQUIRE(bitmap.width() == 4);
+      REQUIRE(bitmap.height() == 2);
+      REQUIRE(bitmap.data() != nullptr);
+    }
+  }
+}
+
+SCENARIO("Bitmap can be moved", "[Bitmap]") {
+  GIVEN("two bitmaps") {
+    BarchLib::Bitmap source{2, 2, BarchLib::Black};
+    BarchLib::Bitmap target{3, 3};
+    const BarchLib::Pixel *const sourcePixels = source.data();
+    WHEN("one is moved into the other") {
+      target = std::move(source);
+      THEN("the pixels are moved rather than copied") {
+        REQUIRE(target.data() == sourcePixels);
+        REQUIRE(target.width() == 2);
+        REQUIRE(target.height() == 2);
+        REQUIRE(target.pixelAt(1, 1) == BarchLib::Black);
+      }
+    }
+  }
+}
+
 SCENARIO("BitSet represents a set of bits", "[BitSet][Internal]") {
   GIVEN("A set of 4 bits") {
     BarchLib::Internal::BitSet bitSet{4};
@@ -146,6 +244,14 @@ SCENARIO("BitSet represents a set of bits", "[BitSet][Internal]") {
       }
     }
   }
+  GIVEN("A set of 200 bits constructed with a memory resource") {
+    CountingResource resource;
+    BarchLib::Internal::BitSet bitSet{200, &resource};
+    THEN("its words come from that resource") {
+      REQUIRE(bitSet.resource() == &resource);
+      REQUIRE(resource.allocatedSize >= 200 / 8);
+    }
+  }
 }
 
 SCENARIO("detect empty rows in a Bitmap", "[Bitmap][Internal]") {
@@ -175,6 +281,80 @@ SCENARIO("detect empty rows in a Bitmap", "[Bitmap][Internal]") {
   }
 }
 
+SCENARIO("every supported kernel detects empty rows", "[Bitmap][Internal]") {
+  using BarchLib::Internal::InstructionSet;
+  const auto supported = BarchLib::Internal::detectInstructionSet();
+  for (const InstructionSet instructionSet :
+       {InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2,
+        InstructionSet::AVX512}) {
+    if (instructionSet > supported) { break; }
+    GIVEN("a row of 131 white pixels and instruction set " +
+          std::to_string(static_cast<int>(instructionSet))) {
+      std::array<BarchLib::Pixel, 131> pixels;
+      std::fill(pixels.begin(), pixels.end(), BarchLib::White);
+      THEN("the row is empty") {
+        REQUIRE(BarchLib::Internal::isEmpty(pixels, instructionSet));
+      }
+      AND_GIVEN("any one of its pixels is not white") {
+        THEN("the row is not empty") {
+          for (auto &pixel : pixels) {
+            pixel = 0xFEU;
+            REQUIRE_FALSE(BarchLib::Internal::isEmpty(pixels, instructionSet));
+            pixel = BarchLib::White;
+          }
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("every supported kernel classifies blocks of pixels",
+         "[Encoder][Internal]") {
+  using BarchLib::Internal::InstructionSet;
+  const auto supported = BarchLib::Internal::detectInstructionSet();
+  for (const InstructionSet instructionSet :
+       {InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2,
+        InstructionSet::AVX512}) {
+    if (instructionSet > supported) { break; }
+    GIVEN("64 blocks that are white, black, or gray in turns and instruction "
+          "set " +
+          std::to_string(static_cast<int>(instructionSet))) {
+      std::array<BarchLib::Pixel, 256> pixels;
+      for (std::size_t index = 0; index < pixels.size(); ++index) {
+        const BarchLib::Pixel colors[] = {BarchLib::White, BarchLib::Black,
+                                          0x80U};
+        pixels[index] = colors[(index / 4) % 3];
+      }
+      // The last pixel of the last block spoils it.
+      pixels[255] = 0x80U;
+      WHEN("they are classified") {
+        const auto classes =
+            BarchLib::Internal::classifyBlocks(pixels, instructionSet);
+        THEN("every third block is white, starting with the first one") {
+          REQUIRE(classes.white == 0x1249'2492'4924'9249U);
+        }
+        THEN("every third block is black, starting with the second one") {
+          REQUIRE(classes.black == 0x2492'4924'9249'2492U);
+        }
+      }
+    }
+    GIVEN("64 white blocks and instruction set " +
+          std::to_string(static_cast<int>(instructionSet))) {
+      // The kernels are left with no blocks after the last full chunk.
+      std::array<BarchLib::Pixel, 256> pixels;
+      std::fill(pixels.begin(), pixels.end(), BarchLib::White);
+      WHEN("they are classified") {
+        const auto classes =
+            BarchLib::Internal::classifyBlocks(pixels, instructionSet);
+        THEN("every block is white") {
+          REQUIRE(classes.white == 0xFFFF'FFFF'FFFF'FFFFU);
+          REQUIRE(classes.black == 0);
+        }
+      }
+    }
+  }
+}
+
 SCENARIO("encoding pixels", "[Encoder][Internal]") {
   GIVEN("pixels: 0xff 0xff 0xff 0xff 0x00 0x00 0x00 0x00 0x01 0x01 0x01 0x01") {
     std::array<BarchLib::Pixel, 12> pixels{0xFFU, 0xFFU, 0xFFU, 0xFFU,
@@ -207,6 +387,96 @@ SCENARIO("encoding pixels", "[Encoder][Internal]") {
   }
 }
 
+SCENARIO("bits are written a whole word at a time", "[BitWriter][Internal]") {
+  using BarchLib::Internal::Word;
+  constexpr std::size_t WordBitCount = BarchLib::Internal::bitsPer<Word>;
+  GIVEN("a writer to an empty BitSet") {
+    BarchLib::Internal::BitSet output;
+    BarchLib::Internal::BitWriter writer{output};
+    WHEN("a code spills across the end of the first word") {
+      writer.write(0U, WordBitCount - 4);
+      writer.write(0b101101U, 6);
+      writer.flush();
+      THEN("its first 4 bits end the first word") {
+        REQUIRE(writer.bitCount() == WordBitCount + 2);
+        REQUIRE(output.words().size() == 2U);
+        REQUIRE(output.words()[0] == 0b1011U);
+      }
+      THEN("its last 2 bits start the second word") {
+        REQUIRE(output.words()[1] == Word{0b01U} << (WordBitCount - 2));
+      }
+    }
+    WHEN("a whole word is written after a few bits") {
+      writer.write(0b1U, 1);
+      writer.write(~Word{0}, WordBitCount);
+      writer.flush();
+      THEN("it is split over two words") {
+        REQUIRE(output.words().size() == 2U);
+        REQUIRE(output.words()[0] == ~Word{0});
+        REQUIRE(output.words()[1] == Word{1} << (WordBitCount - 1));
+      }
+    }
+    WHEN("a partially filled word is flushed") {
+      writer.write(0b11U, 2);
+      writer.flush();
+      THEN("its bits can be seen in the output") {
+        REQUIRE(output.words().size() == 1U);
+        REQUIRE(output.words()[0] == Word{0b11U} << (WordBitCount - 2));
+      }
+      AND_WHEN("more bits are written and flushed") {
+        writer.write(0b01U, 2);
+        writer.flush();
+        THEN("they follow the bits that were flushed before") {
+          REQUIRE(writer.bitCount() == 4U);
+          REQUIRE(output.words().size() == 1U);
+          REQUIRE(output.words()[0] == Word{0b1101U} << (WordBitCount - 4));
+        }
+      }
+    }
+    WHEN("only clear bits are written and flushed") {
+      writer.write(0U, WordBitCount);
+      writer.write(0U, 3);
+      writer.flush();
+      THEN("no words are stored") { REQUIRE(output.words().empty()); }
+    }
+  }
+  GIVEN("codes of every length from 1 to a whole word") {
+    // The golden output comes from writing every bit one by one, which is what
+    // the encoder did before the bits were gathered into words.
+    std::mt19937_64 random{42};
+    std::vector<std::pair<Word, std::size_t>> codes;
+    for (std::size_t round = 0; round < 10; ++round) {
+      for (std::size_t bitCount = 1; bitCount <= WordBitCount; ++bitCount) {
+        const auto bits = static_cast<Word>(random());
+        codes.emplace_back(bitCount < WordBitCount
+                               ? bits & ((Word{1} << bitCount) - 1U)
+                               : bits,
+                           bitCount);
+      }
+    }
+    BarchLib::Internal::BitSet golden;
+    std::size_t bitIndex = 0;
+    for (const auto &[bits, bitCount] : codes) {
+      for (std::size_t index = bitCount; index-- > 0; ++bitIndex) {
+        if ((bits >> index) & 1U) { golden.set(bitIndex); }
+      }
+    }
+    WHEN("they are written a word at a time") {
+      BarchLib::Internal::BitSet output;
+      BarchLib::Internal::BitWriter writer{output};
+      for (const auto &[bits, bitCount] : codes) {
+        writer.write(bits, bitCount);
+      }
+      writer.flush();
+      THEN("the output is the same as if every bit was written one by one") {
+        REQUIRE(writer.bitCount() == bitIndex);
+        REQUIRE(std::equal(output.words().begin(), output.words().end(),
+                           golden.words().begin(), golden.words().end()));
+      }
+    }
+  }
+}
+
 SCENARIO("decoding pixels", "[Decoder][Internal]") {
   GIVEN("bits: 01011 0000 0001 0000 0001 0000 0001 0000 0001") {
     BarchLib::Internal::BitSet encodedPixels;
@@ -229,6 +499,150 @@ SCENARIO("decoding pixels", "[Decoder][Internal]") {
   }
 }
 
+SCENARIO("decoding pixels that span several words", "[Decoder][Internal]") {
+  GIVEN("runs of white, black, and gray pixels that were encoded") {
+    std::array<BarchLib::Pixel, 403> pixels;
+    for (std::size_t index = 0; index < pixels.size(); ++index) {
+      if (index < 280) {
+        pixels[index] = BarchLib::White;
+      } else if (index < 360) {
+        pixels[index] = (index / 4) % 3 ? BarchLib::Black : BarchLib::White;
+      } else {
+        pixels[index] = static_cast<BarchLib::Pixel>(index);
+      }
+    }
+    BarchLib::Internal::BitSet encodedPixels;
+    BarchLib::Internal::Encoder encoder{encodedPixels};
+    encoder.encode(pixels);
+    WHEN("they are decoded") {
+      BarchLib::Internal::Decoder decoder{encodedPixels};
+      std::array<BarchLib::Pixel, 403> decodedPixels;
+      decoder.decode(decodedPixels);
+      THEN("the decoded pixels are equal to the original ones") {
+        REQUIRE(decodedPixels == pixels);
+      }
+    }
+  }
+}
+
+SCENARIO("pixels can be encoded in blocks wider than 4 pixels",
+         "[Encoder][Decoder][Internal]") {
+  GIVEN("runs of white, black, and gray pixels") {
+    std::array<BarchLib::Pixel, 403> pixels;
+    for (std::size_t index = 0; index < pixels.size(); ++index) {
+      if (index < 280) {
+        pixels[index] = BarchLib::White;
+      } else if (index < 360) {
+        pixels[index] = (index / 16) % 3 ? BarchLib::Black : BarchLib::White;
+      } else {
+        pixels[index] = static_cast<BarchLib::Pixel>(index);
+      }
+    }
+    for (const std::size_t blockWidth : {4, 8, 16}) {
+      for (const bool hasRunCodes : {false, true}) {
+        WHEN("they are encoded twice in blocks of " +
+             std::to_string(blockWidth) + " pixels" +
+             (hasRunCodes ? " with run codes" : "")) {
+          const BarchLib::Internal::CodeFormat format{blockWidth, hasRunCodes};
+          BarchLib::Internal::BitSet encodedPixels;
+          BarchLib::Internal::Encoder encoder{encodedPixels, nullptr, format};
+          encoder.encode(pixels);
+          const std::size_t bitCount = encoder.bitIndex();
+          encoder.encode(pixels);
+          THEN("the encoder writes as many bits as it says it would") {
+            REQUIRE(bitCount ==
+                    BarchLib::Internal::Encoder::bitCountOf(pixels, format));
+          }
+          THEN("the decoded pixels are equal to the original ones") {
+            BarchLib::Internal::Decoder decoder{encodedPixels, format};
+            std::array<BarchLib::Pixel, 403> decodedPixels;
+            decoder.decode(decodedPixels);
+            REQUIRE(decodedPixels == pixels);
+          }
+          THEN("the first pixels can be skipped") {
+            BarchLib::Internal::Decoder decoder{encodedPixels, format};
+            decoder.skipRows(1, pixels.size());
+            REQUIRE(decoder.bitIndex() == bitCount);
+            std::array<BarchLib::Pixel, 403> decodedPixels;
+            decoder.decode(decodedPixels);
+            REQUIRE(decodedPixels == pixels);
+          }
+        }
+      }
+    }
+    THEN("wider blocks take fewer bits for the white run") {
+      const auto whiteRun = BarchLib::ImmutablePixels{pixels}.first(256);
+      REQUIRE(BarchLib::Internal::Encoder::bitCountOf(whiteRun, {16}) <
+              BarchLib::Internal::Encoder::bitCountOf(whiteRun, {4}));
+    }
+  }
+}
+
+SCENARIO("long runs of white or black blocks have codes of their own",
+         "[Encoder][Decoder][Internal]") {
+  const BarchLib::Internal::CodeFormat format{4, true};
+  GIVEN("a 40000 pixels wide row with a single black pixel in the middle") {
+    std::vector<BarchLib::Pixel> pixels(40000, BarchLib::White);
+    pixels[20001] = BarchLib::Black;
+    WHEN("it is encoded with run codes") {
+      BarchLib::Internal::BitSet encodedPixels;
+      BarchLib::Internal::Encoder encoder{encodedPixels, nullptr, format};
+      encoder.encode(pixels);
+      THEN("it takes two runs and a literal block") {
+        // 5000 white blocks: 1110, then the gamma code of 4993 in 25 bits.
+        // 1 literal block: 110, then 32 bits. 4999 white blocks: 29 bits.
+        REQUIRE(encoder.bitIndex() == 29 + 35 + 29);
+        REQUIRE(BarchLib::Internal::Encoder::bitCountOf(pixels, format) ==
+                encoder.bitIndex());
+        REQUIRE(encoder.bitIndex() * 100 <
+                BarchLib::Internal::Encoder::bitCountOf(pixels));
+      }
+      THEN("the decoded pixels are equal to the original ones") {
+        BarchLib::Internal::Decoder decoder{encodedPixels, format};
+        std::vector<BarchLib::Pixel> decodedPixels(pixels.size());
+        decoder.decode(decodedPixels);
+        REQUIRE(decodedPixels == pixels);
+      }
+    }
+  }
+  for (const BarchLib::Pixel color : {BarchLib::White, BarchLib::Black}) {
+    const std::size_t blockBitCount = color == BarchLib::White ? 1 : 2;
+    GIVEN(std::string{color == BarchLib::White ? "white" : "black"} +
+          " runs around the shortest run that has a code") {
+      for (const std::size_t blockCount :
+           {std::size_t{1}, BarchLib::Internal::MinRunLength - 1,
+            BarchLib::Internal::MinRunLength,
+            BarchLib::Internal::MinRunLength + 1, std::size_t{300}}) {
+        const std::vector<BarchLib::Pixel> pixels(blockCount * 4, color);
+        BarchLib::Internal::BitSet encodedPixels;
+        BarchLib::Internal::Encoder encoder{encodedPixels, nullptr, format};
+        encoder.encode(pixels);
+        encoder.encode(pixels);
+        THEN("a run of " + std::to_string(blockCount) +
+             " blocks takes the fewer bits of either code") {
+          const std::size_t bitCount = encoder.bitIndex() / 2;
+          if (blockCount < BarchLib::Internal::MinRunLength) {
+            REQUIRE(bitCount == blockCount * blockBitCount);
+          } else {
+            REQUIRE(bitCount < blockCount * blockBitCount);
+          }
+          REQUIRE(BarchLib::Internal::Encoder::bitCountOf(pixels, format) ==
+                  bitCount);
+        }
+        THEN("runs of " + std::to_string(blockCount) +
+             " blocks can be decoded and skipped") {
+          BarchLib::Internal::Decoder decoder{encodedPixels, format};
+          decoder.skipRows(1, pixels.size());
+          std::vector<BarchLib::Pixel> decodedPixels(pixels.size());
+          decoder.decode(decodedPixels);
+          REQUIRE(decodedPixels == pixels);
+          REQUIRE(decoder.bitIndex() == encoder.bitIndex());
+        }
+      }
+    }
+  }
+}
+
 SCENARIO("once constructed, a CompressedBitmap is empty",
          "[CompressedBitmap]") {
   GIVEN("an empty 2x2 compressed bitmap") {
@@ -266,11 +680,14 @@ SCENARIO("a Bitmap can be compressed into a CompressedBitmap",
     bitmap.pixelAt(1, 2) = 0xADU;
     bitmap.pixelAt(2, 2) = 0xBEU;
     bitmap.pixelAt(3, 2) = 0xEFU;
-    WHEN("it is comporessed") {
+    WHEN("it is comporessed with the progress reported after every row") {
       std::string progressLog{};
-      BarchLib::CompressedBitmap compressedBitmap =
-          compress(bitmap, [&progressLog](const std::size_t currentStep,
-                                          const std::size_t totalSteps) {
+      BarchLib::CompressionOptions options;
+      options.progressInterval = std::chrono::milliseconds{0};
+      BarchLib::CompressedBitmap compressedBitmap = compress(
+          bitmap, options,
+          [&progressLog](const std::size_t currentStep,
+                         const std::size_t totalSteps) {
             progressLog +=
                 std::to_string((std::size_t{100} * currentStep) / totalSteps);
             progressLog += "% ";
@@ -294,11 +711,14 @@ SCENARIO("a Bitmap can be compressed into a CompressedBitmap",
     bitmap.pixelAt(2, 2) = 0xBEU;
     bitmap.pixelAt(3, 2) = 0xEFU;
     BarchLib::CompressedBitmap compressedBitmap = compress(bitmap);
-    WHEN("it is uncompressed") {
+    WHEN("it is uncompressed with the progress reported after every row") {
       std::string progressLog{};
+      BarchLib::DecompressionOptions options;
+      options.progressInterval = std::chrono::milliseconds{0};
       BarchLib::Bitmap uncompressedBitmap = uncompress(
-          compressedBitmap, [&progressLog](const std::size_t currentStep,
-                                           const std::size_t totalSteps) {
+          compressedBitmap, options,
+          [&progressLog](const std::size_t currentStep,
+                         const std::size_t totalSteps) {
             progressLog +=
                 std::to_string((std::size_t{100} * currentStep) / totalSteps);
             progressLog += "% ";
@@ -372,3 +792,1291 @@ SCENARIO("Saving compressed bitmap", "[CompressedBitmap]") {
     }
   }
 }
+
+namespace {
+
+/// WordFile keeps the words that were saved, so that they can be loaded back.
+struct WordFile {
+  std::vector<std::size_t> words;
+  std::size_t readIndex = 0;
+  std::size_t writeIndex = 0;
+};
+
+void write(WordFile &file, const std::size_t value) {
+  if (file.writeIndex == file.words.size()) {
+    file.words.push_back(value);
+  } else {
+    file.words[file.writeIndex] = value;
+  }
+  ++file.writeIndex;
+}
+
+void write(WordFile &file, const std::span<std::size_t const> values) {
+  for (const auto value : values) { write(file, value); }
+}
+
+std::size_t tell(WordFile &file) { return file.writeIndex; }
+
+void seek(WordFile &file, const std::size_t position) {
+  file.writeIndex = position;
+}
+
+void read(WordFile &file, std::size_t &value) {
+  value = file.readIndex < file.words.size() ? file.words[file.readIndex] : 0;
+  ++file.readIndex;
+}
+
+void read(WordFile &file, const std::span<std::size_t> values) {
+  for (auto &value : values) { read(file, value); }
+}
+
+/// Makes a bitmap that has empty rows, black rows, and gray rows in turns.
+BarchLib::Bitmap makeStripedBitmap(const std::size_t width,
+                                   const std::size_t height) {
+  BarchLib::Bitmap bitmap{width, height};
+  for (std::size_t y = 0; y < height; ++y) {
+    switch (y % 3) {
+    case 0:
+      break;
+    case 1:
+      fill(bitmap.rowAt(y), BarchLib::Black);
+      bitmap.pixelAt(y % width, y) = BarchLib::White;
+      break;
+    case 2:
+      for (std::size_t x = 0; x < width; ++x) {
+        bitmap.pixelAt(x, y) = static_cast<BarchLib::Pixel>(x * y);
+      }
+      break;
+    }
+  }
+  return bitmap;
+}
+
+} // namespace
+
+SCENARIO("rows can be decoded one by one", "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const std::size_t rowGroupSize : {0, 1, 7, 64}) {
+      AND_GIVEN("it was compressed with row group size " +
+                std::to_string(rowGroupSize)) {
+        BarchLib::CompressionOptions options;
+        options.rowGroupSize = rowGroupSize;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        REQUIRE(compressedBitmap.hasRowIndex() == (rowGroupSize != 0));
+        THEN("every decoded row is equal to the original one") {
+          std::array<BarchLib::Pixel, 37> pixels;
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            uncompressRow(compressedBitmap, y, pixels);
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+        }
+        THEN("a range of decoded rows is equal to the original rows") {
+          const BarchLib::Bitmap rows = uncompressRows(compressedBitmap, 20, 9);
+          REQUIRE(rows.height() == 9);
+          for (std::size_t y = 0; y < rows.height(); ++y) {
+            REQUIRE(std::equal(rows.rowAt(y).begin(), rows.rowAt(y).end(),
+                               bitmap.rowAt(20 + y).begin()));
+          }
+        }
+        THEN("the rows past the bottom of the bitmap cannot be decoded") {
+          REQUIRE_THROWS_AS(uncompressRows(compressedBitmap, 45, 6),
+                            BarchLib::InvalidCoordinate);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a CompressedBitmap can be saved and loaded", "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    WHEN("it is compressed without a row index, saved, and loaded") {
+      WordFile file;
+      save(file, compress(bitmap));
+      const BarchLib::CompressedBitmap loadedBitmap = BarchLib::load(file);
+      THEN("it is saved in the original format") {
+        REQUIRE(file.words[0] == 37);
+      }
+      THEN("it has no row index") { REQUIRE_FALSE(loadedBitmap.hasRowIndex()); }
+      THEN("it can be uncompressed") {
+        REQUIRE(uncompress(loadedBitmap) == bitmap);
+      }
+    }
+    WHEN("it is compressed with a row index, saved, and loaded") {
+      WordFile file;
+      save(file, compress(bitmap, BarchLib::CompressionOptions{5}));
+      BarchLib::CompressedBitmap loadedBitmap = BarchLib::load(file);
+      THEN("it starts with the format header") {
+        REQUIRE(file.words[0] == BarchLib::Internal::FormatMagic);
+      }
+      THEN("it has the row index") {
+        REQUIRE(loadedBitmap.rowGroupSize() == 5);
+      }
+      THEN("its row index is the same as the one built by scanning") {
+        WordFile rebuiltFile;
+        BarchLib::CompressedBitmap rebuiltBitmap = compress(bitmap);
+        rebuiltBitmap.buildRowIndex(5);
+        save(rebuiltFile, rebuiltBitmap);
+        REQUIRE(rebuiltFile.words == file.words);
+      }
+      THEN("it can be uncompressed") {
+        REQUIRE(uncompress(loadedBitmap) == bitmap);
+      }
+    }
+    WHEN("it is loaded from a file of a newer version") {
+      WordFile file;
+      save(file, compress(bitmap, BarchLib::CompressionOptions{5}));
+      file.words[1] = BarchLib::Internal::FormatVersion + 1;
+      THEN("it throws an InvalidFormat exception") {
+        REQUIRE_THROWS_AS(BarchLib::load(file), BarchLib::InvalidFormat);
+      }
+    }
+  }
+  GIVEN("a bitmap whose pixel data ends with lots of white blocks") {
+    // The last words of the pixel data are 0, so they are not saved. The
+    // index entries of the empty rows and tiles point past the saved words.
+    BarchLib::Bitmap bitmap{400, 20};
+    bitmap.pixelAt(0, 0) = BarchLib::Black;
+    WHEN("it is saved with a row index and loaded") {
+      WordFile file;
+      save(file, compress(bitmap, BarchLib::CompressionOptions{1}));
+      THEN("it can be uncompressed") {
+        REQUIRE(uncompress(BarchLib::load(file)) == bitmap);
+      }
+    }
+    WHEN("it is saved tiled and loaded") {
+      WordFile file;
+      BarchLib::CompressionOptions options;
+      options.tileSize = 16;
+      save(file, compress(bitmap, options));
+      THEN("it can be uncompressed") {
+        REQUIRE(uncompress(BarchLib::load(file)) == bitmap);
+      }
+    }
+  }
+  GIVEN("a bitmap with a row group that is larger than the bitmap") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    BarchLib::CompressionOptions options;
+    options.rowGroupSize = std::numeric_limits<std::size_t>::max();
+    const BarchLib::CompressedBitmap compressedBitmap =
+        compress(bitmap, options);
+    THEN("the row group is as large as the bitmap") {
+      REQUIRE(compressedBitmap.rowGroupSize() == 50);
+      REQUIRE(uncompress(compressedBitmap) == bitmap);
+      std::array<BarchLib::Pixel, 37> pixels;
+      uncompressRow(compressedBitmap, 49, pixels);
+      REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                         bitmap.rowAt(49).begin()));
+    }
+    THEN("the row index built by scanning is the same") {
+      BarchLib::CompressedBitmap rebuiltBitmap = compress(bitmap);
+      rebuiltBitmap.buildRowIndex(options.rowGroupSize);
+      WordFile expectedFile;
+      save(expectedFile, compressedBitmap);
+      WordFile file;
+      save(file, rebuiltBitmap);
+      REQUIRE(file.words == expectedFile.words);
+    }
+    THEN("the streaming encoder makes the same file") {
+      WordFile expectedFile;
+      save(expectedFile, compressedBitmap);
+      WordFile file;
+      BarchLib::StreamingEncoder encoder{37, 50, options};
+      encoder.start(file);
+      for (std::size_t y = 0; y < 50; ++y) {
+        encoder.push(bitmap.rowAt(y), file);
+      }
+      encoder.finish(file);
+      REQUIRE(file.words == expectedFile.words);
+    }
+    WHEN("the row group size in the file is corrupted") {
+      WordFile file;
+      save(file, compressedBitmap);
+      // The row group size is followed by the only entry of the row index.
+      const std::size_t rowGroupSizeIndex = file.words.size() - 2;
+      REQUIRE(file.words[rowGroupSizeIndex] == 50);
+      file.words[rowGroupSizeIndex] = std::numeric_limits<std::size_t>::max();
+      THEN("loading it throws an InvalidFormat exception") {
+        REQUIRE_THROWS_AS(BarchLib::load(file), BarchLib::InvalidFormat);
+        REQUIRE_THROWS_AS(BarchLib::CompressedBitmapView{file.words},
+                          BarchLib::InvalidFormat);
+      }
+      THEN("decoding it row by row throws an InvalidFormat exception") {
+        BarchLib::StreamingDecoder decoder{file};
+        std::array<BarchLib::Pixel, 37> pixels;
+        REQUIRE_THROWS_AS(
+            [&] {
+              while (decoder.pull(pixels)) {}
+            }(),
+            BarchLib::InvalidFormat);
+      }
+    }
+  }
+}
+
+SCENARIO("the info of a saved CompressedBitmap can be loaded without its "
+         "pixels",
+         "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    WHEN("it is saved in the original format and its info is loaded") {
+      WordFile file;
+      save(file, compress(bitmap));
+      const BarchLib::CompressedBitmapInfo info = BarchLib::loadInfo(file);
+      THEN("it has the size of the bitmap") {
+        REQUIRE(info.width == 37);
+        REQUIRE(info.height == 50);
+        REQUIRE(info.tileSize == 0);
+      }
+      THEN("every third row is empty") {
+        REQUIRE(info.nonEmptyRowCount == 33);
+      }
+      THEN("the pixel data is all that's left to read") {
+        REQUIRE(file.readIndex + info.payloadSize / sizeof(std::size_t) ==
+                file.words.size());
+      }
+    }
+    WHEN("it is saved with a row index and its info is loaded") {
+      WordFile file;
+      save(file, compress(bitmap, BarchLib::CompressionOptions{5}));
+      const BarchLib::CompressedBitmapInfo info = BarchLib::loadInfo(file);
+      THEN("it's the same as without the row index") {
+        WordFile originalFile;
+        save(originalFile, compress(bitmap));
+        const BarchLib::CompressedBitmapInfo originalInfo =
+            BarchLib::loadInfo(originalFile);
+        REQUIRE(info.width == originalInfo.width);
+        REQUIRE(info.height == originalInfo.height);
+        REQUIRE(info.nonEmptyRowCount == originalInfo.nonEmptyRowCount);
+        REQUIRE(info.payloadSize == originalInfo.payloadSize);
+      }
+    }
+    WHEN("it is saved tiled and its info is loaded") {
+      WordFile file;
+      BarchLib::CompressionOptions options;
+      options.tileSize = 16;
+      save(file, compress(bitmap, options));
+      const BarchLib::CompressedBitmapInfo info = BarchLib::loadInfo(file);
+      THEN("it has the tile size") { REQUIRE(info.tileSize == 16); }
+      THEN("it counts the tiles that are not empty") {
+        REQUIRE(info.nonEmptyRowCount == 12);
+      }
+    }
+    WHEN("its info is loaded from a file of a newer version") {
+      WordFile file;
+      save(file, compress(bitmap, BarchLib::CompressionOptions{5}));
+      file.words[1] = BarchLib::Internal::FormatVersion + 1;
+      THEN("it throws an InvalidFormat exception") {
+        REQUIRE_THROWS_AS(BarchLib::loadInfo(file), BarchLib::InvalidFormat);
+      }
+    }
+  }
+}
+
+SCENARIO("a Bitmap can be compressed by several threads",
+         "[Bitmap][CompressedBitmap]") {
+  GIVEN("a 37x500 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 500);
+    for (const std::size_t rowGroupSize : {0, 1, 7, 64}) {
+      WHEN("it is compressed by 3 threads with row group size " +
+           std::to_string(rowGroupSize)) {
+        BarchLib::CompressionOptions options;
+        options.rowGroupSize = rowGroupSize;
+        WordFile serialFile;
+        save(serialFile, compress(bitmap, options));
+        options.threadCount = 3;
+        std::size_t lastStep = 0;
+        WordFile parallelFile;
+        save(parallelFile,
+             compress(bitmap, options,
+                      [&lastStep](const std::size_t currentStep,
+                                  const std::size_t /* totalSteps */) {
+                        REQUIRE(currentStep >= lastStep);
+                        lastStep = currentStep;
+                      }));
+        THEN("the result is the same as if it was compressed by one thread") {
+          REQUIRE(parallelFile.words == serialFile.words);
+        }
+        THEN("the progress reaches the end") { REQUIRE(lastStep == 500); }
+      }
+    }
+  }
+}
+
+SCENARIO("the progress of a large Bitmap is reported a few times",
+         "[Bitmap][CompressedBitmap]") {
+  GIVEN("a 37x5000 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 5000);
+    for (const std::size_t threadCount : {1, 3}) {
+      WHEN("it is compressed and uncompressed by " +
+           std::to_string(threadCount) + " threads") {
+        std::vector<std::size_t> steps;
+        const auto progress = [&steps](const std::size_t currentStep,
+                                       const std::size_t /* totalSteps */) {
+          steps.push_back(currentStep);
+        };
+        BarchLib::CompressionOptions compressionOptions;
+        compressionOptions.threadCount = threadCount;
+        compressionOptions.progressInterval = std::chrono::hours{1};
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, compressionOptions, progress);
+        BarchLib::DecompressionOptions decompressionOptions;
+        decompressionOptions.threadCount = threadCount;
+        decompressionOptions.progressInterval = std::chrono::hours{1};
+        REQUIRE(uncompress(compressedBitmap, decompressionOptions, progress) ==
+                bitmap);
+        THEN("only the start and the end of each are reported") {
+          REQUIRE(steps == std::vector<std::size_t>{0, 5000, 0, 5000});
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("compressing and uncompressing can be cancelled",
+         "[Bitmap][CompressedBitmap]") {
+  GIVEN("a 37x5000 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 5000);
+    const BarchLib::CompressedBitmap compressedBitmap = compress(bitmap);
+    BarchLib::CancellationToken cancellation;
+    for (const std::size_t threadCount : {1, 3}) {
+      WHEN("it is cancelled before the job starts on " +
+           std::to_string(threadCount) + " threads") {
+        cancellation.cancel();
+        BarchLib::CompressionOptions compressionOptions;
+        compressionOptions.threadCount = threadCount;
+        compressionOptions.cancellation = &cancellation;
+        BarchLib::DecompressionOptions decompressionOptions;
+        decompressionOptions.threadCount = threadCount;
+        decompressionOptions.cancellation = &cancellation;
+        THEN("both throw Cancelled") {
+          REQUIRE_THROWS_AS(compress(bitmap, compressionOptions),
+                            BarchLib::Cancelled);
+          REQUIRE_THROWS_AS(uncompress(compressedBitmap, decompressionOptions),
+                            BarchLib::Cancelled);
+        }
+      }
+      WHEN("it is cancelled half way through on " +
+           std::to_string(threadCount) + " threads") {
+        std::size_t lastStep = 0;
+        const auto progress = [&](const std::size_t currentStep,
+                                  const std::size_t totalSteps) {
+          lastStep = currentStep;
+          if (currentStep >= totalSteps / 2) { cancellation.cancel(); }
+        };
+        BarchLib::CompressionOptions compressionOptions;
+        compressionOptions.threadCount = threadCount;
+        compressionOptions.progressInterval = std::chrono::milliseconds{0};
+        compressionOptions.cancellation = &cancellation;
+        THEN("compress() throws Cancelled before it's done") {
+          REQUIRE_THROWS_AS(compress(bitmap, compressionOptions, progress),
+                            BarchLib::Cancelled);
+          REQUIRE(lastStep < 5000);
+        }
+        BarchLib::DecompressionOptions decompressionOptions;
+        decompressionOptions.threadCount = threadCount;
+        decompressionOptions.progressInterval = std::chrono::milliseconds{0};
+        decompressionOptions.cancellation = &cancellation;
+        THEN("uncompress() throws Cancelled before it's done") {
+          REQUIRE_THROWS_AS(
+              uncompress(compressedBitmap, decompressionOptions, progress),
+              BarchLib::Cancelled);
+          REQUIRE(lastStep < 5000);
+        }
+      }
+      WHEN("the token is reset") {
+        cancellation.cancel();
+        cancellation.reset();
+        BarchLib::CompressionOptions options;
+        options.cancellation = &cancellation;
+        THEN("it can be used again") {
+          REQUIRE(uncompress(compress(bitmap, options)) == bitmap);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a CompressedBitmap can be uncompressed by several threads",
+         "[CompressedBitmap][Bitmap]") {
+  GIVEN("a 37x500 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 500);
+    for (const std::size_t rowGroupSize : {0, 1, 7}) {
+      AND_GIVEN("it was compressed with row group size " +
+                std::to_string(rowGroupSize)) {
+        BarchLib::CompressionOptions options;
+        options.rowGroupSize = rowGroupSize;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        WHEN("it is uncompressed by 3 threads") {
+          BarchLib::DecompressionOptions decompressionOptions;
+          decompressionOptions.threadCount = 3;
+          const BarchLib::Bitmap uncompressedBitmap =
+              uncompress(compressedBitmap, decompressionOptions);
+          THEN("the uncompressed image is equal to the original") {
+            REQUIRE(uncompressedBitmap == bitmap);
+          }
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("the compressed size of a Bitmap is known up front",
+         "[Bitmap][CompressedBitmap]") {
+  GIVEN("a 4x3 bitmap:"
+        "\n 00 00 00 00"
+        "\n FF FF FF FF"
+        "\n DE AD BE EF") {
+    BarchLib::Bitmap bitmap{4, 3};
+    fill(bitmap.rowAt(0), BarchLib::Black);
+    bitmap.pixelAt(0, 2) = 0xDEU;
+    bitmap.pixelAt(1, 2) = 0xADU;
+    bitmap.pixelAt(2, 2) = 0xBEU;
+    bitmap.pixelAt(3, 2) = 0xEFU;
+    THEN("its compressed size is 2 + 34 bits") {
+      REQUIRE(BarchLib::compressedSizeOf(bitmap) == 36);
+    }
+  }
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    THEN("its compressed size is the number of bits the encoder writes") {
+      BarchLib::Internal::BitSet encodedPixels;
+      BarchLib::Internal::Encoder encoder{encodedPixels};
+      for (std::size_t y = 0; y < bitmap.height(); ++y) {
+        if (!BarchLib::Internal::isEmpty(bitmap.rowAt(y))) {
+          encoder.encode(bitmap.rowAt(y));
+        }
+      }
+      REQUIRE(BarchLib::compressedSizeOf(bitmap) == encoder.bitIndex());
+    }
+  }
+}
+
+SCENARIO("a Bitmap can be compressed in blocks wider than 4 pixels",
+         "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const BarchLib::BlockWidth blockWidth :
+         {BarchLib::BlockWidth::Eight, BarchLib::BlockWidth::Sixteen}) {
+      const auto width = static_cast<std::size_t>(blockWidth);
+      for (const auto &[rowGroupSize, tileSize] :
+           {std::pair<std::size_t, std::size_t>{0, 0}, {7, 0}, {0, 16}}) {
+        AND_GIVEN("it was compressed in blocks of " + std::to_string(width) +
+                  " pixels with row group size " +
+                  std::to_string(rowGroupSize) + " and tile size " +
+                  std::to_string(tileSize)) {
+          BarchLib::CompressionOptions options;
+          options.rowGroupSize = rowGroupSize;
+          options.tileSize = tileSize;
+          options.blockWidth = blockWidth;
+          const BarchLib::CompressedBitmap compressedBitmap =
+              compress(bitmap, options);
+          REQUIRE(compressedBitmap.blockWidth() == width);
+          THEN("it can be uncompressed") {
+            REQUIRE(uncompress(compressedBitmap) == bitmap);
+            REQUIRE(uncompress(compressedBitmap,
+                               BarchLib::DecompressionOptions{4}) == bitmap);
+          }
+          THEN("every row can be decoded") {
+            std::array<BarchLib::Pixel, 37> pixels;
+            for (std::size_t y = 0; y < bitmap.height(); ++y) {
+              uncompressRow(compressedBitmap, y, pixels);
+              REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                                 bitmap.rowAt(y).begin()));
+            }
+          }
+          THEN("a region can be decoded") {
+            const BarchLib::Bitmap region =
+                uncompressRegion(compressedBitmap, 3, 20, 30, 25);
+            for (std::size_t y = 0; y < region.height(); ++y) {
+              REQUIRE(std::equal(region.rowAt(y).begin(),
+                                 region.rowAt(y).end(),
+                                 bitmap.rowAt(20 + y).begin() + 3));
+            }
+          }
+          WHEN("it is saved") {
+            WordFile file;
+            save(file, compressedBitmap);
+            THEN("the file records the block width") {
+              REQUIRE(file.words[0] == BarchLib::Internal::FormatMagic);
+              REQUIRE(BarchLib::load(file).blockWidth() == width);
+              file.readIndex = 0;
+              REQUIRE(BarchLib::loadInfo(file).blockWidth == width);
+            }
+            THEN("it can be loaded and uncompressed") {
+              REQUIRE(uncompress(BarchLib::load(file)) == bitmap);
+              REQUIRE(uncompress(BarchLib::CompressedBitmapView{file.words}) ==
+                      bitmap);
+            }
+          }
+        }
+      }
+      WHEN("it is compressed row by row in blocks of " +
+           std::to_string(width) + " pixels") {
+        BarchLib::CompressionOptions options;
+        options.blockWidth = blockWidth;
+        WordFile expectedFile;
+        save(expectedFile, compress(bitmap, options));
+        WordFile file;
+        BarchLib::StreamingEncoder encoder{37, 50, options};
+        encoder.start(file);
+        for (std::size_t y = 0; y < 50; ++y) {
+          encoder.push(bitmap.rowAt(y), file);
+        }
+        encoder.finish(file);
+        THEN("the file is the same as if the bitmap was compressed and saved") {
+          REQUIRE(file.words == expectedFile.words);
+        }
+        THEN("its rows can be pulled from the file") {
+          BarchLib::StreamingDecoder decoder{file};
+          std::array<BarchLib::Pixel, 37> pixels;
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            REQUIRE(decoder.pull(pixels));
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+        }
+      }
+    }
+    WHEN("it is compressed in blocks of 4 pixels") {
+      WordFile file;
+      BarchLib::CompressionOptions options;
+      options.blockWidth = BarchLib::BlockWidth::Four;
+      save(file, compress(bitmap, options));
+      THEN("it is saved in the original format") {
+        REQUIRE(file.words[0] == 37);
+      }
+    }
+    WHEN("it is compressed with the block width picked automatically") {
+      THEN("the block width takes the fewest bits") {
+        REQUIRE(BarchLib::compressedSizeOf(bitmap,
+                                           BarchLib::BlockWidth::Auto) ==
+                std::min({BarchLib::compressedSizeOf(
+                              bitmap, BarchLib::BlockWidth::Four),
+                          BarchLib::compressedSizeOf(
+                              bitmap, BarchLib::BlockWidth::Eight),
+                          BarchLib::compressedSizeOf(
+                              bitmap, BarchLib::BlockWidth::Sixteen)}));
+      }
+    }
+    WHEN("a file with an unknown block width is loaded") {
+      WordFile file;
+      BarchLib::CompressionOptions options;
+      options.blockWidth = BarchLib::BlockWidth::Eight;
+      save(file, compress(bitmap, options));
+      // The block width follows the magic, the version, the features, and the
+      // size.
+      REQUIRE(file.words[5] == 8);
+      file.words[5] = 5;
+      THEN("it throws an InvalidFormat exception") {
+        REQUIRE_THROWS_AS(BarchLib::load(file), BarchLib::InvalidFormat);
+      }
+    }
+  }
+  GIVEN("a bitmap with long white and black runs") {
+    BarchLib::Bitmap bitmap{400, 40};
+    for (std::size_t y = 0; y < bitmap.height(); ++y) {
+      fill(bitmap.rowAt(y).first(192), BarchLib::Black);
+    }
+    THEN("the block width that is picked automatically is 16") {
+      BarchLib::CompressionOptions options;
+      options.blockWidth = BarchLib::BlockWidth::Auto;
+      REQUIRE(compress(bitmap, options).blockWidth() == 16);
+    }
+  }
+  GIVEN("a bitmap whose blocks of 4 pixels are black and white in turns") {
+    BarchLib::Bitmap bitmap{400, 40};
+    for (std::size_t y = 0; y < bitmap.height(); ++y) {
+      for (std::size_t x = 0; x < bitmap.width(); x += 8) {
+        fill(bitmap.rowAt(y).subspan(x, 4), BarchLib::Black);
+      }
+    }
+    THEN("the block width that is picked automatically is 4") {
+      BarchLib::CompressionOptions options;
+      options.blockWidth = BarchLib::BlockWidth::Auto;
+      REQUIRE(compress(bitmap, options).blockWidth() == 4);
+    }
+  }
+}
+
+SCENARIO("a Bitmap can be compressed with run codes", "[CompressedBitmap]") {
+  GIVEN("a 700x60 page with wide margins and a few lines of text") {
+    BarchLib::Bitmap bitmap{700, 60};
+    for (std::size_t y = 20; y < 40; y += 2) {
+      for (std::size_t x = 100; x < 600; x += 3) {
+        bitmap.pixelAt(x, y) = static_cast<BarchLib::Pixel>(x);
+      }
+      fill(bitmap.rowAt(y + 1).subspan(100, 500), BarchLib::Black);
+    }
+    for (const BarchLib::BlockWidth blockWidth :
+         {BarchLib::BlockWidth::Four, BarchLib::BlockWidth::Sixteen}) {
+      const auto width = static_cast<std::size_t>(blockWidth);
+      for (const auto &[rowGroupSize, tileSize] :
+           {std::pair<std::size_t, std::size_t>{0, 0}, {7, 0}, {0, 128}}) {
+        AND_GIVEN("it was compressed with run codes in blocks of " +
+                  std::to_string(width) + " pixels with row group size " +
+                  std::to_string(rowGroupSize) + " and tile size " +
+                  std::to_string(tileSize)) {
+          BarchLib::CompressionOptions options;
+          options.rowGroupSize = rowGroupSize;
+          options.tileSize = tileSize;
+          options.blockWidth = blockWidth;
+          options.runLengthCodes = true;
+          const BarchLib::CompressedBitmap compressedBitmap =
+              compress(bitmap, options);
+          REQUIRE(compressedBitmap.hasRunCodes());
+          THEN("it can be uncompressed") {
+            REQUIRE(uncompress(compressedBitmap) == bitmap);
+            REQUIRE(uncompress(compressedBitmap,
+                               BarchLib::DecompressionOptions{4}) == bitmap);
+          }
+          THEN("every row can be decoded") {
+            std::vector<BarchLib::Pixel> pixels(bitmap.width());
+            for (std::size_t y = 0; y < bitmap.height(); ++y) {
+              uncompressRow(compressedBitmap, y, pixels);
+              REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                                 bitmap.rowAt(y).begin()));
+            }
+          }
+          THEN("a region can be decoded") {
+            const BarchLib::Bitmap region =
+                uncompressRegion(compressedBitmap, 50, 15, 300, 30);
+            for (std::size_t y = 0; y < region.height(); ++y) {
+              REQUIRE(std::equal(region.rowAt(y).begin(),
+                                 region.rowAt(y).end(),
+                                 bitmap.rowAt(15 + y).begin() + 50));
+            }
+          }
+          WHEN("it is saved") {
+            WordFile file;
+            save(file, compressedBitmap);
+            THEN("the file records the run codes") {
+              REQUIRE(file.words[0] == BarchLib::Internal::FormatMagic);
+              REQUIRE(file.words[2] & BarchLib::Internal::RunLengthFeature);
+              REQUIRE(BarchLib::load(file).hasRunCodes());
+              file.readIndex = 0;
+              REQUIRE(BarchLib::loadInfo(file).hasRunCodes);
+            }
+            THEN("it can be loaded and uncompressed") {
+              REQUIRE(uncompress(BarchLib::load(file)) == bitmap);
+              REQUIRE(uncompress(BarchLib::CompressedBitmapView{file.words}) ==
+                      bitmap);
+            }
+          }
+        }
+      }
+    }
+    WHEN("it is compressed row by row with run codes") {
+      BarchLib::CompressionOptions options;
+      options.runLengthCodes = true;
+      WordFile expectedFile;
+      save(expectedFile, compress(bitmap, options));
+      WordFile file;
+      BarchLib::StreamingEncoder encoder{700, 60, options};
+      encoder.start(file);
+      for (std::size_t y = 0; y < 60; ++y) {
+        encoder.push(bitmap.rowAt(y), file);
+      }
+      encoder.finish(file);
+      THEN("the file is the same as if the bitmap was compressed and saved") {
+        REQUIRE(file.words == expectedFile.words);
+      }
+      THEN("its rows can be pulled from the file") {
+        BarchLib::StreamingDecoder decoder{file};
+        std::vector<BarchLib::Pixel> pixels(bitmap.width());
+        for (std::size_t y = 0; y < bitmap.height(); ++y) {
+          REQUIRE(decoder.pull(pixels));
+          REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                             bitmap.rowAt(y).begin()));
+        }
+      }
+    }
+    THEN("the run codes take fewer bits") {
+      REQUIRE(BarchLib::compressedSizeOf(bitmap, BarchLib::BlockWidth::Four,
+                                         true) <
+              BarchLib::compressedSizeOf(bitmap, BarchLib::BlockWidth::Four));
+    }
+    WHEN("it is compressed without run codes") {
+      const BarchLib::CompressedBitmap compressedBitmap = compress(bitmap);
+      WordFile file;
+      save(file, compressedBitmap);
+      THEN("it is saved in the original format") {
+        REQUIRE_FALSE(compressedBitmap.hasRunCodes());
+        REQUIRE(file.words[0] == 700);
+      }
+    }
+    WHEN("it is compressed and uncompressed with statistics") {
+      BarchLib::CodecStatistics compressionStatistics;
+      BarchLib::CompressionOptions compressionOptions;
+      compressionOptions.runLengthCodes = true;
+      compressionOptions.statistics = &compressionStatistics;
+      const BarchLib::CompressedBitmap compressedBitmap =
+          compress(bitmap, compressionOptions);
+      BarchLib::CodecStatistics decompressionStatistics;
+      BarchLib::DecompressionOptions decompressionOptions;
+      decompressionOptions.statistics = &decompressionStatistics;
+      REQUIRE(uncompress(compressedBitmap, decompressionOptions) == bitmap);
+      if constexpr (BarchLib::StatisticsAreEnabled) {
+        THEN("the runs are counted") {
+          for (const BarchLib::CodecStatistics &statistics :
+               {compressionStatistics, decompressionStatistics}) {
+            // Every line has two margins, and the black lines have a black
+            // run in between.
+            REQUIRE(statistics.runCount == 10 * 2 + 10 * 3);
+            REQUIRE(statistics.bitCount ==
+                    compressedSizeOf(bitmap, BarchLib::BlockWidth::Four,
+                                     true));
+          }
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a Bitmap can be compressed row by row", "[StreamingEncoder]") {
+  GIVEN("a 37x500 bitmap with stripes and more empty rows at the bottom") {
+    BarchLib::Bitmap bitmap = makeStripedBitmap(37, 500);
+    for (std::size_t y = 400; y < 500; ++y) {
+      fill(bitmap.rowAt(y), BarchLib::White);
+    }
+    for (const std::size_t rowGroupSize : {0, 7}) {
+      BarchLib::CompressionOptions options;
+      options.rowGroupSize = rowGroupSize;
+      WordFile expectedFile;
+      save(expectedFile, compress(bitmap, options));
+      WHEN("its rows are pushed in chunks of 3 with row group size " +
+           std::to_string(rowGroupSize)) {
+        BarchLib::StreamingEncoder encoder{37, 500, options};
+        for (std::size_t y = 0; y < 500; y += 3) {
+          const std::size_t rowCount = std::min<std::size_t>(3, 500 - y);
+          encoder.push(BarchLib::ImmutablePixels{bitmap.rowAt(y).data(),
+                                                 rowCount * 37});
+        }
+        THEN("the result is the same as if the bitmap was compressed") {
+          WordFile file;
+          save(file, encoder.finish());
+          REQUIRE(file.words == expectedFile.words);
+        }
+      }
+      WHEN("its rows are pushed one by one and streamed to a file with row "
+           "group size " +
+           std::to_string(rowGroupSize)) {
+        WordFile file;
+        BarchLib::StreamingEncoder encoder{37, 500, options};
+        encoder.start(file);
+        for (std::size_t y = 0; y < 500; ++y) {
+          encoder.push(bitmap.rowAt(y), file);
+        }
+        encoder.finish(file);
+        THEN("the file is the same as if the bitmap was compressed and saved") {
+          REQUIRE(file.words == expectedFile.words);
+        }
+      }
+    }
+  }
+  GIVEN("a streaming encoder of a 4x3 bitmap") {
+    BarchLib::StreamingEncoder encoder{4, 3};
+    WHEN("only 2 rows are pushed") {
+      encoder.push(std::array<BarchLib::Pixel, 8>{});
+      THEN("it cannot finish") {
+        REQUIRE_THROWS_AS(encoder.finish(), BarchLib::InvalidCoordinate);
+      }
+      THEN("it doesn't accept 2 more rows") {
+        REQUIRE_THROWS_AS(encoder.push(std::array<BarchLib::Pixel, 8>{}),
+                          BarchLib::InvalidCoordinate);
+      }
+    }
+  }
+}
+
+SCENARIO("a CompressedBitmap can be uncompressed row by row",
+         "[StreamingDecoder]") {
+  GIVEN("a 37x500 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 500);
+    for (const std::size_t rowGroupSize : {0, 7}) {
+      BarchLib::CompressionOptions options;
+      options.rowGroupSize = rowGroupSize;
+      const BarchLib::CompressedBitmap compressedBitmap =
+          compress(bitmap, options);
+      std::array<BarchLib::Pixel, 37> pixels;
+      WHEN("its rows are pulled from memory with row group size " +
+           std::to_string(rowGroupSize)) {
+        BarchLib::StreamingDecoder decoder{compressedBitmap};
+        THEN("every row is equal to the original one") {
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            REQUIRE(decoder.pull(pixels));
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+          REQUIRE(decoder.rowCount() == bitmap.height());
+          REQUIRE_FALSE(decoder.pull(pixels));
+        }
+      }
+      WHEN("its rows are pulled from a file with row group size " +
+           std::to_string(rowGroupSize)) {
+        WordFile file;
+        save(file, compressedBitmap);
+        write(file, std::size_t{42});
+        BarchLib::StreamingDecoder decoder{file};
+        THEN("the pixel data is read as the rows are pulled") {
+          REQUIRE(decoder.pull(pixels));
+          REQUIRE(file.readIndex < file.words.size() / 2);
+        }
+        THEN("every row is equal to the original one") {
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            REQUIRE(decoder.pull(pixels));
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+          REQUIRE_FALSE(decoder.pull(pixels));
+          AND_THEN("the file is read up to the end of the bitmap") {
+            REQUIRE(file.readIndex == file.words.size() - 1);
+          }
+        }
+      }
+    }
+  }
+  GIVEN("a streaming decoder of a 4x3 bitmap") {
+    const BarchLib::CompressedBitmap compressedBitmap =
+        compress(BarchLib::Bitmap{4, 3});
+    BarchLib::StreamingDecoder decoder{compressedBitmap};
+    THEN("it doesn't accept a row of a different width") {
+      std::array<BarchLib::Pixel, 5> pixels;
+      REQUIRE_THROWS_AS(decoder.pull(pixels), BarchLib::InvalidSize);
+    }
+  }
+}
+
+SCENARIO("a saved CompressedBitmap can be decoded without loading it",
+         "[CompressedBitmapView]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const std::size_t rowGroupSize : {0, 7}) {
+      AND_GIVEN("it was saved with row group size " +
+                std::to_string(rowGroupSize)) {
+        WordFile file;
+        save(file,
+             compress(bitmap, BarchLib::CompressionOptions{rowGroupSize}));
+        const BarchLib::CompressedBitmapView view{file.words};
+        THEN("the view knows the size and the row index of the bitmap") {
+          REQUIRE(view.width() == 37);
+          REQUIRE(view.height() == 50);
+          REQUIRE(view.rowGroupSize() == rowGroupSize);
+          REQUIRE(view.isEmptyRowAt(0));
+          REQUIRE_FALSE(view.isEmptyRowAt(1));
+        }
+        THEN("the view can be uncompressed") {
+          REQUIRE(uncompress(view) == bitmap);
+          REQUIRE(uncompress(view, BarchLib::DecompressionOptions{4}) ==
+                  bitmap);
+        }
+        THEN("every row of the view can be decoded") {
+          std::array<BarchLib::Pixel, 37> pixels;
+          BarchLib::StreamingDecoder decoder{view};
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            uncompressRow(view, y, pixels);
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+            REQUIRE(decoder.pull(pixels));
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+        }
+        THEN("the view cannot refer to fewer words than were saved") {
+          const std::span<std::size_t const> words{file.words};
+          REQUIRE_THROWS_AS(
+              BarchLib::CompressedBitmapView{words.first(words.size() - 1)},
+              BarchLib::InvalidFormat);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a Bitmap can be compressed tile by tile", "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes and a white right half") {
+    BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (std::size_t y = 0; y < bitmap.height(); ++y) {
+      fill(bitmap.rowAt(y).subspan(20), BarchLib::White);
+    }
+    for (const std::size_t threadCount : {1, 4}) {
+      WHEN("it is compressed into 8x8 tiles on " +
+           std::to_string(threadCount) + " threads") {
+        BarchLib::CompressionOptions options;
+        options.tileSize = 8;
+        options.threadCount = threadCount;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        THEN("it is tiled") {
+          REQUIRE(compressedBitmap.isTiled());
+          REQUIRE(compressedBitmap.tileSize() == 8);
+          REQUIRE_FALSE(compressedBitmap.hasRowIndex());
+        }
+        THEN("it can be uncompressed") {
+          REQUIRE(uncompress(compressedBitmap) == bitmap);
+          REQUIRE(uncompress(compressedBitmap,
+                             BarchLib::DecompressionOptions{4}) == bitmap);
+        }
+        THEN("its rows can be decoded one by one") {
+          std::array<BarchLib::Pixel, 37> pixels;
+          BarchLib::StreamingDecoder decoder{compressedBitmap};
+          for (std::size_t y = 0; y < bitmap.height(); ++y) {
+            REQUIRE(compressedBitmap.isEmptyRowAt(y) == (y % 3 == 0));
+            uncompressRow(compressedBitmap, y, pixels);
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+            REQUIRE(decoder.pull(pixels));
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               bitmap.rowAt(y).begin()));
+          }
+        }
+        THEN("it is the same once saved and loaded") {
+          WordFile file;
+          save(file, compressedBitmap);
+          REQUIRE(uncompress(BarchLib::load(file)) == bitmap);
+          REQUIRE(uncompress(BarchLib::CompressedBitmapView{file.words}) ==
+                  bitmap);
+          file.readIndex = 0;
+          REQUIRE_THROWS_AS(BarchLib::StreamingDecoder{file},
+                            BarchLib::InvalidFormat);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a region of a CompressedBitmap can be decoded",
+         "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const std::size_t tileSize : {0, 1, 8, 64}) {
+      AND_GIVEN("it was compressed with tile size " +
+                std::to_string(tileSize)) {
+        BarchLib::CompressionOptions options;
+        options.tileSize = tileSize;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        THEN("every decoded region is equal to the original one") {
+          for (const auto [x, y, width, height] :
+               {std::array<std::size_t, 4>{0, 0, 37, 50},
+                std::array<std::size_t, 4>{5, 7, 13, 11},
+                std::array<std::size_t, 4>{36, 49, 1, 1},
+                std::array<std::size_t, 4>{8, 16, 8, 8}}) {
+            const BarchLib::Bitmap region =
+                uncompressRegion(compressedBitmap, x, y, width, height);
+            REQUIRE(region.width() == width);
+            REQUIRE(region.height() == height);
+            for (std::size_t regionY = 0; regionY < height; ++regionY) {
+              REQUIRE(std::equal(region.rowAt(regionY).begin(),
+                                 region.rowAt(regionY).end(),
+                                 bitmap.rowAt(y + regionY).begin() + x));
+            }
+          }
+        }
+        THEN("the regions that are not inside the bitmap cannot be decoded") {
+          REQUIRE_THROWS_AS(uncompressRegion(compressedBitmap, 30, 0, 8, 1),
+                            BarchLib::InvalidCoordinate);
+          REQUIRE_THROWS_AS(uncompressRegion(compressedBitmap, 0, 50, 1, 1),
+                            BarchLib::InvalidCoordinate);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a preview of a CompressedBitmap can be decoded",
+         "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const auto [rowGroupSize, tileSize] :
+         {std::array<std::size_t, 2>{0, 0}, std::array<std::size_t, 2>{1, 0},
+          std::array<std::size_t, 2>{7, 0}, std::array<std::size_t, 2>{0, 8},
+          std::array<std::size_t, 2>{0, 16}}) {
+      AND_GIVEN("it was compressed with row group size " +
+                std::to_string(rowGroupSize) + " and tile size " +
+                std::to_string(tileSize)) {
+        BarchLib::CompressionOptions options;
+        options.rowGroupSize = rowGroupSize;
+        options.tileSize = tileSize;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        THEN("a preview at scale 1 is the bitmap itself") {
+          REQUIRE(uncompressPreview(compressedBitmap, 1) == bitmap);
+        }
+        THEN("every pixel of a smaller preview is the darkest of its row") {
+          for (const std::size_t scale : {2, 3, 8, 40}) {
+            const BarchLib::Bitmap preview =
+                uncompressPreview(compressedBitmap, scale);
+            REQUIRE(preview.width() == (37 + scale - 1) / scale);
+            REQUIRE(preview.height() == (50 + scale - 1) / scale);
+            for (std::size_t y = 0; y < preview.height(); ++y) {
+              for (std::size_t x = 0; x < preview.width(); ++x) {
+                const auto row = bitmap.rowAt(y * scale);
+                const auto first = row.begin() + x * scale;
+                const auto last =
+                    row.begin() + std::min<std::size_t>(37, (x + 1) * scale);
+                REQUIRE(preview.pixelAt(x, y) ==
+                        *std::min_element(first, last));
+              }
+            }
+          }
+        }
+        THEN("a preview at scale 0 throws an InvalidSize exception") {
+          REQUIRE_THROWS_AS(uncompressPreview(compressedBitmap, 0),
+                            BarchLib::InvalidSize);
+        }
+        THEN("a preview at the largest scale is a single pixel") {
+          const BarchLib::Bitmap preview = uncompressPreview(
+              compressedBitmap, std::numeric_limits<std::size_t>::max());
+          REQUIRE(preview.width() == 1);
+          REQUIRE(preview.height() == 1);
+          REQUIRE(preview.pixelAt(0, 0) ==
+                  *std::min_element(bitmap.rowAt(0).begin(),
+                                    bitmap.rowAt(0).end()));
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("a CompressedBitmap can be uncompressed into any PixelSink",
+         "[CompressedBitmap]") {
+  GIVEN("a 37x50 bitmap with stripes") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    for (const std::size_t tileSize : {0, 8}) {
+      AND_GIVEN("it was compressed with tile size " +
+                std::to_string(tileSize)) {
+        BarchLib::CompressionOptions options;
+        options.tileSize = tileSize;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, options);
+        WHEN("it is uncompressed into a strided black buffer") {
+          std::vector<BarchLib::Pixel> buffer(40 * 50, BarchLib::Black);
+          BarchLib::StridedPixels pixels{buffer.data(), 37, 40};
+          uncompressInto(compressedBitmap, pixels,
+                         BarchLib::DecompressionOptions{4});
+          THEN("every row is equal to the original one") {
+            for (std::size_t y = 0; y < bitmap.height(); ++y) {
+              REQUIRE(std::equal(bitmap.rowAt(y).begin(),
+                                 bitmap.rowAt(y).end(),
+                                 buffer.begin() + y * 40));
+            }
+          }
+          THEN("the padding at the end of every row is left alone") {
+            for (std::size_t y = 0; y < bitmap.height(); ++y) {
+              REQUIRE(buffer[y * 40 + 39] == BarchLib::Black);
+            }
+          }
+        }
+        WHEN("it is uncompressed into rows of a different width") {
+          std::vector<BarchLib::Pixel> buffer(40 * 50);
+          BarchLib::StridedPixels pixels{buffer.data(), 40, 40};
+          THEN("it throws an InvalidSize exception") {
+            REQUIRE_THROWS_AS(uncompressInto(compressedBitmap, pixels),
+                              BarchLib::InvalidSize);
+          }
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("pixels can be compressed without copying them into a Bitmap",
+         "[BitmapView]") {
+  GIVEN("a 37x50 bitmap with stripes in a buffer with padded rows") {
+    const BarchLib::Bitmap bitmap = makeStripedBitmap(37, 50);
+    std::vector<BarchLib::Pixel> buffer(40 * 50, BarchLib::Black);
+    for (std::size_t y = 0; y < bitmap.height(); ++y) {
+      std::copy(bitmap.rowAt(y).begin(), bitmap.rowAt(y).end(),
+                buffer.begin() + y * 40);
+    }
+    const BarchLib::BitmapView view{buffer.data(), 37, 50, 40};
+    THEN("the view has the same rows as the bitmap") {
+      for (std::size_t y = 0; y < bitmap.height(); ++y) {
+        REQUIRE(std::equal(view.rowAt(y).begin(), view.rowAt(y).end(),
+                           bitmap.rowAt(y).begin()));
+      }
+    }
+    THEN("the view is compressed the same way as the bitmap") {
+      WordFile viewFile;
+      save(viewFile, compress(view, BarchLib::CompressionOptions{5, 4}));
+      WordFile bitmapFile;
+      save(bitmapFile, compress(bitmap, BarchLib::CompressionOptions{5, 4}));
+      REQUIRE(viewFile.words == bitmapFile.words);
+      REQUIRE(compressedSizeOf(view) == compressedSizeOf(bitmap));
+    }
+    THEN("the view is not empty, but its empty rows are") {
+      REQUIRE_FALSE(BarchLib::isEmpty(view));
+      const BarchLib::BitmapView firstRow{buffer.data(), 37, 1, 40};
+      REQUIRE(BarchLib::isEmpty(firstRow));
+    }
+    THEN("the rows of a view cannot overlap") {
+      REQUIRE_THROWS_AS((BarchLib::BitmapView{buffer.data(), 37, 50, 36}),
+                        BarchLib::InvalidSize);
+    }
+  }
+  GIVEN("an empty bitmap") {
+    const BarchLib::Bitmap bitmap{37, 50};
+    THEN("it is empty") { REQUIRE(BarchLib::isEmpty(bitmap)); }
+  }
+}
+
+SCENARIO("compression results can come from a memory resource",
+         "[CompressedBitmap]") {
+  GIVEN("a bitmap with a few black pixels") {
+    BarchLib::Bitmap bitmap{70, 130};
+    fill(bitmap.rowAt(3), BarchLib::Black);
+    fill(bitmap.rowAt(97), BarchLib::Black);
+    bitmap.pixelAt(5, 120) = BarchLib::Black;
+    std::pmr::monotonic_buffer_resource arena;
+    WHEN("it's compressed and uncompressed through an arena") {
+      BarchLib::CompressionOptions compressionOptions;
+      compressionOptions.memoryResource = &arena;
+      const BarchLib::CompressedBitmap compressedBitmap =
+          compress(bitmap, compressionOptions);
+      BarchLib::DecompressionOptions decompressionOptions;
+      decompressionOptions.memoryResource = &arena;
+      const BarchLib::Bitmap result =
+          uncompress(compressedBitmap, decompressionOptions);
+      THEN("the uncompressed bitmap gets its pixels from the arena") {
+        REQUIRE(result.resource() == &arena);
+      }
+      THEN("every pixel is restored, the white ones included") {
+        REQUIRE(result == bitmap);
+      }
+    }
+  }
+}
+
+SCENARIO("compress() and uncompress() can collect statistics",
+         "[CompressedBitmap]") {
+  GIVEN("a 10x200 bitmap with three rows that are not empty") {
+    // Every row that is not empty takes two blocks and a padded one.
+    BarchLib::Bitmap bitmap{10, 200};
+    fill(bitmap.rowAt(1), BarchLib::Black);
+    bitmap.pixelAt(0, 2) = BarchLib::Black;
+    fill(bitmap.rowAt(150), BarchLib::Black);
+    for (const std::size_t threadCount : {1, 3}) {
+      WHEN("it is compressed and uncompressed on " +
+           std::to_string(threadCount) + " threads") {
+        BarchLib::CodecStatistics compressionStatistics;
+        BarchLib::CompressionOptions compressionOptions;
+        compressionOptions.threadCount = threadCount;
+        compressionOptions.statistics = &compressionStatistics;
+        const BarchLib::CompressedBitmap compressedBitmap =
+            compress(bitmap, compressionOptions);
+        BarchLib::CodecStatistics decompressionStatistics;
+        BarchLib::DecompressionOptions decompressionOptions;
+        decompressionOptions.threadCount = threadCount;
+        decompressionOptions.statistics = &decompressionStatistics;
+        REQUIRE(uncompress(compressedBitmap, decompressionOptions) == bitmap);
+        if constexpr (BarchLib::StatisticsAreEnabled) {
+          THEN("every block is counted once, by its kind") {
+            for (const BarchLib::CodecStatistics &statistics :
+                 {compressionStatistics, decompressionStatistics}) {
+              REQUIRE(statistics.emptyRowCount == 197);
+              REQUIRE(statistics.whiteBlockCount == 1);
+              REQUIRE(statistics.blackBlockCount == 4);
+              REQUIRE(statistics.literalBlockCount == 1);
+              REQUIRE(statistics.paddingBlockCount == 3);
+              REQUIRE(statistics.bitCount == compressedSizeOf(bitmap));
+            }
+          }
+        } else {
+          THEN("nothing is counted") {
+            REQUIRE(compressionStatistics.bitCount == 0);
+            REQUIRE(decompressionStatistics.bitCount == 0);
+            REQUIRE(compressionStatistics.codingTime.count() == 0);
+          }
+        }
+      }
+    }
+    WHEN("it is compressed and uncompressed row by row") {
+      BarchLib::CodecStatistics compressionStatistics;
+      BarchLib::CompressionOptions options;
+      options.statistics = &compressionStatistics;
+      WordFile file;
+      BarchLib::StreamingEncoder encoder{10, 200, options};
+      encoder.start(file);
+      for (std::size_t y = 0; y < 200; ++y) {
+        encoder.push(bitmap.rowAt(y), file);
+      }
+      encoder.finish(file);
+      BarchLib::CodecStatistics decompressionStatistics;
+      BarchLib::StreamingDecoder decoder{file};
+      decoder.collectStatistics(&decompressionStatistics);
+      std::array<BarchLib::Pixel, 10> pixels;
+      for (std::size_t y = 0; y < 200; ++y) {
+        REQUIRE(decoder.pull(pixels));
+        REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                           bitmap.rowAt(y).begin()));
+      }
+      if constexpr (BarchLib::StatisticsAreEnabled) {
+        THEN("every block is counted once, by its kind") {
+          for (const BarchLib::CodecStatistics &statistics :
+               {compressionStatistics, decompressionStatistics}) {
+            REQUIRE(statistics.emptyRowCount == 197);
+            REQUIRE(statistics.whiteBlockCount == 1);
+            REQUIRE(statistics.blackBlockCount == 4);
+            REQUIRE(statistics.literalBlockCount == 1);
+            REQUIRE(statistics.paddingBlockCount == 3);
+            REQUIRE(statistics.bitCount == compressedSizeOf(bitmap));
+          }
+        }
+      } else {
+        THEN("nothing is counted") {
+          REQUIRE(compressionStatistics.bitCount == 0);
+          REQUIRE(decompressionStatistics.bitCount == 0);
+        }
+      }
+    }
+    WHEN("it is compressed into 8x8 tiles") {
+      BarchLib::CodecStatistics compressionStatistics;
+      BarchLib::CompressionOptions compressionOptions;
+      compressionOptions.tileSize = 8;
+      compressionOptions.statistics = &compressionStatistics;
+      const BarchLib::CompressedBitmap compressedBitmap =
+          compress(bitmap, compressionOptions);
+      BarchLib::CodecStatistics decompressionStatistics;
+      BarchLib::DecompressionOptions decompressionOptions;
+      decompressionOptions.statistics = &decompressionStatistics;
+      REQUIRE(uncompress(compressedBitmap, decompressionOptions) == bitmap);
+      if constexpr (BarchLib::StatisticsAreEnabled) {
+        THEN("the rows of the empty tiles are counted as empty") {
+          // Only the tiles of rows 1, 2 and 150 are not empty. Those of the
+          // 2 pixels wide right column are made of padded blocks only.
+          REQUIRE(compressionStatistics.emptyRowCount == 2 * 200 - 4 * 8);
+          REQUIRE(compressionStatistics.paddingBlockCount == 2 * 8);
+        }
+        THEN("the tiles are decoded the way they were encoded") {
+          REQUIRE(decompressionStatistics.emptyRowCount ==
+                  compressionStatistics.emptyRowCount);
+          REQUIRE(decompressionStatistics.whiteBlockCount ==
+                  compressionStatistics.whiteBlockCount);
+          REQUIRE(decompressionStatistics.blackBlockCount ==
+                  compressionStatistics.blackBlockCount);
+          REQUIRE(decompressionStatistics.literalBlockCount ==
+                  compressionStatistics.literalBlockCount);
+          REQUIRE(decompressionStatistics.bitCount ==
+                  compressionStatistics.bitCount);
+        }
+        THEN("the tiles are counted the same way when they are pulled") {
+          BarchLib::CodecStatistics pullStatistics;
+          BarchLib::StreamingDecoder decoder{compressedBitmap};
+          decoder.collectStatistics(&pullStatistics);
+          std::array<BarchLib::Pixel, 10> pixels;
+          while (decoder.pull(pixels)) {}
+          REQUIRE(pullStatistics.emptyRowCount ==
+                  decompressionStatistics.emptyRowCount);
+          REQUIRE(pullStatistics.literalBlockCount ==
+                  decompressionStatistics.literalBlockCount);
+          REQUIRE(pullStatistics.bitCount == decompressionStatistics.bitCount);
+        }
+      }
+    }
+  }
+}
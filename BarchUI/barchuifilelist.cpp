@@ -0,0 +1,118 @@
+#include "barchuifilelist.hpp"
+#include "barchuimodel.hpp"
+
+#include <algorithm> // for std::sort
+#include <cstddef>   // for std::ptrdiff_t, std::size_t
+#include <utility>   // for std::move
+
+namespace BarchUI {
+
+FileList::FileList(QDir directory, QQmlEngine &engine, Scheduler &scheduler,
+                   QObject *parent)
+    : QAbstractListModel(parent), m_directory(std::move(directory)),
+      m_engine(&engine), m_scheduler(&scheduler) {
+  refresh();
+}
+
+int FileList::rowCount(const QModelIndex &parent) const {
+  // It's a list, so the rows have no children.
+  if (parent.isValid()) { return 0; }
+  return static_cast<int>(m_files.size());
+}
+
+QVariant FileList::data(const QModelIndex &index, const int role) const {
+  if (!index.isValid() || index.row() >= rowCount()) { return {}; }
+  File *const file = m_files[static_cast<std::size_t>(index.row())];
+  switch (role) {
+  case NameRole:
+    return file->name();
+  case SizeRole:
+    return file->size();
+  case FileRole:
+    return QVariant::fromValue(static_cast<QObject *>(file));
+  default:
+    return {};
+  }
+}
+
+QHash<int, QByteArray> FileList::roleNames() const {
+  return {{NameRole, "name"}, {SizeRole, "size"}, {FileRole, "currentFile"}};
+}
+
+QFileInfoList FileList::listDirectory() {
+  // Make sure it can pick up the changes.
+  m_directory.refresh();
+  QFileInfoList entries = m_directory.entryInfoList(QDir::Files, QDir::NoSort);
+  std::sort(entries.begin(), entries.end(),
+            [](const QFileInfo &lhs, const QFileInfo &rhs) {
+              return lhs.fileName() < rhs.fileName();
+            });
+  return entries;
+}
+
+void FileList::refresh() {
+  const QFileInfoList entries = listDirectory();
+  // Both the rows and the entries are sorted by name, so they are merged like
+  // two sorted lists. Whatever is left of the rows is past the last entry.
+  std::size_t row = 0;
+  qsizetype entryIndex = 0;
+  const auto removeRows = [this, &row](const std::size_t count) {
+    const int first = static_cast<int>(row);
+    beginRemoveRows({}, first, first + static_cast<int>(count) - 1);
+    const auto begin = m_files.begin() + static_cast<std::ptrdiff_t>(row);
+    const auto end = begin + static_cast<std::ptrdiff_t>(count);
+    for (auto it = begin; it != end; ++it) { (*it)->release(); }
+    m_files.erase(begin, end);
+    endRemoveRows();
+  };
+  while (row < m_files.size() || entryIndex < entries.size()) {
+    const bool hasEntry = entryIndex < entries.size();
+    const QString entryName =
+        hasEntry ? entries[entryIndex].fileName() : QString{};
+    // Remove the run of rows whose files are gone.
+    std::size_t goneCount = 0;
+    while (row + goneCount < m_files.size() &&
+           (!hasEntry || m_files[row + goneCount]->name() < entryName)) {
+      ++goneCount;
+    }
+    if (goneCount) {
+      removeRows(goneCount);
+      continue;
+    }
+    // Insert the run of entries that are new.
+    qsizetype newCount = 0;
+    while (entryIndex + newCount < entries.size() &&
+           (row == m_files.size() ||
+            entries[entryIndex + newCount].fileName() < m_files[row]->name())) {
+      ++newCount;
+    }
+    if (newCount) {
+      const int first = static_cast<int>(row);
+      beginInsertRows({}, first, first + static_cast<int>(newCount) - 1);
+      std::vector<File *> newFiles;
+      newFiles.reserve(static_cast<std::size_t>(newCount));
+      for (qsizetype index = 0; index < newCount; ++index) {
+        auto *const file =
+            new File(entries[entryIndex + index], *m_engine, *m_scheduler);
+        // Files with a parent are never garbage collected by QML.
+        file->setParent(this);
+        newFiles.push_back(file);
+      }
+      m_files.insert(m_files.begin() + static_cast<std::ptrdiff_t>(row),
+                     newFiles.begin(), newFiles.end());
+      endInsertRows();
+      row += static_cast<std::size_t>(newCount);
+      entryIndex += newCount;
+      continue;
+    }
+    // The same file is in both. It may have been overwritten.
+    if (m_files[row]->refresh(entries[entryIndex])) {
+      const QModelIndex index = createIndex(static_cast<int>(row), 0);
+      emit dataChanged(index, index, {SizeRole});
+    }
+    ++row;
+    ++entryIndex;
+  }
+}
+
+} // namespace BarchUI
@@ -0,0 +1,61 @@
+#ifndef BARCHUIFILELIST_HPP
+#define BARCHUIFILELIST_HPP
+
+#include <vector> // for std::vector
+
+#include <QtCore/QtCore>
+
+#include <QQmlEngine>
+
+namespace BarchUI {
+
+class File;
+class Scheduler;
+
+// FileList is the model of the files in a directory. Every row holds a File.
+//
+// refresh() compares the directory with the rows, and inserts and removes only
+// the rows of the files that came and went. The other Files stay as they are,
+// and so do their delegates and the progress of their jobs. The rows are
+// sorted by file name.
+class FileList final : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum Role {
+    NameRole = Qt::UserRole + 1,
+    SizeRole,
+    // Holds the File itself, so that its other properties and methods can be
+    // reached.
+    FileRole,
+  };
+
+  FileList(QDir directory, QQmlEngine &engine, Scheduler &scheduler,
+           QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = {}) const override;
+
+  QVariant data(const QModelIndex &index, int role) const override;
+
+  QHash<int, QByteArray> roleNames() const override;
+
+  // Picks up the changes of the directory.
+  Q_INVOKABLE void refresh();
+
+private:
+  QDir m_directory;
+
+  QQmlEngine *m_engine;
+
+  Scheduler *m_scheduler;
+
+  // Holds the files sorted by name. They are owned by this list.
+  std::vector<File *> m_files;
+
+  // Returns the files that are in the directory now, sorted by name.
+  QFileInfoList listDirectory();
+};
+
+} // namespace BarchUI
+
+#endif // BARCHUIFILELIST_HPP
@@ -0,0 +1,99 @@
+#include "barchuiio.hpp"
+
+#include <algorithm> // for std::min
+#include <array>     // for std::array
+#include <bit>       // for std::endian
+#include <cstdint>   // for std::uint64_t
+#include <stdexcept> // for std::runtime_error
+
+#include <barchlib.hpp>
+
+static constexpr bool ValuesAreStoredAsIs =
+    sizeof(std::size_t) == sizeof(std::uint64_t) &&
+    std::endian::native == std::endian::little;
+
+void throwRuntimeError(const QString &description) {
+  throw std::runtime_error{description.toUtf8()};
+}
+
+QT_BEGIN_NAMESPACE
+
+static void readBytes(QFile &file, void *data, const qint64 size) {
+  if (file.read(static_cast<char *>(data), size) != size) {
+    // NOTE: QFile::fileName() returns actually a relative path to the file.
+    QFileInfo fileInfo{file};
+    throwRuntimeError(
+        u"An error occurred while reading the file '%1'. Corrupt data."_qs.arg(
+            fileInfo.fileName()));
+  }
+}
+
+static void writeBytes(QFile &file, const void *data, const qint64 size) {
+  if (file.write(static_cast<const char *>(data), size) != size) {
+    // NOTE: QFile::fileName() returns actually a relative path to the file.
+    QFileInfo fileInfo{file};
+    throwRuntimeError(
+        u"An error occurred while writing the file '%1'. I/O error: %2"_qs
+            .arg(fileInfo.fileName())
+            .arg(file.errorString()));
+  }
+}
+
+void read(QFile &file, std::size_t &value) {
+  std::uint64_t value64 = 0;
+  readBytes(file, &value64, sizeof(value64));
+  value = static_cast<std::size_t>(qFromLittleEndian(value64));
+}
+
+void read(QFile &file, const std::span<std::size_t> values) {
+  if constexpr (sizeof(std::size_t) == sizeof(std::uint64_t)) {
+    readBytes(file, values.data(), static_cast<qint64>(values.size_bytes()));
+    if constexpr (!ValuesAreStoredAsIs) {
+      for (auto &value : values) { value = qFromLittleEndian(value); }
+    }
+  } else {
+    for (auto &value : values) { read(file, value); }
+  }
+}
+
+void write(QFile &file, const std::size_t value) {
+  const std::uint64_t value64 = qToLittleEndian<std::uint64_t>(value);
+  writeBytes(file, &value64, sizeof(value64));
+}
+
+void write(QFile &file, const std::span<std::size_t const> values) {
+  if constexpr (ValuesAreStoredAsIs) {
+    writeBytes(file, values.data(), static_cast<qint64>(values.size_bytes()));
+  } else {
+    // The values cannot be converted in place, so they are converted a chunk
+    // at a time instead.
+    std::array<std::uint64_t, 512> chunk;
+    for (std::size_t index = 0; index < values.size(); index += chunk.size()) {
+      const std::size_t count = std::min(chunk.size(), values.size() - index);
+      for (std::size_t offset = 0; offset < count; ++offset) {
+        chunk[offset] = qToLittleEndian<std::uint64_t>(values[index + offset]);
+      }
+      writeBytes(file, chunk.data(),
+                 static_cast<qint64>(count * sizeof(std::uint64_t)));
+    }
+  }
+}
+
+QT_END_NAMESPACE
+
+void viewCompressedFile(
+    QFile &file,
+    const std::function<void(const BarchLib::CompressedBitmapView &)> &decode) {
+  if constexpr (ValuesAreStoredAsIs) {
+    const qint64 size = file.size();
+    if (uchar *data = file.map(0, size)) {
+      // The file is unmapped once it's closed, even if decoding throws.
+      decode(BarchLib::CompressedBitmapView{std::span<std::size_t const>{
+          reinterpret_cast<const std::size_t *>(data),
+          static_cast<std::size_t>(size) / sizeof(std::size_t)}});
+      file.unmap(data);
+      return;
+    }
+  }
+  decode(BarchLib::load(file));
+}
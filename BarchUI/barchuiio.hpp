@@ -0,0 +1,45 @@
+#ifndef BARCHUIIO_HPP
+#define BARCHUIIO_HPP
+
+#include <cstddef>    // for std::size_t
+#include <functional> // for std::function
+#include <span>       // for std::span
+
+#include <QtCore/QtCore>
+
+namespace BarchLib::inline v1 {
+
+struct CompressedBitmapView;
+
+} // namespace BarchLib::inline v1
+
+// Throws std::runtime_error with the description.
+[[noreturn]] void throwRuntimeError(const QString &description);
+
+//******************************************************************************
+// Implementation of BarchLib::Reader and BarchLib::Writer concepts. They allow
+// us to load/save BARCH files.
+//
+// Every value is stored as a 64-bit little-endian integer. Spans of values are
+// transferred with a single call to QFile. When std::size_t is stored the same
+// way in memory, which is the case on every platform we ship, there's no
+// conversion at all.
+QT_BEGIN_NAMESPACE
+
+void read(QFile &file, std::size_t &value);
+void read(QFile &file, std::span<std::size_t> values);
+
+void write(QFile &file, std::size_t value);
+void write(QFile &file, std::span<std::size_t const> values);
+
+QT_END_NAMESPACE
+
+// Calls `decode` with the compressed bitmap that `file` holds. The file is
+// mapped into memory and decoded right there when possible, so that only the
+// pages that are actually needed get read. Otherwise, it's loaded the usual
+// way.
+void viewCompressedFile(
+    QFile &file,
+    const std::function<void(const BarchLib::CompressedBitmapView &)> &decode);
+
+#endif // BARCHUIIO_HPP
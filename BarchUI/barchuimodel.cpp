@@ -1,16 +1,19 @@
 #include "barchuimodel.hpp"
+#include "barchuiio.hpp"
+#include "barchuischeduler.hpp"
+#include "barchuithumbnails.hpp"
+
+#include <chrono>  // for std::chrono::milliseconds
+#include <limits>  // for std::numeric_limits
+#include <memory>  // for std::make_shared, std::shared_ptr
+#include <utility> // for std::move
 
 #include <barchlib.hpp>
 
 #include <QQmlEngine>
 
 //******************************************************************************
-// A bunch of helper functions. They deal with error handling and filename/path
-// construction.
-
-static void throwRuntimeError(const QString &description) {
-  throw std::runtime_error{description.toUtf8()};
-}
+// A bunch of helper functions. They deal with filename/path construction.
 
 static QString pathJoin(const QString &folder, const QString &file) {
   return QDir::cleanPath(folder + QDir::separator() + file);
@@ -32,84 +35,188 @@ static QString makeBmpPath(const QFileInfo &fileInfo) {
   return pathJoin(fileInfo.path(), makeBmpFileName(fileInfo));
 }
 
-//******************************************************************************
-// Implementation of BarchLib::Reader and BarchLib::Writer concepts. They allow
-// us to load/save BARCH files.
-QT_BEGIN_NAMESPACE
-
-static void read(QFile &file, std::size_t &value) {
-  std::uint64_t value64 = 0;
-  if (file.read(reinterpret_cast<char *>(&value64), sizeof(value64)) ==
-      sizeof(value64)) {
-    value = static_cast<std::size_t>(value64);
-  } else {
-    // NOTE: QFile::fileName() returns actually a relative path to the file.
-    QFileInfo fileInfo{file};
+// Sums up the statistics in a line that fits next to the file name.
+static QString describeStatistics(const BarchLib::CodecStatistics &statistics) {
+  const std::size_t blockCount =
+      statistics.whiteBlockCount + statistics.blackBlockCount +
+      statistics.literalBlockCount + statistics.paddingBlockCount;
+  const auto percentOf = [blockCount](const std::size_t count) {
+    return blockCount ? 100 * count / blockCount : 0;
+  };
+  const auto milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          statistics.scanningTime + statistics.codingTime +
+          statistics.splicingTime);
+  return u"%1 empty rows, %2% white, %3% black, %4% literal in %5 ms"_qs
+      .arg(statistics.emptyRowCount)
+      .arg(percentOf(statistics.whiteBlockCount))
+      .arg(percentOf(statistics.blackBlockCount))
+      .arg(percentOf(statistics.literalBlockCount))
+      .arg(milliseconds.count());
+}
+
+// Uncompresses the bitmap straight into the scan lines of a new image.
+static QImage uncompressImage(const BarchLib::CompressedBitmapView &bitmap,
+                              BarchLib::CodecStatistics *statistics,
+                              const BarchLib::CancellationToken &cancellation,
+                              const std::size_t threadCount,
+                              const BarchLib::ProgressHandler &progress) {
+  // The sizes come from the file, so they must not wrap around when they are
+  // narrowed, or the image ends up smaller than the bitmap.
+  constexpr auto MaxSide = std::size_t{std::numeric_limits<int>::max()};
+  QImage image;
+  if (bitmap.width() <= MaxSide && bitmap.height() <= MaxSide) {
+    image = QImage(static_cast<int>(bitmap.width()),
+                   static_cast<int>(bitmap.height()),
+                   QImage::Format_Grayscale8);
+  }
+  if (image.isNull()) {
     throwRuntimeError(
-        u"An error occurred while reading the file '%1'. Corrupt data."_qs.arg(
-            fileInfo.fileName()));
+        u"An error occurred while decoding. The image is too large."_qs);
   }
+  const auto width = static_cast<std::size_t>(image.width());
+  const auto stride = static_cast<std::size_t>(image.bytesPerLine());
+  BarchLib::StridedPixels pixels{image.bits(), width, stride};
+  BarchLib::DecompressionOptions options;
+  options.statistics = statistics;
+  options.cancellation = &cancellation;
+  options.threadCount = threadCount;
+  uncompressInto(bitmap, pixels, options, progress);
+  return image;
 }
 
-static void read(QFile &file, const std::span<std::size_t> values) {
-  for (auto &value : values) { read(file, value); }
+// Uncompresses the bitmap that `file` holds.
+static QImage uncompressFile(QFile &file, BarchLib::CodecStatistics *statistics,
+                             const BarchLib::CancellationToken &cancellation,
+                             const std::size_t threadCount,
+                             const BarchLib::ProgressHandler &progress) {
+  QImage image;
+  viewCompressedFile(file, [&](const BarchLib::CompressedBitmapView &bitmap) {
+    image = uncompressImage(bitmap, statistics, cancellation, threadCount,
+                            progress);
+  });
+  return image;
 }
 
-static void write(QFile &file, const std::size_t value) {
-  std::uint64_t value64 = value;
-  if (file.write(reinterpret_cast<const char *>(&value64), sizeof(value64)) !=
-      sizeof(value64)) {
-    // NOTE: QFile::fileName() returns actually a relative path to the file.
-    QFileInfo fileInfo{file};
-    throwRuntimeError(
-        u"An error occurred while writing the file '%1'. I/O error: %2"_qs
-            .arg(fileInfo.fileName())
-            .arg(file.errorString()));
-  }
+// Estimates the peak memory it takes to compress the image without loading
+// it: the image as it's stored, its 8-bit copy, and the compressed bitmap,
+// which takes 34 bits per 4 pixels at worst. Images that cannot be read take
+// next to nothing, because they fail right away.
+static qint64 estimateEncodingMemory(const QFileInfo &fileInfo) {
+  QImageReader reader(fileInfo.filePath());
+  const QSize size = reader.size();
+  if (!size.isValid()) { return fileInfo.size(); }
+  const qint64 pixelCount = qint64{size.width()} * size.height();
+  const int bitsPerPixel =
+      QImage::toPixelFormat(reader.imageFormat()).bitsPerPixel();
+  // The format is unknown for some images until they are loaded.
+  const qint64 imageSize =
+      pixelCount * (bitsPerPixel ? (bitsPerPixel + 7) / 8 : 4);
+  const qint64 copySize = bitsPerPixel == 8 ? 0 : pixelCount;
+  return imageSize + copySize + pixelCount * 34 / 32;
 }
 
-static void write(QFile &file, const std::span<std::size_t const> values) {
-  for (const auto value : values) { write(file, value); }
+// Estimates the peak memory it takes to uncompress the file: the image and the
+// compressed bitmap, in case it cannot be mapped into memory. The header tells
+// the size of the image. Files whose header cannot be read take next to
+// nothing, because they fail right away.
+static qint64 estimateDecodingMemory(const qint64 width, const qint64 height,
+                                     const qint64 fileSize) {
+  return width * height + fileSize;
 }
 
-QT_END_NAMESPACE
+// Reads the header of the BARCH file at `path`. Files that cannot be read have
+// no info.
+static BarchLib::CompressedBitmapInfo readInfo(const QString &path) {
+  QFile file(path);
+  try {
+    if (file.open(QFile::ReadOnly | QFile::ExistingOnly)) {
+      return BarchLib::loadInfo(file);
+    }
+  } catch (std::exception &) {
+    // The file fails to load anyways. It's reported once it's transcoded.
+  }
+  return {};
+}
 
 //******************************************************************************
-// These are tasks for bitmap encoding/decoding.
+// These are tasks for bitmap encoding/decoding. They are run by the Scheduler,
+// which is told how much memory they need at most up front. Each of them keeps
+// the path of its File, because the File may be refreshed on the GUI thread
+// while the task runs.
 namespace BarchUI::Internal {
 
-struct EncoderTask : public QRunnable {
+struct EncoderTask final {
 
-  EncoderTask(File *file) noexcept : m_file{file} {}
+  EncoderTask(
+      File *file, QString path,
+      std::shared_ptr<BarchLib::CancellationToken> cancellation) noexcept
+      : m_file{file}, m_path{std::move(path)},
+        m_cancellation{std::move(cancellation)} {}
 
-  void run() override {
+  void operator()(const std::size_t threadCount) const noexcept {
     try {
-      m_file->encode();
+      m_file->encode(m_path, *m_cancellation, threadCount);
+    } catch (BarchLib::Cancelled &) {
+      // The user asked for it, so there's nothing to complain about.
+      m_file->resetProgress();
     } catch (std::exception &exc) {
       m_file->resetProgress();
       emit m_file->error(QString::fromUtf8(exc.what()));
     }
+    QMetaObject::invokeMethod(m_file, &File::finishJob, Qt::QueuedConnection);
   }
 
 private:
   File *m_file;
+  QString m_path;
+  std::shared_ptr<BarchLib::CancellationToken> m_cancellation;
 };
 
-struct DecoderTask : public QRunnable {
+struct DecoderTask final {
 
-  DecoderTask(File *file) noexcept : m_file{file} {}
+  DecoderTask(
+      File *file, QString path,
+      std::shared_ptr<BarchLib::CancellationToken> cancellation) noexcept
+      : m_file{file}, m_path{std::move(path)},
+        m_cancellation{std::move(cancellation)} {}
 
-  void run() override {
+  void operator()(const std::size_t threadCount) const noexcept {
     try {
-      m_file->decode();
+      m_file->decode(m_path, *m_cancellation, threadCount);
+    } catch (BarchLib::Cancelled &) {
+      // The user asked for it, so there's nothing to complain about.
+      m_file->resetProgress();
     } catch (std::exception &exc) {
       m_file->resetProgress();
       emit m_file->error(QString::fromUtf8(exc.what()));
     }
+    QMetaObject::invokeMethod(m_file, &File::finishJob, Qt::QueuedConnection);
   }
 
 private:
   File *m_file;
+  QString m_path;
+  std::shared_ptr<BarchLib::CancellationToken> m_cancellation;
+};
+
+// Reads the header of a BARCH file on the global thread pool, so that listing
+// lots of them doesn't block the GUI thread. The info is handed over to the
+// File through a queued signal, so that nothing happens if the File is gone by
+// then.
+class InfoJob final : public QObject, public QRunnable {
+  Q_OBJECT
+
+public:
+  explicit InfoJob(QString path) : m_path{std::move(path)} {}
+
+  void run() override { emit done(readInfo(m_path)); }
+
+signals:
+  void done(BarchLib::CompressedBitmapInfo info);
+
+private:
+  QString m_path;
 };
 
 } // namespace BarchUI::Internal
@@ -118,89 +225,173 @@ private:
 // The UI model itself.
 namespace BarchUI {
 
-File::File(QFileInfo fileInfo, QQmlEngine &engine)
-    : m_fileInfo(std::move(fileInfo)), m_qmlEngine(&engine) {}
+File::File(QFileInfo fileInfo, QQmlEngine &engine, Scheduler &scheduler)
+    : m_fileInfo(std::move(fileInfo)), m_qmlEngine(&engine),
+      m_scheduler(&scheduler) {
+  loadInfo();
+}
 
 void File::transcode() {
   try {
+    m_cancellation = std::make_shared<BarchLib::CancellationToken>();
     if (name().endsWith(".barch")) {
-      QThreadPool::globalInstance()->start(new Internal::DecoderTask{this});
+      // The memory it takes depends on the header, so it's read right away if
+      // it's still on its way.
+      if (m_isLoadingInfo) {
+        ++m_infoRequestCount;
+        setInfo(readInfo(m_fileInfo.filePath()));
+      }
+      m_scheduler->submit(
+          estimateDecodingMemory(m_width, m_height, size()),
+          Internal::DecoderTask{this, m_fileInfo.filePath(), m_cancellation});
     } else {
-      QThreadPool::globalInstance()->start(new Internal::EncoderTask{this});
+      m_scheduler->submit(
+          estimateEncodingMemory(m_fileInfo),
+          Internal::EncoderTask{this, m_fileInfo.filePath(), m_cancellation});
     }
+    // The job tells this thread that it's finished through the event loop, so
+    // it cannot be counted out before it's counted in.
+    ++m_jobCount;
   } catch (std::exception &exc) {
     resetProgress();
     m_qmlEngine->throwError(QString::fromUtf8(exc.what()));
   }
 }
 
-void File::encode() {
-  QImage image(m_fileInfo.filePath());
+void File::cancel() {
+  if (m_cancellation) { m_cancellation->cancel(); }
+}
+
+bool File::refresh(const QFileInfo &fileInfo) {
+  const qint64 oldSize = size();
+  if (fileInfo.size() == oldSize &&
+      fileInfo.lastModified() == m_fileInfo.lastModified()) {
+    return false;
+  }
+  m_fileInfo = fileInfo;
+  if (size() != oldSize) { emit sizeChanged(); }
+  loadInfo();
+  emit thumbnailChanged();
+  return true;
+}
+
+QString File::thumbnail() const {
+  return u"image://%1/%2"_qs.arg(QString::fromLatin1(ThumbnailProvider::Name))
+      .arg(ThumbnailProvider::idOf(m_fileInfo));
+}
+
+void File::loadInfo() {
+  // The other files have no header, so their info stays empty.
+  if (!name().endsWith(".barch")) { return; }
+  m_isLoadingInfo = true;
+  auto *const job = new Internal::InfoJob(m_fileInfo.filePath());
+  // Only the info of the latest request counts, in case the file changes
+  // again before the previous one is read.
+  connect(job, &Internal::InfoJob::done, this,
+          [this, request = ++m_infoRequestCount](
+              const BarchLib::CompressedBitmapInfo &info) {
+            if (request == m_infoRequestCount) { setInfo(info); }
+          });
+  // The pool deletes the job once it's run.
+  QThreadPool::globalInstance()->start(job);
+}
+
+void File::setInfo(const BarchLib::CompressedBitmapInfo &info) {
+  m_isLoadingInfo = false;
+  m_width = static_cast<qint64>(info.width);
+  m_height = static_cast<qint64>(info.height);
+  m_tileSize = static_cast<qint64>(info.tileSize);
+  m_nonEmptyRowCount = static_cast<qint64>(info.nonEmptyRowCount);
+  m_payloadSize = static_cast<qint64>(info.payloadSize);
+  emit infoChanged();
+}
+
+void File::release() {
+  cancel();
+  m_isReleased = true;
+  if (!m_jobCount) { deleteLater(); }
+}
+
+void File::finishJob() {
+  if (!--m_jobCount && m_isReleased) { deleteLater(); }
+}
+
+void File::encode(const QString &path,
+                  const BarchLib::CancellationToken &cancellation,
+                  const std::size_t threadCount) {
+  const QFileInfo fileInfo(path);
+  QImage image(fileInfo.filePath());
   if (image.isNull()) {
     throwRuntimeError(
         u"An error occurred while loading '%1'. Unknown image format."_qs.arg(
-            name()));
+            fileInfo.fileName()));
   }
   if (!image.allGray()) {
     throwRuntimeError(
         u"An error occured while loading '%1'. This image is not grayscale."_qs
-            .arg(name()));
+            .arg(fileInfo.fileName()));
   }
-  const std::size_t width = static_cast<std::size_t>(image.width());
-  const std::size_t height = static_cast<std::size_t>(image.height());
-  BarchLib::Bitmap sourceBitmap{width, height};
-  for (std::size_t y = 0; y < height; ++y) {
-    BarchLib::MutablePixels row = sourceBitmap.rowAt(y);
-    const uchar *scanLine = image.constScanLine(static_cast<int>(y));
-    std::memcpy(row.data(), scanLine, row.size_bytes());
+  // The scan lines of 8-bit grayscale images are compressed right where they
+  // are. The others have to be converted first, including the 8-bit indexed
+  // ones, whose pixels are indices into a palette rather than gray levels.
+  if (image.format() != QImage::Format_Grayscale8) {
+    image.convertTo(QImage::Format_Grayscale8);
   }
+  const BarchLib::BitmapView sourceBitmap{
+      image.constBits(), static_cast<std::size_t>(image.width()),
+      static_cast<std::size_t>(image.height()),
+      static_cast<std::size_t>(image.bytesPerLine())};
+  BarchLib::CodecStatistics statistics;
+  BarchLib::CompressionOptions options;
+  options.statistics = &statistics;
+  options.cancellation = &cancellation;
+  options.threadCount = threadCount;
   BarchLib::CompressedBitmap compressedBitmap =
-      compress(sourceBitmap, [this](const std::size_t currentStep,
-                                    const std::size_t totalSteps) {
-        m_progress = (100 * currentStep) / totalSteps;
-        emit progressChanged();
-      });
-  QFile barchFile(makeBarchPath(m_fileInfo));
+      compress(sourceBitmap, options,
+               [this](const std::size_t currentStep,
+                      const std::size_t totalSteps) {
+                 m_progress = (100 * currentStep) / totalSteps;
+                 emit progressChanged();
+               });
+  QFile barchFile(makeBarchPath(fileInfo));
   if (!barchFile.open(QFile::WriteOnly | QFile::NewOnly)) {
     throwRuntimeError(
         u"An error occurred while saving '%1'. Check if the file already exists."_qs
-            .arg(makeBarchFileName(m_fileInfo)));
+            .arg(makeBarchFileName(fileInfo)));
   }
   save(barchFile, compressedBitmap);
   barchFile.close();
+  setStatistics(statistics);
   emit success();
 }
 
-void File::decode() {
-  QFile barchFile(m_fileInfo.filePath());
+void File::decode(const QString &path,
+                  const BarchLib::CancellationToken &cancellation,
+                  const std::size_t threadCount) {
+  const QFileInfo fileInfo(path);
+  QFile barchFile(fileInfo.filePath());
   if (!barchFile.open(QFile::ReadOnly | QFile::ExistingOnly)) {
     throwRuntimeError(
         u"An error occurred while decoding '%1'. Cannot open the file."_qs.arg(
-            name()));
+            fileInfo.fileName()));
     return;
   }
-  BarchLib::CompressedBitmap compressedBitmap = BarchLib::load(barchFile);
-  barchFile.close();
-  BarchLib::Bitmap reconstructedBitmap =
-      uncompress(compressedBitmap, [this](const std::size_t currentStep,
-                                          const std::size_t totalSteps) {
+  BarchLib::CodecStatistics statistics;
+  QImage image = uncompressFile(
+      barchFile, &statistics, cancellation, threadCount,
+      [this](const std::size_t currentStep, const std::size_t totalSteps) {
         m_progress = (100 * currentStep) / totalSteps;
         emit progressChanged();
       });
-  QImage image(reconstructedBitmap.width(), reconstructedBitmap.height(),
-               QImage::Format_Grayscale8);
-  for (std::size_t y = 0; y < reconstructedBitmap.height(); ++y) {
-    BarchLib::ImmutablePixels row = reconstructedBitmap.rowAt(y);
-    std::memcpy(image.scanLine(static_cast<int>(y)), row.data(),
-                row.size_bytes());
-  }
-  QFile bmpFile(makeBmpPath(m_fileInfo));
+  barchFile.close();
+  QFile bmpFile(makeBmpPath(fileInfo));
   if (!image.save(&bmpFile, "BMP")) {
     throwRuntimeError(u"An error occurred while saving '%1'. I/O error: %2"_qs
-                          .arg(makeBmpFileName(m_fileInfo))
+                          .arg(makeBmpFileName(fileInfo))
                           .arg(bmpFile.errorString()));
   }
   bmpFile.close();
+  setStatistics(statistics);
   emit success();
 }
 
@@ -209,4 +400,19 @@ void File::resetProgress() {
   emit progressChanged();
 }
 
+void File::setStatistics(const BarchLib::CodecStatistics &statistics) {
+  if constexpr (!BarchLib::StatisticsAreEnabled) { return; }
+  // The tasks run on the thread pool, so the text is handed over to the
+  // thread the QML engine reads it from.
+  QMetaObject::invokeMethod(
+      this,
+      [this, text = describeStatistics(statistics)] {
+        m_statistics = text;
+        emit statisticsChanged();
+      },
+      Qt::QueuedConnection);
+}
+
 } // namespace BarchUI
+
+#include "barchuimodel.moc"
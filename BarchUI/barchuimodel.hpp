@@ -2,12 +2,21 @@
 #define BARCHUIMODEL_HPP
 
 #include <cstddef> // for std::size_t
+#include <memory>  // for std::shared_ptr
 
 #include <QtCore/QtCore>
 #include <QtQuick/QtQuick>
 
 #include <QQmlEngine>
 
+namespace BarchLib::inline v1 {
+
+struct CancellationToken;
+struct CodecStatistics;
+struct CompressedBitmapInfo;
+
+} // namespace BarchLib::inline v1
+
 namespace BarchUI::Internal {
 
 struct EncoderTask;
@@ -17,6 +26,8 @@ struct DecoderTask;
 
 namespace BarchUI {
 
+class Scheduler;
+
 /// File represents a file that can be transcoded.
 class File : public QObject {
   Q_OBJECT
@@ -24,24 +35,69 @@ class File : public QObject {
   Q_PROPERTY(QString name READ name CONSTANT)
   QString name() const noexcept { return m_fileInfo.fileName(); }
 
-  Q_PROPERTY(qint64 size READ size CONSTANT)
+  Q_PROPERTY(qint64 size READ size NOTIFY sizeChanged)
   qint64 size() const noexcept { return m_fileInfo.size(); }
+  Q_SIGNAL void sizeChanged();
+
+  // The properties below describe the bitmap that a BARCH file holds. They are
+  // read from its header, without the pixel data, on a background thread. They
+  // are 0 until then, for the other files, and for the ones that cannot be
+  // read.
+  Q_PROPERTY(qint64 width READ width NOTIFY infoChanged)
+  qint64 width() const noexcept { return m_width; }
+
+  Q_PROPERTY(qint64 height READ height NOTIFY infoChanged)
+  qint64 height() const noexcept { return m_height; }
+
+  Q_PROPERTY(qint64 tileSize READ tileSize NOTIFY infoChanged)
+  qint64 tileSize() const noexcept { return m_tileSize; }
+
+  // Tiled bitmaps tell how many tiles are not empty instead.
+  Q_PROPERTY(qint64 nonEmptyRowCount READ nonEmptyRowCount NOTIFY infoChanged)
+  qint64 nonEmptyRowCount() const noexcept { return m_nonEmptyRowCount; }
+
+  // The size of the pixel data in bytes.
+  Q_PROPERTY(qint64 payloadSize READ payloadSize NOTIFY infoChanged)
+  qint64 payloadSize() const noexcept { return m_payloadSize; }
+
+  Q_SIGNAL void infoChanged();
+
+  // The URL of the preview of the file. See ThumbnailProvider.
+  Q_PROPERTY(QString thumbnail READ thumbnail NOTIFY thumbnailChanged)
+  QString thumbnail() const;
+  Q_SIGNAL void thumbnailChanged();
 
   Q_PROPERTY(std::size_t progress READ progress NOTIFY progressChanged)
   std::size_t progress() const noexcept { return m_progress; }
   Q_SIGNAL void progressChanged();
 
+  Q_PROPERTY(QString statistics READ statistics NOTIFY statisticsChanged)
+  QString statistics() const { return m_statistics; }
+  Q_SIGNAL void statisticsChanged();
+
   Q_PROPERTY(QObject *currentFile READ currentFile CONSTANT)
   QObject *currentFile() noexcept { return this; }
 
 public:
   // File is a light-weight wrapper around a QFileInfo.
   // The QQmlEngine is passed in as a parameter because I feel super duper lazy.
-  // Anyways, all that makes the job done.
-  File(QFileInfo fileInfo, QQmlEngine &engine);
+  // Anyways, all that makes the job done. The transcoding runs on `scheduler`.
+  File(QFileInfo fileInfo, QQmlEngine &engine, Scheduler &scheduler);
 
   Q_INVOKABLE void transcode();
 
+  // Stops the transcoding that is in progress, if any. Nothing is saved.
+  Q_INVOKABLE void cancel();
+
+  // Picks up the changes of the file on disk that `fileInfo` tells about.
+  // Returns `true` if its size or modification time changed. The header of a
+  // BARCH file is read again in the background in that case.
+  bool refresh(const QFileInfo &fileInfo);
+
+  // Cancels the transcoding and deletes this File once no job refers to it
+  // anymore. Called when the file goes away from the disk.
+  void release();
+
 signals:
   // success is emitted every time this file has been transcoded into its
   // alternative representation.
@@ -59,15 +115,60 @@ private:
 
   QQmlEngine *m_qmlEngine;
 
+  Scheduler *m_scheduler;
+
+  // See the properties above.
+  qint64 m_width = 0;
+  qint64 m_height = 0;
+  qint64 m_tileSize = 0;
+  qint64 m_nonEmptyRowCount = 0;
+  qint64 m_payloadSize = 0;
+
   // Holds the current progress as a value from 0 to 100 (percents).
   std::size_t m_progress = 0;
 
-  void encode();
-  void decode();
+  // Holds the number of jobs that were submitted, but didn't finish yet.
+  std::size_t m_jobCount = 0;
+
+  // Specifies that this File is deleted once the last job finishes.
+  bool m_isReleased = false;
+
+  // Specifies that the header of the file is being read. The requests are
+  // counted, so that the info of an outdated one is dropped.
+  bool m_isLoadingInfo = false;
+  std::size_t m_infoRequestCount = 0;
+
+  // Stops the transcoding that is in progress once it's cancelled. Every
+  // transcoding gets a token of its own, so that cancelling one doesn't stop
+  // the next.
+  std::shared_ptr<BarchLib::CancellationToken> m_cancellation;
+
+  // Describes the statistics of the last transcoding. It stays empty unless
+  // BarchLib collects them.
+  QString m_statistics;
+
+  // Starts reading the header of a BARCH file into the properties above.
+  void loadInfo();
+
+  void setInfo(const BarchLib::CompressedBitmapInfo &info);
+
+  // Transcode the file at `path`. They run on the Scheduler, so they don't
+  // touch m_fileInfo, which refresh() may replace in the meantime.
+  void encode(const QString &path,
+              const BarchLib::CancellationToken &cancellation,
+              std::size_t threadCount);
+  void decode(const QString &path,
+              const BarchLib::CancellationToken &cancellation,
+              std::size_t threadCount);
 
   // Called by the error handlers to reset the progress so that the UI gets
   // properly updated.
   void resetProgress();
+
+  // Called on the thread this File lives in once a job finishes.
+  void finishJob();
+
+  void setStatistics(const BarchLib::CodecStatistics &statistics);
 };
 
 } // namespace BarchUI
@@ -0,0 +1,93 @@
+#include "barchuischeduler.hpp"
+
+#include <algorithm> // for std::max
+#include <thread>    // for std::thread
+#include <utility>   // for std::move
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+static std::size_t resolveThreadCount(const std::size_t threadCount) {
+  if (threadCount) { return threadCount; }
+  const unsigned hardwareThreadCount = std::thread::hardware_concurrency();
+  return std::max(std::size_t{1}, std::size_t{hardwareThreadCount});
+}
+
+namespace BarchUI {
+
+Scheduler::Scheduler(const qint64 memoryBudget, const std::size_t threadCount)
+    : m_memoryBudget{memoryBudget},
+      m_threadCount{resolveThreadCount(threadCount)} {
+  // Every running job takes at least one of the cores.
+  m_threadPool.setMaxThreadCount(static_cast<int>(m_threadCount));
+}
+
+Scheduler::~Scheduler() { waitForDone(); }
+
+void Scheduler::waitForDone() {
+  {
+    const QMutexLocker locker{&m_mutex};
+    m_pendingJobs.clear();
+  }
+  m_threadPool.waitForDone();
+}
+
+void Scheduler::submit(const qint64 memory, Job job) {
+  const QMutexLocker locker{&m_mutex};
+  m_pendingJobs.push_back(PendingJob{memory, std::move(job)});
+  startJobs();
+}
+
+void Scheduler::startJobs() {
+  while (!m_pendingJobs.empty()) {
+    const PendingJob &nextJob = m_pendingJobs.front();
+    // A job that doesn't fit waits for the others to finish. The ones behind
+    // it wait too, so that it doesn't starve.
+    if (m_runningJobCount) {
+      if (m_reservedThreadCount >= m_threadCount) { return; }
+      if (nextJob.memory > m_memoryBudget - m_reservedMemory) { return; }
+    }
+    // The idle cores are shared with the jobs that are waiting.
+    const std::size_t threadCount =
+        std::max(std::size_t{1}, (m_threadCount - m_reservedThreadCount) /
+                                     m_pendingJobs.size());
+    const qint64 memory = nextJob.memory;
+    Job job = std::move(m_pendingJobs.front().job);
+    m_pendingJobs.pop_front();
+    m_reservedMemory += memory;
+    m_reservedThreadCount += threadCount;
+    ++m_runningJobCount;
+    m_threadPool.start([this, memory, threadCount, job = std::move(job)] {
+      job(threadCount);
+      const QMutexLocker locker{&m_mutex};
+      m_reservedMemory -= memory;
+      m_reservedThreadCount -= threadCount;
+      --m_runningJobCount;
+      startJobs();
+    });
+  }
+}
+
+qint64 Scheduler::defaultMemoryBudget() {
+  qint64 physicalMemory = 0;
+#if defined(Q_OS_WIN)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status)) {
+    physicalMemory = static_cast<qint64>(status.ullTotalPhys);
+  }
+#elif defined(Q_OS_UNIX)
+  const long pageCount = sysconf(_SC_PHYS_PAGES);
+  const long pageSize = sysconf(_SC_PAGE_SIZE);
+  if (pageCount > 0 && pageSize > 0) {
+    physicalMemory = qint64{pageCount} * pageSize;
+  }
+#endif
+  if (physicalMemory <= 0) { return qint64{2} << 30; }
+  return physicalMemory / 2;
+}
+
+} // namespace BarchUI
@@ -0,0 +1,81 @@
+#ifndef BARCHUISCHEDULER_HPP
+#define BARCHUISCHEDULER_HPP
+
+#include <cstddef>    // for std::size_t
+#include <deque>      // for std::deque
+#include <functional> // for std::function
+
+#include <QtCore/QtCore>
+
+namespace BarchUI {
+
+// Scheduler runs the transcoding jobs on a thread pool of its own. Every job
+// tells how much memory it needs at most, and starts only once that fits into
+// the memory budget next to the jobs that are running already. So clicking
+// through a dozen huge files runs them one after another instead of all at
+// once.
+//
+// The jobs start in the order they were submitted. A job that needs more than
+// the whole budget still runs, but only when nothing else does.
+//
+// A job is also told how many threads it may use. A job that starts while no
+// others are waiting gets all the idle cores. When lots of jobs are waiting,
+// every one of them gets a single core, so that they run side by side.
+class Scheduler final {
+public:
+  // Job does the work. It's given the number of threads it may use, and must
+  // not throw.
+  using Job = std::function<void(std::size_t /* threadCount */)>;
+
+  // memoryBudget is in bytes. threadCount is the number of cores the jobs
+  // share. 0 means one per hardware thread.
+  Scheduler(qint64 memoryBudget, std::size_t threadCount = 0);
+
+  // See waitForDone().
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  qint64 memoryBudget() const noexcept { return m_memoryBudget; }
+
+  // Runs `job` once `memory` bytes fit into the budget.
+  void submit(qint64 memory, Job job);
+
+  // Waits for the jobs that are running. The ones that are waiting are
+  // dropped.
+  void waitForDone();
+
+  // Returns half of the physical memory of this machine, or 2 GiB if there's
+  // no way to tell.
+  static qint64 defaultMemoryBudget();
+
+private:
+  struct PendingJob final {
+    qint64 memory;
+    Job job;
+  };
+
+  qint64 m_memoryBudget;
+  std::size_t m_threadCount;
+
+  QThreadPool m_threadPool;
+
+  // Guards everything below.
+  QMutex m_mutex;
+
+  std::deque<PendingJob> m_pendingJobs;
+
+  // Hold what the running jobs took.
+  qint64 m_reservedMemory = 0;
+  std::size_t m_reservedThreadCount = 0;
+  std::size_t m_runningJobCount = 0;
+
+  // Starts the jobs at the front of the queue that fit.
+  // Precondition: the mutex is locked.
+  void startJobs();
+};
+
+} // namespace BarchUI
+
+#endif // BARCHUISCHEDULER_HPP
@@ -0,0 +1,243 @@
+#include "barchuithumbnails.hpp"
+#include "barchuiio.hpp"
+
+#include <algorithm> // for std::max
+#include <cstddef>   // for std::size_t
+#include <cstring>   // for std::memcpy
+#include <memory>    // for std::make_shared, std::shared_ptr
+#include <utility>   // for std::move
+
+#include <barchlib.hpp>
+
+// Holds the size of the previews that QML doesn't tell the size of.
+static constexpr int DefaultMaxSide = 128;
+
+// Decodes every scale-th row of the compressed bitmap, where the scale is what
+// it takes to fit `maxSide`.
+static QImage makeBarchThumbnail(const QString &path, const int maxSide) {
+  QFile file(path);
+  if (!file.open(QFile::ReadOnly | QFile::ExistingOnly)) {
+    throwRuntimeError(
+        u"An error occurred while reading '%1'. Cannot open the file."_qs.arg(
+            QFileInfo{file}.fileName()));
+  }
+  QImage image;
+  viewCompressedFile(file, [&](const BarchLib::CompressedBitmapView &bitmap) {
+    const std::size_t side = std::max(bitmap.width(), bitmap.height());
+    const auto maxSize = static_cast<std::size_t>(maxSide);
+    const std::size_t scale = (side + maxSize - std::size_t{1}) / maxSize;
+    const BarchLib::Bitmap preview = uncompressPreview(bitmap, scale);
+    image = QImage(static_cast<int>(preview.width()),
+                   static_cast<int>(preview.height()),
+                   QImage::Format_Grayscale8);
+    for (std::size_t y = 0; y < preview.height(); ++y) {
+      std::memcpy(image.scanLine(static_cast<int>(y)), preview.rowAt(y).data(),
+                  preview.width());
+    }
+  });
+  return image;
+}
+
+// Reads the image downscaled to fit `maxSide`. The formats that support it
+// downscale while they read, so the full image is never decoded.
+static QImage makeImageThumbnail(const QString &path, const int maxSide) {
+  QImageReader reader(path);
+  const QSize size = reader.size();
+  if (size.isValid() && (size.width() > maxSide || size.height() > maxSide)) {
+    reader.setScaledSize(size.scaled(maxSide, maxSide, Qt::KeepAspectRatio)
+                             .expandedTo(QSize{1, 1}));
+  }
+  QImage image = reader.read();
+  if (image.isNull()) {
+    throwRuntimeError(u"An error occurred while reading '%1'. %2"_qs
+                          .arg(QFileInfo{path}.fileName())
+                          .arg(reader.errorString()));
+  }
+  return image;
+}
+
+//******************************************************************************
+// The previews are made by jobs on the thread pool of the provider. A job hands
+// its preview over to the response that asked for it through a queued signal,
+// so that nothing happens if the response is gone by then.
+namespace BarchUI::Internal {
+
+class ThumbnailJob final : public QObject, public QRunnable {
+  Q_OBJECT
+
+public:
+  ThumbnailJob(ThumbnailProvider &provider, QString id, const int maxSide,
+               std::shared_ptr<BarchLib::CancellationToken> cancellation)
+      : m_provider{&provider}, m_id{std::move(id)}, m_maxSide{maxSide},
+        m_cancellation{std::move(cancellation)} {}
+
+  void run() override {
+    QImage image;
+    QString error;
+    // The delegates that scroll out of view cancel their previews. Lots of
+    // them may be waiting by then.
+    if (m_cancellation->isCancelled()) {
+      error = u"The preview was cancelled."_qs;
+    } else {
+      try {
+        image = m_provider->thumbnail(m_id, m_maxSide);
+      } catch (std::exception &exc) { error = QString::fromUtf8(exc.what()); }
+    }
+    emit done(image, error);
+  }
+
+signals:
+  void done(QImage image, QString error);
+
+private:
+  ThumbnailProvider *m_provider;
+  QString m_id;
+  int m_maxSide;
+  std::shared_ptr<BarchLib::CancellationToken> m_cancellation;
+};
+
+class ThumbnailResponse final : public QQuickImageResponse {
+public:
+  ThumbnailResponse(ThumbnailProvider &provider, QThreadPool &threadPool,
+                    QString id, const int maxSide)
+      : m_cancellation{std::make_shared<BarchLib::CancellationToken>()} {
+    auto *const job =
+        new ThumbnailJob(provider, std::move(id), maxSide, m_cancellation);
+    connect(job, &ThumbnailJob::done, this,
+            [this](QImage image, QString error) {
+              m_image = std::move(image);
+              m_error = std::move(error);
+              emit finished();
+            });
+    // The pool deletes the job once it's run.
+    threadPool.start(job);
+  }
+
+  QQuickTextureFactory *textureFactory() const override {
+    return QQuickTextureFactory::textureFactoryForImage(m_image);
+  }
+
+  QString errorString() const override { return m_error; }
+
+  void cancel() override { m_cancellation->cancel(); }
+
+private:
+  std::shared_ptr<BarchLib::CancellationToken> m_cancellation;
+  QImage m_image;
+  QString m_error;
+};
+
+} // namespace BarchUI::Internal
+
+namespace BarchUI {
+
+ThumbnailProvider::ThumbnailProvider(const qint64 memoryBudget,
+                                     const qint64 diskBudget,
+                                     QDir cacheDirectory)
+    : m_cacheDirectory(std::move(cacheDirectory)),
+      m_memoryCache(memoryBudget), m_diskBudget{diskBudget} {
+  // The previews that cannot be saved are made again next time.
+  m_cacheDirectory.mkpath(u"."_qs);
+  // The previews of the previous runs are counted without holding up the UI.
+  m_threadPool.start([this] {
+    const QMutexLocker locker{&m_diskMutex};
+    pruneDiskCache();
+  });
+}
+
+QQuickImageResponse *
+ThumbnailProvider::requestImageResponse(const QString &id,
+                                        const QSize &requestedSize) {
+  const int maxSide = std::max(requestedSize.width(), requestedSize.height());
+  return new Internal::ThumbnailResponse(*this, m_threadPool, id,
+                                         maxSide > 0 ? maxSide
+                                                     : DefaultMaxSide);
+}
+
+QString ThumbnailProvider::idOf(const QFileInfo &fileInfo) {
+  // The path is encoded, so that the ID is a valid part of a URL whatever the
+  // path is.
+  const QByteArray path = fileInfo.absoluteFilePath().toUtf8().toBase64(
+      QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+  return u"%1/%2-%3"_qs.arg(QString::fromLatin1(path))
+      .arg(fileInfo.size())
+      .arg(fileInfo.lastModified().toMSecsSinceEpoch());
+}
+
+QDir ThumbnailProvider::defaultCacheDirectory() {
+  return QDir{
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+      u"/thumbnails"_qs};
+}
+
+QImage ThumbnailProvider::thumbnail(const QString &id, const int maxSide) {
+  const QString path = QString::fromUtf8(QByteArray::fromBase64(
+      id.section(u'/', 0, 0).toLatin1(), QByteArray::Base64UrlEncoding));
+  // The file may have changed since the ID was made, so it's checked again.
+  const QFileInfo fileInfo(path);
+  const QString key = u"%1|%2|%3|%4"_qs.arg(fileInfo.absoluteFilePath())
+                          .arg(fileInfo.size())
+                          .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+                          .arg(maxSide);
+  {
+    const QMutexLocker locker{&m_mutex};
+    if (const QImage *image = m_memoryCache.object(key)) { return *image; }
+  }
+  const QString cachePath = m_cacheDirectory.filePath(
+      QString::fromLatin1(
+          QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+              .toHex()) +
+      u".png"_qs);
+  QImage image;
+  QFile cachedFile(cachePath);
+  if (cachedFile.open(QIODevice::ReadWrite | QIODevice::ExistingOnly) &&
+      image.load(&cachedFile, "PNG")) {
+    // The modification time tells when the preview was used last, because
+    // lots of file systems don't keep the access time up to date.
+    cachedFile.setFileTime(QDateTime::currentDateTimeUtc(),
+                           QFileDevice::FileModificationTime);
+  } else {
+    image = path.endsWith(u".barch"_qs) ? makeBarchThumbnail(path, maxSide)
+                                        : makeImageThumbnail(path, maxSide);
+    // Several jobs may save the same preview at once. Each of them writes a
+    // file of its own, and the last one wins.
+    QSaveFile cacheFile(cachePath);
+    if (cacheFile.open(QIODevice::WriteOnly) &&
+        image.save(&cacheFile, "PNG") && cacheFile.commit()) {
+      addToDiskCache(QFileInfo{cachePath}.size());
+    }
+  }
+  const QMutexLocker locker{&m_mutex};
+  m_memoryCache.insert(key, new QImage(image), image.sizeInBytes());
+  return image;
+}
+
+void ThumbnailProvider::addToDiskCache(const qint64 size) {
+  const QMutexLocker locker{&m_diskMutex};
+  m_diskCacheSize += size;
+  if (m_diskCacheSize > m_diskBudget) { pruneDiskCache(); }
+}
+
+void ThumbnailProvider::pruneDiskCache() {
+  // The most recently used previews come first.
+  const QFileInfoList entries = m_cacheDirectory.entryInfoList(
+      {u"*.png"_qs}, QDir::Files, QDir::Time);
+  qint64 totalSize = 0;
+  for (const QFileInfo &entry : entries) { totalSize += entry.size(); }
+  // An overfull cache is pruned to three quarters of the budget, so that the
+  // next few previews don't prune it again.
+  const qint64 keptBudget =
+      totalSize > m_diskBudget ? m_diskBudget / 4 * 3 : m_diskBudget;
+  m_diskCacheSize = 0;
+  bool isFull = false;
+  for (const QFileInfo &entry : entries) {
+    isFull = isFull || m_diskCacheSize + entry.size() > keptBudget;
+    // A preview that cannot be deleted is tried again next time.
+    if (isFull && QFile::remove(entry.filePath())) { continue; }
+    m_diskCacheSize += entry.size();
+  }
+}
+
+} // namespace BarchUI
+
+#include "barchuithumbnails.moc"
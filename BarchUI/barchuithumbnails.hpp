@@ -0,0 +1,81 @@
+#ifndef BARCHUITHUMBNAILS_HPP
+#define BARCHUITHUMBNAILS_HPP
+
+#include <QtCore/QtCore>
+#include <QtQuick/QtQuick>
+
+namespace BarchUI {
+
+// ThumbnailProvider makes the previews of the files for the URLs that
+// File::thumbnail() returns. Previews of BARCH files are decoded straight from
+// the compressed bitmap: only the rows that end up in the preview are decoded,
+// and the empty ones aren't decoded at all. The other images are downscaled
+// while they are read.
+//
+// The previews are made on a thread pool of its own, rather than on the
+// Scheduler, so that they don't wait for the transcoding jobs. Once made, they
+// are kept in memory and on disk, each up to a budget of its own. The least
+// recently used ones go first. Either way, they are keyed by the size and the
+// modification time of the file, so a file that changes gets a new preview,
+// and the old one is eventually pruned.
+class ThumbnailProvider final : public QQuickAsyncImageProvider {
+public:
+  // Holds the name that the provider is added to the QML engine with.
+  static constexpr char Name[] = "thumbnails";
+
+  // memoryBudget and diskBudget are in bytes. The previews are saved into
+  // `cacheDirectory`, which is created if it doesn't exist, and pruned to fit
+  // `diskBudget` in the background.
+  ThumbnailProvider(qint64 memoryBudget, qint64 diskBudget,
+                    QDir cacheDirectory);
+
+  QQuickImageResponse *
+  requestImageResponse(const QString &id, const QSize &requestedSize) override;
+
+  // Returns the ID of the preview of the file. It changes along with the
+  // size and the modification time of the file, so that QML asks for a new
+  // preview.
+  static QString idOf(const QFileInfo &fileInfo);
+
+  // Returns `cache/thumbnails` in the cache directory of the application.
+  static QDir defaultCacheDirectory();
+
+  // Returns the preview of the file with the ID, whose width and height are at
+  // most `maxSide` pixels. It comes from one of the caches if possible.
+  // Otherwise, it's made and cached. Called on the thread pool.
+  // Throws std::runtime_error if the file cannot be read.
+  QImage thumbnail(const QString &id, int maxSide);
+
+private:
+  QDir m_cacheDirectory;
+
+  // Guards the cache.
+  QMutex m_mutex;
+
+  QCache<QString, QImage> m_memoryCache;
+
+  qint64 m_diskBudget;
+
+  // Guards the size below and the pruning of the cache directory.
+  QMutex m_diskMutex;
+
+  // Holds the size of the previews on disk as of the last pruning, plus the
+  // ones saved since.
+  qint64 m_diskCacheSize = 0;
+
+  // Adds the preview of `size` bytes that was just saved, and prunes the cache
+  // directory once it's over the budget.
+  void addToDiskCache(qint64 size);
+
+  // Deletes the least recently used previews from the cache directory if they
+  // don't fit into the budget. Precondition: m_diskMutex is locked.
+  void pruneDiskCache();
+
+  // Declared last, so that it waits for the previews that are being made
+  // before everything above goes away.
+  QThreadPool m_threadPool;
+};
+
+} // namespace BarchUI
+
+#endif // BARCHUITHUMBNAILS_HPP
@@ -1,7 +1,12 @@
+#include <cstdlib> // for EXIT_FAILURE
+#include <limits>  // for std::numeric_limits
+
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 
-#include <BarchUI/barchuimodel.hpp>
+#include <BarchUI/barchuifilelist.hpp>
+#include <BarchUI/barchuischeduler.hpp>
+#include <BarchUI/barchuithumbnails.hpp>
 
 // clang-format off
 /*
@@ -31,6 +36,10 @@ int main(int argc, char *argv[]) {
         -t | --target-directory <directory>
                 Specifies the target directory to use. Current directory is used
                 by default.
+
+        -m | --memory-budget <megabytes>
+                Specifies how much memory the transcoding jobs may take at the
+                same time. Half of the physical memory is used by default.
    */
   QCommandLineParser parser;
   parser.setApplicationDescription("Test helper");
@@ -42,8 +51,29 @@ int main(int argc, char *argv[]) {
       QCoreApplication::translate("main", "Read files from <directory>."),
       QCoreApplication::translate("main", "directory"), QDir::currentPath());
   parser.addOption(targetDirectoryOption);
+  QCommandLineOption memoryBudgetOption(
+      QStringList() << "m"
+                    << "memory-budget",
+      QCoreApplication::translate(
+          "main", "Run the jobs within <megabytes> of memory."),
+      QCoreApplication::translate("main", "megabytes"));
+  parser.addOption(memoryBudgetOption);
   parser.process(app);
 
+  qint64 memoryBudget = BarchUI::Scheduler::defaultMemoryBudget();
+  if (parser.isSet(memoryBudgetOption)) {
+    bool isValid = false;
+    const qint64 megabytes =
+        parser.value(memoryBudgetOption).toLongLong(&isValid);
+    // The budget is in bytes, so it must not overflow once it's scaled up.
+    if (!isValid || megabytes <= 0 ||
+        megabytes > std::numeric_limits<qint64>::max() >> 20) {
+      parser.showHelp(EXIT_FAILURE);
+    }
+    memoryBudget = megabytes << 20;
+  }
+  BarchUI::Scheduler scheduler(memoryBudget);
+
   QQmlApplicationEngine engine;
   const QUrl url(u"qrc:/oleksii.skidan/imports/BarchViewer/main.qml"_qs);
   QObject::connect(
@@ -53,38 +83,28 @@ int main(int argc, char *argv[]) {
       },
       Qt::QueuedConnection);
   engine.addImportPath(":/oleksii.skidan/imports");
+  // The engine owns the provider. Up to 64 MiB of previews are kept in memory,
+  // and up to 256 MiB on disk.
+  engine.addImageProvider(
+      QString::fromLatin1(BarchUI::ThumbnailProvider::Name),
+      new BarchUI::ThumbnailProvider(
+          qint64{64} << 20, qint64{256} << 20,
+          BarchUI::ThumbnailProvider::defaultCacheDirectory()));
   engine.load(url);
 
-  // The model is implemented by a QList of File(s).
+  // The model keeps the Files of the target directory. The watcher tells it
+  // when to pick up the changes.
   QDir targetDirectory(parser.value(targetDirectoryOption));
-  {
-    QList<QObject *> files;
-    for (const QFileInfo &fileInfo : targetDirectory.entryInfoList()) {
-      if (fileInfo.isFile()) {
-        files.append(new BarchUI::File(fileInfo, engine));
-      }
-    }
-    engine.rootContext()->setContextProperty("files",
-                                             QVariant::fromValue(files));
-  }
-
-  // File watcher is responsible for updating the model.
+  BarchUI::FileList files(targetDirectory, engine, scheduler);
+  engine.rootContext()->setContextProperty("files", &files);
   QFileSystemWatcher fsWatcher;
-  QObject::connect(
-      &fsWatcher, &QFileSystemWatcher::directoryChanged, &fsWatcher,
-      [&engine, &targetDirectory] {
-        // Make sure it can pick up the changes.
-        targetDirectory.refresh();
-        QList<QObject *> files;
-        for (const QFileInfo &fileInfo : targetDirectory.entryInfoList()) {
-          if (fileInfo.isFile()) {
-            files.append(new BarchUI::File(fileInfo, engine));
-          }
-        }
-        engine.rootContext()->setContextProperty("files",
-                                                 QVariant::fromValue(files));
-      });
+  QObject::connect(&fsWatcher, &QFileSystemWatcher::directoryChanged, &files,
+                   &BarchUI::FileList::refresh);
   fsWatcher.addPath(targetDirectory.path());
 
-  return app.exec();
+  const int exitCode = app.exec();
+  // The jobs refer to the Files, so they have to finish before the Files go
+  // away.
+  scheduler.waitForDone();
+  return exitCode;
 }
@@ -15,7 +15,8 @@ Window {
         id: 		  fileView
         anchors.fill: parent
 
-        // See: main.cpp
+        // See: main.cpp. The model only has the name and the size of the files.
+        // The rest is reached through the File itself, which is `currentFile`.
         model: files
 
         delegate: Row {
@@ -31,12 +32,22 @@ Window {
             // change to the model.
             height: visible ? childrenRect.height + 20 : 0.0
 
+            // Displays the preview of the file. It's made in the background, and cached both in memory and on disk.
+            Image {
+                source: currentFile.thumbnail
+                sourceSize.width: 48
+                sourceSize.height: 48
+                asynchronous: true
+                cache: false
+                anchors.verticalCenter: fileButton.verticalCenter
+            }
+
             // Displays the file name. Clicking on it will create an encoding/decoding task depending on the file type.
             Button {
                 id: fileButton
                 text: name
                 width: 0.7 * mainWindow.width
-                onClicked: transcode()
+                onClicked: currentFile.transcode()
             }
 
             // Displays the file size in kilobytes. I rotated it just to make the UI a bit fancy.
@@ -47,13 +58,39 @@ Window {
                 rotation: -35
             }
 
-            // Displays the progress.
+            // Displays the size of the bitmap and how many of its rows are empty. Only BARCH files have them, and
+            // they are read from the header, so that listing lots of files stays cheap.
+            Text {
+                visible: currentFile.width !== 0
+                text: currentFile.tileSize === 0
+                      ? `${currentFile.width}x${currentFile.height}, ` +
+                        `${currentFile.height - currentFile.nonEmptyRowCount} empty rows`
+                      : `${currentFile.width}x${currentFile.height}, ` +
+                        `${currentFile.nonEmptyRowCount} non-empty tiles`
+                anchors.verticalCenter: fileButton.verticalCenter
+                font.pixelSize: 0.2 * Math.min(fileButton.width, fileButton.height)
+            }
+
+            // Displays the progress. Clicking on it cancels the transcoding.
             Text {
-                visible: progress !== 0
-                text: `${progress}%`
+                visible: currentFile.progress !== 0
+                text: `${currentFile.progress}%`
                 anchors.verticalCenter: fileButton.verticalCenter
                 font.pixelSize: 0.3 * Math.min(fileButton.width, fileButton.height)
                 rotation: -35
+
+                MouseArea {
+                    anchors.fill: parent
+                    onClicked: currentFile.cancel()
+                }
+            }
+
+            // Displays how the last transcoding went, if BarchLib collects statistics.
+            Text {
+                visible: currentFile.statistics !== ""
+                text: currentFile.statistics
+                anchors.verticalCenter: fileButton.verticalCenter
+                font.pixelSize: 0.2 * Math.min(fileButton.width, fileButton.height)
             }
 
             property int initialX: x